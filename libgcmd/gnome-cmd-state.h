@@ -25,8 +25,8 @@ struct GnomeCmdState
 {
     GnomeVFSURI *active_dir_uri;
     GnomeVFSURI *inactive_dir_uri;
-    GList *active_dir_files;
+    GList *active_dir_files;                // GnomeCmdFileInfo::uri may be NULL for these
     GList *inactive_dir_files;
-    GList *active_dir_selected_files;
+    GList *active_dir_selected_files;       // GnomeCmdFileInfo::uri is set for these
     GList *inactive_dir_selected_files;
 };
@@ -32,6 +32,7 @@
 #include "gnome-cmd-data.h"
 #include "gnome-cmd-treeview.h"
 #include "utils.h"
+#include "treesize.h"
 #include "imageloader.h"
 #include "tags/gnome-cmd-tags.h"
 #include "dialogs/gnome-cmd-file-props-dialog.h"
@@ -43,19 +44,12 @@ struct GnomeCmdFilePropsDialogPrivate
 {
     GtkWidget *dialog;
     GnomeCmdFile *f;
-    GThread *thread;
-    GMutex mutex;
-    gboolean count_done;
-    gchar *msg;
-    guint updater_proc_id;
+    TreeSizeJob *tree_size_job;
 
     GtkWidget *notebook;
     GtkWidget *copy_button;
 
     // Properties tab stuff
-    gboolean stop;
-    GnomeVFSFileSize size;
-    GnomeVFSURI *uri;
     GtkWidget *filename_entry;
     GtkWidget *size_label;
     GtkWidget *app_label;
@@ -67,104 +61,27 @@ struct GnomeCmdFilePropsDialogPrivate
 };
 
 
-static void calc_tree_size_r (GnomeCmdFilePropsDialogPrivate *data, GnomeVFSURI *uri)
+static void on_tree_size_counted (TreeSizeJob *job, GnomeVFSFileSize size, gulong count, gboolean done, GnomeCmdFilePropsDialogPrivate *data)
 {
-    GList *list = NULL;
-    gchar *uri_str;
+    if (done)
+        data->tree_size_job = NULL;
 
-    if (data->stop)
-        g_thread_exit (NULL);
-
-    if (!uri) return;
-    uri_str = gnome_vfs_uri_to_string (uri, GNOME_VFS_URI_HIDE_PASSWORD);
-    if (!uri_str) return;
-
-    GnomeVFSResult result = gnome_vfs_directory_list_load (&list, uri_str, GNOME_VFS_FILE_INFO_DEFAULT);
-
-    if (result != GNOME_VFS_OK) return;
-    if (!list) return;
-
-    for (GList *i = list; i; i = i->next)
-    {
-        GnomeVFSFileInfo *info = (GnomeVFSFileInfo *) i->data;
-
-        if (strcmp (info->name, ".") != 0 && strcmp (info->name, "..") != 0)
-        {
-            if (info->type == GNOME_VFS_FILE_TYPE_DIRECTORY)
-            {
-                GnomeVFSURI *new_uri = gnome_vfs_uri_append_file_name (uri, info->name);
-                calc_tree_size_r (data, new_uri);
-                gnome_vfs_uri_unref (new_uri);
-            }
-            else
-                data->size += info->size;
-        }
-    }
-
-    for (GList *i = list; i; i = i->next)
+    if (data->size_label)
     {
-        GnomeVFSFileInfo *info = (GnomeVFSFileInfo *) i->data;
-        gnome_vfs_file_info_unref (info);
+        gchar *s = create_nice_size_str (size);
+        gtk_label_set_text (GTK_LABEL (data->size_label), s);
+        g_free (s);
     }
-
-    g_list_free (list);
-    g_free (uri_str);
-
-    if (data->stop)
-        g_thread_exit (NULL);
-
-    g_mutex_lock (&data->mutex);
-    g_free (data->msg);
-    data->msg = create_nice_size_str (data->size);
-    g_mutex_unlock (&data->mutex);
 }
 
 
-static void calc_tree_size_func (GnomeCmdFilePropsDialogPrivate *data)
-{
-    calc_tree_size_r (data, data->uri);
-
-    data->count_done = TRUE;
-}
-
-
-// Tells the thread to exit and then waits for it to do so.
-static gboolean join_thread_func (GnomeCmdFilePropsDialogPrivate *data)
+static void on_dialog_destroy (GtkDialog *dialog, GnomeCmdFilePropsDialogPrivate *data)
 {
-    if (data->updater_proc_id)
-        g_source_remove (data->updater_proc_id);
-
-    if (data->thread)
-        g_thread_join (data->thread);
+    if (data->tree_size_job)
+        treesize_cancel (data->tree_size_job);
 
     data->f->unref();
     g_free (data);
-
-    return FALSE;
-}
-
-
-static void on_dialog_destroy (GtkDialog *dialog, GnomeCmdFilePropsDialogPrivate *data)
-{
-    data->stop = TRUE;
-    g_timeout_add (1, (GSourceFunc) join_thread_func, data);
-}
-
-
-static gboolean update_count_status (GnomeCmdFilePropsDialogPrivate *data)
-{
-    g_mutex_lock (&data->mutex);
-    if (data->size_label)
-        gtk_label_set_text (GTK_LABEL (data->size_label), data->msg);
-    g_mutex_unlock (&data->mutex);
-
-    if (data->count_done)
-    {
-        // Returning FALSE here stops the timeout callbacks
-        return FALSE;
-    }
-
-    return TRUE;
 }
 
 
@@ -172,13 +89,9 @@ static void do_calc_tree_size (GnomeCmdFilePropsDialogPrivate *data)
 {
     g_return_if_fail (data != NULL);
 
-    data->stop = FALSE;
-    data->size = 0;
-    data->count_done = FALSE;
-
-    data->thread = g_thread_new (NULL, (PthreadFunc) calc_tree_size_func, data);
-
-    data->updater_proc_id = g_timeout_add (gnome_cmd_data.gui_update_rate, (GSourceFunc) update_count_status, data);
+    GnomeVFSURI *uri = data->f->get_uri();
+    data->tree_size_job = treesize_start (uri, (TreeSizeFunc) on_tree_size_counted, data);
+    gnome_vfs_uri_unref (uri);
 }
 
 
@@ -683,7 +596,6 @@ GtkWidget *gnome_cmd_file_props_dialog_create (GnomeCmdFile *f)
         return NULL;
 
     GnomeCmdFilePropsDialogPrivate *data = g_new0 (GnomeCmdFilePropsDialogPrivate, 1);
-    // data->thread = 0;
 
     GtkWidget *dialog = gnome_cmd_dialog_new (_("File Properties"));
     g_signal_connect (dialog, "destroy", G_CALLBACK (on_dialog_destroy), data);
@@ -693,9 +605,6 @@ GtkWidget *gnome_cmd_file_props_dialog_create (GnomeCmdFile *f)
 
     data->dialog = GTK_WIDGET (dialog);
     data->f = f;
-    data->uri = f->get_uri();
-    g_mutex_init(&data->mutex);
-    data->msg = NULL;
     data->notebook = notebook;
     f->ref();
 
@@ -23,7 +23,13 @@
 
 #include "gnome-cmd-includes.h"
 #include "dirlist.h"
+#include "gnome-cmd-con.h"
+#ifdef HAVE_SAMBA
+#include "gnome-cmd-con-smb.h"
+#endif
 #include "gnome-cmd-data.h"
+#include "localdir.h"
+#include "mimeresolver.h"
 #include "utils.h"
 
 using namespace std;
@@ -31,8 +37,382 @@ using namespace std;
 
 #define FILES_PER_NOTIFICATION 50
 #define LIST_PRIORITY 0
+#define PREFETCH_PRIORITY GNOME_VFS_PRIORITY_MIN
+#define ENTRIES_PER_CHUNK 1000      // blocking listings are split into chunks of this size for the worker threads
 
 
+/***********************************
+ * Preparing the listed entries
+ *
+ * Everything needed for a GnomeCmdFile which doesn't depend on GTK or
+ * on the state of the GnomeCmdDir (collation keys and uris) is computed
+ * by a pool of worker threads. The main loop only gets the prepared
+ * entries back and builds the file objects from them.
+ ***********************************/
+
+struct DirListWait
+{
+    GMutex mutex;
+    GCond cond;
+    gint chunks_left;
+};
+
+
+struct DirListChunk
+{
+    GnomeCmdDir *dir;
+    GnomeCmdCon *con;
+    GnomeCmdPath *path;         // a private copy of the dir's path, the workers never touch the dir itself
+    GList *entries;
+    DirListWait *wait;          // set for blocking listings, which wait for their chunks to be prepared
+    LocalDir *local;            // set for native listings, the entries have only their names yet and are stat'ed by the workers
+    DirListLocal *listing;      // set for asynchronous native listings, it holds the dir for the chunk
+    gboolean lazy_mime;         // guessed MIME types are left to mimeresolver, otherwise the workers look them up
+    NameArena *names;           // the collate keys of the entries, created by prepare_entry ()
+};
+
+
+// An asynchronous native listing of a local dir, see read_local_dir ()
+struct DirListLocal
+{
+    gint ref_count;             // the last ref is always given back in the main loop
+    gint cancelled;
+    GnomeCmdDir *dir;
+    GnomeCmdCon *con;
+    GnomeCmdPath *path;
+    gchar *real_path;
+    LocalDir *local;
+    gboolean lazy_mime;
+    GnomeVFSResult result;
+};
+
+
+static GThreadPool *prepare_pool = NULL;
+static GList *prepared_chunks = NULL;       // chunks prepared by the workers, waiting for the main loop
+static guint deliver_source_id = 0;
+G_LOCK_DEFINE_STATIC (prepared_chunks);
+
+
+void dirlist_free_entry (DirListEntry *entry)
+{
+    if (entry->info)
+        gnome_vfs_file_info_unref (entry->info);
+    if (entry->names)
+        name_arena_unref (entry->names);
+    g_free (entry);
+}
+
+
+void dirlist_free_entries (GList *entries)
+{
+    g_list_foreach (entries, (GFunc) dirlist_free_entry, NULL);
+    g_list_free (entries);
+}
+
+
+static void prepare_entry (DirListEntry *entry, DirListChunk *chunk)
+{
+    GnomeVFSFileInfo *info = entry->info;
+    const gchar *name = info->name;
+
+    if (!name || strcmp (name, ".") == 0 || strcmp (name, "..") == 0)
+        return;
+
+    if (!chunk->names)
+        chunk->names = name_arena_new ();
+
+    gchar *collate_key = gnome_cmd_file_create_collate_key (name);
+    entry->collate_key = name_arena_add (chunk->names, collate_key);
+    entry->names = name_arena_ref (chunk->names);
+    g_free (collate_key);
+
+    // native listings always guess, GnomeVFS listings only when they haven't been asked for the MIME type
+    gboolean guessed = chunk->local || !info->mime_type;
+
+    if (!info->mime_type)
+    {
+        info->mime_type = g_strdup (mime_guess_type (info));
+        info->valid_fields = (GnomeVFSFileInfoFields) (info->valid_fields | GNOME_VFS_FILE_INFO_FIELDS_MIME_TYPE);
+    }
+
+    if (!guessed || info->type != GNOME_VFS_FILE_TYPE_REGULAR)
+        return;
+
+    if (chunk->lazy_mime)
+    {
+        entry->mime_guessed = TRUE;
+        return;
+    }
+
+    // the files don't keep an URI, it's only needed for sniffing
+    GnomeCmdPath *child_path = chunk->path->get_child(name);
+
+    if (!child_path)
+        return;
+
+    GnomeVFSURI *uri = gnome_cmd_con_create_uri (chunk->con, child_path);
+    delete child_path;
+
+    if (!uri)
+        return;
+
+    gchar *uri_str = gnome_vfs_uri_to_string (uri, GNOME_VFS_URI_HIDE_PASSWORD);
+    gchar *mime_type = gnome_vfs_get_mime_type (uri_str);
+
+    if (mime_type)
+    {
+        g_free (info->mime_type);
+        info->mime_type = mime_type;
+    }
+
+    g_free (uri_str);
+    gnome_vfs_uri_unref (uri);
+}
+
+
+// Stats the entries of a native listing, the ones which are gone meanwhile are dropped
+static void stat_entries (DirListChunk *chunk)
+{
+    for (GList *i = chunk->entries, *next; i; i = next)
+    {
+        DirListEntry *entry = (DirListEntry *) i->data;
+
+        next = i->next;
+
+        if (localdir_stat (chunk->local, entry->info) != GNOME_VFS_OK)
+        {
+            dirlist_free_entry (entry);
+            chunk->entries = g_list_delete_link (chunk->entries, i);
+        }
+    }
+}
+
+
+static GList *create_entries (GList *infolist, guint n)
+{
+    GList *entries = NULL;
+
+    for (guint i=0; infolist && i<n; infolist = infolist->next, ++i)
+    {
+        DirListEntry *entry = g_new0 (DirListEntry, 1);
+        entry->info = (GnomeVFSFileInfo *) infolist->data;
+        entries = g_list_prepend (entries, entry);
+    }
+
+    return g_list_reverse (entries);
+}
+
+
+static DirListChunk *create_chunk (GnomeCmdDir *dir, GList *infolist, guint n)
+{
+    DirListChunk *chunk = g_new0 (DirListChunk, 1);
+
+    chunk->dir = gnome_cmd_dir_ref (dir);
+    chunk->con = gnome_cmd_dir_get_connection (dir);
+    chunk->path = gnome_cmd_dir_get_path (dir)->clone();
+    chunk->entries = create_entries (infolist, n);
+    chunk->lazy_mime = gnome_cmd_data.lazy_mime_types;
+
+    return chunk;
+}
+
+
+inline DirListLocal *ref_local_listing (DirListLocal *listing)
+{
+    g_atomic_int_inc (&listing->ref_count);
+
+    return listing;
+}
+
+
+static void unref_local_listing (DirListLocal *listing)
+{
+    if (!g_atomic_int_dec_and_test (&listing->ref_count))
+        return;
+
+    if (listing->local)
+        localdir_unref (listing->local);
+    delete listing->path;
+    g_free (listing->real_path);
+    gnome_cmd_dir_unref (listing->dir);
+    g_free (listing);
+}
+
+
+// Called by the reader thread of a native listing, which mustn't touch the ref count of the dir
+static DirListChunk *create_local_chunk (DirListLocal *listing, GList *infolist, guint n)
+{
+    DirListChunk *chunk = g_new0 (DirListChunk, 1);
+
+    chunk->dir = listing->dir;
+    chunk->con = listing->con;
+    chunk->path = listing->path->clone();
+    chunk->entries = create_entries (infolist, n);
+    chunk->local = listing->local;
+    chunk->listing = ref_local_listing (listing);
+    chunk->lazy_mime = listing->lazy_mime;
+
+    return chunk;
+}
+
+
+inline void free_chunk (DirListChunk *chunk)
+{
+    if (chunk->names)
+        name_arena_unref (chunk->names);
+    delete chunk->path;
+    if (chunk->listing)
+        unref_local_listing (chunk->listing);
+    else
+        gnome_cmd_dir_unref (chunk->dir);
+    g_free (chunk);
+}
+
+
+static gboolean deliver_prepared_chunks (gpointer unused)
+{
+    G_LOCK (prepared_chunks);
+    GList *chunks = g_list_reverse (prepared_chunks);
+    prepared_chunks = NULL;
+    deliver_source_id = 0;
+    G_UNLOCK (prepared_chunks);
+
+    for (GList *i = chunks; i; i = i->next)
+    {
+        DirListChunk *chunk = (DirListChunk *) i->data;
+        GnomeCmdDir *dir = chunk->dir;
+
+        g_atomic_int_add (&dir->list_prep_pending, -1);
+
+        if (dir->state == GnomeCmdDir::STATE_EMPTY ||       // the listing has failed or has been cancelled meanwhile
+            (chunk->listing && g_atomic_int_get (&chunk->listing->cancelled)))
+            dirlist_free_entries (chunk->entries);
+        else
+            if (dir->partial_func)
+                dir->partial_func (dir, chunk->entries);        // takes over the entries
+            else
+                dir->infolist = g_list_concat (chunk->entries, dir->infolist);
+
+        free_chunk (chunk);
+    }
+
+    g_list_free (chunks);
+
+    return FALSE;
+}
+
+
+static void prepare_chunk (DirListChunk *chunk, gpointer unused)
+{
+    if (!chunk->listing || !g_atomic_int_get (&chunk->listing->cancelled))
+    {
+        if (chunk->local)
+            stat_entries (chunk);
+
+        for (GList *i = chunk->entries; i; i = i->next)
+            prepare_entry ((DirListEntry *) i->data, chunk);
+    }
+
+    if (chunk->wait)
+    {
+        g_mutex_lock (&chunk->wait->mutex);
+        chunk->wait->chunks_left--;
+        g_cond_signal (&chunk->wait->cond);
+        g_mutex_unlock (&chunk->wait->mutex);
+        return;
+    }
+
+    G_LOCK (prepared_chunks);
+    prepared_chunks = g_list_prepend (prepared_chunks, chunk);
+    if (!deliver_source_id)
+        deliver_source_id = g_idle_add (deliver_prepared_chunks, NULL);
+    G_UNLOCK (prepared_chunks);
+}
+
+
+inline void push_chunk (DirListChunk *chunk)
+{
+    if (!prepare_pool)
+        prepare_pool = g_thread_pool_new ((GFunc) prepare_chunk, NULL, g_get_num_processors (), FALSE, NULL);
+
+    g_thread_pool_push (prepare_pool, chunk, NULL);
+}
+
+
+// Prepares the entries of a blocking listing, returns a list of DirListEntries. The
+// entries of a native listing of @a local have to be stat'ed first.
+static GList *prepare_entries (GnomeCmdDir *dir, GList *infolist, LocalDir *local)
+{
+    guint n = g_list_length (infolist);
+
+    if (n <= ENTRIES_PER_CHUNK)
+    {
+        // not worth to bother the workers
+        DirListChunk *chunk = create_chunk (dir, infolist, n);
+
+        chunk->local = local;
+
+        if (local)
+            stat_entries (chunk);
+
+        GList *entries = chunk->entries;
+
+        for (GList *i = entries; i; i = i->next)
+            prepare_entry ((DirListEntry *) i->data, chunk);
+
+        free_chunk (chunk);
+
+        return entries;
+    }
+
+    DirListWait wait;
+    GList *chunks = NULL;
+
+    g_mutex_init (&wait.mutex);
+    g_cond_init (&wait.cond);
+    wait.chunks_left = 0;
+
+    for (GList *i = infolist; i; i = g_list_nth (i, ENTRIES_PER_CHUNK))
+    {
+        DirListChunk *chunk = create_chunk (dir, i, ENTRIES_PER_CHUNK);
+        chunk->wait = &wait;
+        chunk->local = local;
+        chunks = g_list_prepend (chunks, chunk);
+
+        g_mutex_lock (&wait.mutex);
+        wait.chunks_left++;
+        g_mutex_unlock (&wait.mutex);
+
+        push_chunk (chunk);
+    }
+
+    g_mutex_lock (&wait.mutex);
+    while (wait.chunks_left > 0)
+        g_cond_wait (&wait.cond, &wait.mutex);
+    g_mutex_unlock (&wait.mutex);
+
+    g_mutex_clear (&wait.mutex);
+    g_cond_clear (&wait.cond);
+
+    GList *entries = NULL;
+
+    for (GList *i = chunks; i; i = i->next)
+    {
+        DirListChunk *chunk = (DirListChunk *) i->data;
+        entries = g_list_concat (chunk->entries, entries);
+        free_chunk (chunk);
+    }
+
+    g_list_free (chunks);
+
+    return entries;
+}
+
+
+/***********************************
+ * Listing with GnomeVFS
+ ***********************************/
+
 static void
 on_files_listed (GnomeVFSAsyncHandle *handle,
                  GnomeVFSResult result,
@@ -52,9 +432,12 @@ on_files_listed (GnomeVFSAsyncHandle *handle,
     if (entries_read > 0 && list != NULL)
     {
         g_list_foreach (list, (GFunc) gnome_vfs_file_info_ref, NULL);
-        dir->infolist = g_list_concat (dir->infolist, g_list_copy (list));
-        dir->list_counter += entries_read;
+        g_atomic_int_add (&dir->list_counter, entries_read);
         DEBUG ('l', "files listed: %d\n", dir->list_counter);
+
+        // the prepared batch is handed over to dir->partial_func in streaming mode, otherwise it's collected in dir->infolist
+        g_atomic_int_inc (&dir->list_prep_pending);
+        push_chunk (create_chunk (dir, list, entries_read));
     }
 
     if (result == GNOME_VFS_ERROR_EOF)
@@ -70,9 +453,13 @@ static gboolean update_list_progress (GnomeCmdDir *dir)
 {
     DEBUG ('l', "Checking list progress...\n");
 
-    if (dir->state == GnomeCmdDir::STATE_LISTING)
+    if (dir->state == GnomeCmdDir::STATE_LISTING || g_atomic_int_get (&dir->list_prep_pending) > 0)
     {
-        gchar *msg = g_strdup_printf (ngettext ("%d file listed", "%d files listed", dir->list_counter), dir->list_counter);
+        if (!dir->dialog)
+            return TRUE;
+
+        gint list_counter = g_atomic_int_get (&dir->list_counter);
+        gchar *msg = g_strdup_printf (ngettext ("%d file listed", "%d files listed", list_counter), list_counter);
         gtk_label_set_text (GTK_LABEL (dir->label), msg);
         progress_bar_update (dir->pbar, 50);
         DEBUG('l', "%s\n", msg);
@@ -86,11 +473,147 @@ static gboolean update_list_progress (GnomeCmdDir *dir)
 }
 
 
-inline void visprog_list (GnomeCmdDir *dir)
+/***********************************
+ * Native listing of local dirs
+ *
+ * Dirs of the home and device connections are read by a thread of
+ * read_pool with localdir_read (), which hands out the names in growing
+ * chunks: small ones first, so that a streamed panel shows something
+ * right away, ENTRIES_PER_CHUNK later on. The chunks are stat'ed in
+ * parallel by the prepare_pool workers and delivered the same way as
+ * the batches of GnomeVFS.
+ ***********************************/
+
+static GThreadPool *read_pool = NULL;
+
+
+// Returns the path of @a dir in the local file system, NULL unless it can be listed natively
+static gchar *get_local_path (GnomeCmdDir *dir)
+{
+    if (!gnome_cmd_dir_is_local (dir))
+        return NULL;
+
+    GnomeVFSURI *uri = GNOME_CMD_FILE (dir)->get_uri();
+    gchar *path = NULL;
+
+    if (g_strcmp0 (gnome_vfs_uri_get_scheme (uri), "file") == 0)
+        path = gnome_vfs_unescape_string (gnome_vfs_uri_get_path (uri), NULL);
+
+    gnome_vfs_uri_unref (uri);
+
+    return path;
+}
+
+
+static gboolean finish_local_listing (DirListLocal *listing)
+{
+    GnomeCmdDir *dir = listing->dir;
+
+    if (dir->list_local == listing)     // not cancelled or replaced by another listing
+    {
+        dir->list_local = NULL;
+        dir->list_result = listing->result;
+        dir->state = listing->result == GNOME_VFS_OK ? GnomeCmdDir::STATE_LISTED : GnomeCmdDir::STATE_EMPTY;
+        DEBUG ('l', "All files listed natively: %s\n", gnome_vfs_result_to_string (listing->result));
+    }
+
+    unref_local_listing (listing);
+
+    return FALSE;
+}
+
+
+static void read_local_dir (DirListLocal *listing, gpointer unused)
+{
+    GnomeCmdDir *dir = listing->dir;
+    GnomeVFSResult result;
+    guint chunk_size = FILES_PER_NOTIFICATION;
+
+    listing->local = localdir_open (listing->real_path, &result);
+
+    while (listing->local && !g_atomic_int_get (&listing->cancelled))
+    {
+        GList *infolist = localdir_read (listing->local, chunk_size, &result);
+
+        if (infolist)
+        {
+            guint n = g_list_length (infolist);
+
+            g_atomic_int_add (&dir->list_counter, n);
+            g_atomic_int_inc (&dir->list_prep_pending);
+            push_chunk (create_local_chunk (listing, infolist, n));
+            g_list_free (infolist);
+
+            chunk_size = MIN (2 * chunk_size, ENTRIES_PER_CHUNK);
+        }
+
+        if (result != GNOME_VFS_OK)
+            break;
+    }
+
+    listing->result = result == GNOME_VFS_ERROR_EOF ? GNOME_VFS_OK : result;
+
+    // the chunks pushed above are counted in list_prep_pending already, so the listing is done only after they are delivered
+    g_idle_add ((GSourceFunc) finish_local_listing, listing);
+}
+
+
+inline void local_list (GnomeCmdDir *dir, gchar *real_path)
+{
+    DEBUG('l', "local_list: %s\n", real_path);
+
+    DirListLocal *listing = g_new0 (DirListLocal, 1);
+
+    listing->ref_count = 1;         // the reader's ref, given back by finish_local_listing ()
+    listing->dir = gnome_cmd_dir_ref (dir);
+    listing->con = gnome_cmd_dir_get_connection (dir);
+    listing->path = gnome_cmd_dir_get_path (dir)->clone();
+    listing->real_path = real_path;
+    listing->lazy_mime = gnome_cmd_data.lazy_mime_types;
+
+    dir->list_local = listing;
+
+    if (!read_pool)
+        read_pool = g_thread_pool_new ((GFunc) read_local_dir, NULL, g_get_num_processors (), FALSE, NULL);
+
+    g_thread_pool_push (read_pool, listing, NULL);
+}
+
+
+/***********************************
+ * Listing
+ ***********************************/
+
+// The MIME types are left out in the lazy mode, prepare_entry () guesses them instead
+inline GnomeVFSFileInfoOptions get_info_options (GnomeCmdDir *dir)
+{
+    gboolean lazy_mime = gnome_cmd_data.lazy_mime_types;
+
+#ifdef HAVE_SAMBA
+    // samba workgroups and servers are told by their MIME types, see create_file_list () in gnome-cmd-dir.cc
+    if (GNOME_CMD_IS_CON_SMB (gnome_cmd_dir_get_connection (dir)))
+        lazy_mime = FALSE;
+#endif
+
+    return lazy_mime ? GNOME_VFS_FILE_INFO_FOLLOW_LINKS :
+                       (GnomeVFSFileInfoOptions) (GNOME_VFS_FILE_INFO_FOLLOW_LINKS | GNOME_VFS_FILE_INFO_GET_MIME_TYPE);
+}
+
+
+inline void visprog_list (GnomeCmdDir *dir, int priority=LIST_PRIORITY)
 {
     DEBUG('l', "visprog_list\n");
 
-    GnomeVFSFileInfoOptions infoOpts = (GnomeVFSFileInfoOptions) (GNOME_VFS_FILE_INFO_FOLLOW_LINKS | GNOME_VFS_FILE_INFO_GET_MIME_TYPE);
+    gchar *real_path = get_local_path (dir);
+
+    if (real_path)
+    {
+        local_list (dir, real_path);
+        g_timeout_add (gnome_cmd_data.gui_update_rate, (GSourceFunc) update_list_progress, dir);
+        return;
+    }
+
+    GnomeVFSFileInfoOptions infoOpts = get_info_options (dir);
 
     GnomeVFSURI *uri = GNOME_CMD_FILE (dir)->get_uri();
     gchar *uri_str = gnome_vfs_uri_to_string (uri, GNOME_VFS_URI_HIDE_PASSWORD);
@@ -103,7 +626,7 @@ inline void visprog_list (GnomeCmdDir *dir)
                                         uri,
                                         infoOpts,
                                         FILES_PER_NOTIFICATION,
-                                        LIST_PRIORITY,
+                                        priority,
                                         (GnomeVFSAsyncDirectoryLoadCallback) on_files_listed,
                                         dir);
 
@@ -113,15 +636,43 @@ inline void visprog_list (GnomeCmdDir *dir)
 
 inline void blocking_list (GnomeCmdDir *dir)
 {
-    GnomeVFSFileInfoOptions infoOpts = (GnomeVFSFileInfoOptions) (GNOME_VFS_FILE_INFO_FOLLOW_LINKS | GNOME_VFS_FILE_INFO_GET_MIME_TYPE);
+    GList *infolist = NULL;
+    LocalDir *local = NULL;
+    gchar *real_path = get_local_path (dir);
+
+    if (real_path)
+    {
+        DEBUG('l', "blocking_list: %s\n", real_path);
 
-    gchar *uri_str = GNOME_CMD_FILE (dir)->get_uri_str();
-    DEBUG('l', "blocking_list: %s\n", uri_str);
+        local = localdir_open (real_path, &dir->list_result);
 
-    dir->infolist = NULL;
-    dir->list_result = gnome_vfs_directory_list_load (&dir->infolist, uri_str, infoOpts);
+        if (local)
+        {
+            infolist = localdir_read (local, G_MAXUINT, &dir->list_result);
 
-    g_free (uri_str);
+            if (dir->list_result == GNOME_VFS_ERROR_EOF)
+                dir->list_result = GNOME_VFS_OK;
+        }
+
+        g_free (real_path);
+    }
+    else
+    {
+        GnomeVFSFileInfoOptions infoOpts = get_info_options (dir);
+
+        gchar *uri_str = GNOME_CMD_FILE (dir)->get_uri_str();
+        DEBUG('l', "blocking_list: %s\n", uri_str);
+
+        dir->list_result = gnome_vfs_directory_list_load (&infolist, uri_str, infoOpts);
+
+        g_free (uri_str);
+    }
+
+    dir->infolist = prepare_entries (dir, infolist, local);
+    g_list_free (infolist);
+
+    if (local)
+        localdir_unref (local);
 
     dir->state = dir->list_result==GNOME_VFS_OK ? GnomeCmdDir::STATE_LISTED : GnomeCmdDir::STATE_EMPTY;
     dir->done_func (dir, dir->infolist, dir->list_result);
@@ -134,6 +685,9 @@ void dirlist_list (GnomeCmdDir *dir, gboolean visprog)
 
     dir->infolist = NULL;
     dir->list_handle = NULL;
+    if (dir->list_local)
+        g_atomic_int_set (&dir->list_local->cancelled, TRUE);
+    dir->list_local = NULL;
     dir->list_counter = 0;
     dir->list_result = GNOME_VFS_OK;
     dir->state = GnomeCmdDir::STATE_LISTING;
@@ -148,11 +702,161 @@ void dirlist_list (GnomeCmdDir *dir, gboolean visprog)
 }
 
 
+void dirlist_stream (GnomeCmdDir *dir)
+{
+    g_return_if_fail (GNOME_CMD_IS_DIR (dir));
+    g_return_if_fail (dir->partial_func != NULL);
+
+    dir->infolist = NULL;
+    dir->list_handle = NULL;
+    if (dir->list_local)
+        g_atomic_int_set (&dir->list_local->cancelled, TRUE);
+    dir->list_local = NULL;
+    dir->list_counter = 0;
+    dir->list_result = GNOME_VFS_OK;
+    dir->state = GnomeCmdDir::STATE_LISTING;
+
+    visprog_list (dir);
+}
+
+
+// Like a visprog listing without the dialog, the GnomeVFS jobs of all other listings come first
+void dirlist_prefetch (GnomeCmdDir *dir)
+{
+    g_return_if_fail (GNOME_CMD_IS_DIR (dir));
+
+    dir->infolist = NULL;
+    dir->list_handle = NULL;
+    if (dir->list_local)
+        g_atomic_int_set (&dir->list_local->cancelled, TRUE);
+    dir->list_local = NULL;
+    dir->list_counter = 0;
+    dir->list_result = GNOME_VFS_OK;
+    dir->state = GnomeCmdDir::STATE_LISTING;
+
+    visprog_list (dir, PREFETCH_PRIORITY);
+}
+
+
 void dirlist_cancel (GnomeCmdDir *dir)
 {
     dir->state = GnomeCmdDir::STATE_EMPTY;
     dir->list_result = GNOME_VFS_OK;
 
+    if (dir->list_local)
+    {
+        DEBUG('l', "Cancelling native listing\n");
+        g_atomic_int_set (&dir->list_local->cancelled, TRUE);
+        dir->list_local = NULL;
+        return;
+    }
+
     DEBUG('l', "Calling async_cancel\n");
     gnome_vfs_async_cancel (dir->list_handle);
 }
+
+
+/***********************************
+ * Revalidating a cached listing
+ *
+ * A remote dir which is entered again shows its cached listing right
+ * away. A worker thread then checks the mtime of the dir and, if it has
+ * changed, lists it again. The fresh entries are handed to the main
+ * loop, which only applies the difference to the cached files.
+ ***********************************/
+
+#define REVALIDATE_THREADS 4    // the workers mostly wait for the network
+
+struct DirRevalidation
+{
+    GnomeCmdDir *dir;           // reffed, only touched in the main loop
+    DirListChunk chunk;         // for prepare_entry (), the dir isn't reffed again by it
+    gchar *uri_str;             // with the password, never to be shown
+    time_t mtime;
+    GnomeVFSFileInfoOptions info_opts;
+    DirRevalidateFunc func;
+    gboolean changed;
+    GnomeVFSResult result;
+};
+
+
+static GThreadPool *revalidate_pool = NULL;
+
+
+static gboolean finish_revalidation (DirRevalidation *rv)
+{
+    DEBUG('l', "Revalidated %s: %s\n", rv->chunk.path->get_path(),
+          rv->result != GNOME_VFS_OK ? gnome_vfs_result_to_string (rv->result) : rv->changed ? "changed" : "up to date");
+
+    rv->func (rv->dir, rv->changed, rv->chunk.entries, rv->mtime, rv->result);
+
+    gnome_cmd_dir_unref (rv->dir);
+    if (rv->chunk.names)
+        name_arena_unref (rv->chunk.names);
+    delete rv->chunk.path;
+    g_free (rv->uri_str);
+    g_free (rv);
+
+    return FALSE;
+}
+
+
+static void revalidate (DirRevalidation *rv, gpointer unused)
+{
+    GnomeVFSFileInfo *info = gnome_vfs_file_info_new ();
+
+    rv->result = gnome_vfs_get_file_info (rv->uri_str, info, GNOME_VFS_FILE_INFO_FOLLOW_LINKS);
+
+    // servers which don't report the mtime of dirs are always listed
+    rv->changed = rv->result != GNOME_VFS_OK || !(info->valid_fields & GNOME_VFS_FILE_INFO_FIELDS_MTIME) || info->mtime != rv->mtime;
+
+    if (rv->result == GNOME_VFS_OK)
+        rv->mtime = info->mtime;
+
+    gnome_vfs_file_info_unref (info);
+
+    if (rv->changed)
+    {
+        GList *infolist = NULL;
+
+        rv->result = gnome_vfs_directory_list_load (&infolist, rv->uri_str, rv->info_opts);
+
+        if (rv->result == GNOME_VFS_OK)
+        {
+            rv->chunk.entries = create_entries (infolist, G_MAXUINT);
+
+            for (GList *i = rv->chunk.entries; i; i = i->next)
+                prepare_entry ((DirListEntry *) i->data, &rv->chunk);
+        }
+        else
+            gnome_vfs_file_info_list_free (infolist);
+
+        g_list_free (infolist);
+    }
+
+    g_idle_add ((GSourceFunc) finish_revalidation, rv);
+}
+
+
+void dirlist_revalidate (GnomeCmdDir *dir, DirRevalidateFunc func)
+{
+    g_return_if_fail (GNOME_CMD_IS_DIR (dir));
+    g_return_if_fail (func != NULL);
+
+    DirRevalidation *rv = g_new0 (DirRevalidation, 1);
+
+    rv->dir = gnome_cmd_dir_ref (dir);
+    rv->chunk.dir = dir;
+    rv->chunk.con = gnome_cmd_dir_get_connection (dir);
+    rv->chunk.path = gnome_cmd_dir_get_path (dir)->clone();
+    rv->chunk.lazy_mime = gnome_cmd_data.lazy_mime_types;
+    rv->uri_str = GNOME_CMD_FILE (dir)->get_uri_str(GNOME_VFS_URI_HIDE_NONE);
+    rv->mtime = GNOME_CMD_FILE (dir)->info->mtime;
+    rv->info_opts = get_info_options (dir);
+    rv->func = func;
+
+    if (!revalidate_pool)
+        revalidate_pool = g_thread_pool_new ((GFunc) revalidate, NULL, REVALIDATE_THREADS, FALSE, NULL);
+
+    g_thread_pool_push (revalidate_pool, rv, NULL);
+}
@@ -23,5 +23,33 @@
 
 #include "gnome-cmd-dir.h"
 
+/**
+ * A listed file prepared by the listing worker threads. The lists handed
+ * to dir->done_func and dir->partial_func carry DirListEntries. The
+ * entries of "." and ".." have only info set.
+ */
+struct DirListEntry
+{
+    GnomeVFSFileInfo *info;
+    const gchar *collate_key;   // in names
+    NameArena *names;           // reffed, shared by the entries prepared together
+    gboolean mime_guessed;      // info->mime_type is guessed from the name only, see mimeresolver.h
+};
+
+void dirlist_free_entry (DirListEntry *entry);
+void dirlist_free_entries (GList *entries);
+
 void dirlist_list (GnomeCmdDir *dir, gboolean visprog);
+void dirlist_stream (GnomeCmdDir *dir);
+void dirlist_prefetch (GnomeCmdDir *dir);
 void dirlist_cancel (GnomeCmdDir *dir);
+
+typedef void (* DirRevalidateFunc) (GnomeCmdDir *dir, gboolean changed, GList *entries, time_t mtime, GnomeVFSResult result);
+
+/**
+ * Checks the mtime of @a dir on a worker thread and lists it again if it
+ * has changed since the cached listing. @a func gets the prepared
+ * DirListEntries in the main loop, they are NULL if @a changed is FALSE
+ * or the listing has failed.
+ */
+void dirlist_revalidate (GnomeCmdDir *dir, DirRevalidateFunc func);
@@ -232,6 +232,14 @@ static void draw_row (GtkCList *clist, GdkRectangle *area, gint row, GtkCListRow
     if (!clist_row)
         clist_row = (GtkCListRow *) ROW_ELEMENT (clist, row)->data;
 
+    // rows of a lazily formatted list are filled in just before they are shown for the first time
+    if (GNOME_CMD_CLIST (clist)->format_func)
+    {
+        clist->freeze_count++;      // no nested redraws while the cells are set
+        GNOME_CMD_CLIST (clist)->format_func (GNOME_CMD_CLIST (clist), row, clist_row, GNOME_CMD_CLIST (clist)->format_func_data);
+        clist->freeze_count--;
+    }
+
     // rectangle of the entire row
     row_rectangle.x = 0;
     row_rectangle.y = ROW_TOP_YPIXEL (clist, row);
@@ -510,6 +518,76 @@ static void on_realize (GtkCList *clist, gpointer data)
 }
 
 
+/*******************************
+ * Shared cell strings
+ *******************************/
+
+// Text cells of lists with a format func point into this pool instead of holding their own copies
+static GHashTable *cell_strings = NULL;     // string -> number of cells using it
+
+
+static gchar *acquire_cell_string (const gchar *text)
+{
+    gpointer s, count;
+
+    if (!cell_strings)
+        cell_strings = g_hash_table_new (g_str_hash, g_str_equal);      // no destroy funcs, updating a count must not free the key
+
+    if (g_hash_table_lookup_extended (cell_strings, text, &s, &count))
+        g_hash_table_insert (cell_strings, s, GUINT_TO_POINTER (GPOINTER_TO_UINT (count) + 1));
+    else
+        g_hash_table_insert (cell_strings, s = g_strdup (text), GUINT_TO_POINTER (1));
+
+    return (gchar *) s;
+}
+
+
+static void release_cell_string (gchar *s)
+{
+    guint count = GPOINTER_TO_UINT (g_hash_table_lookup (cell_strings, s));
+
+    if (count > 1)
+        g_hash_table_insert (cell_strings, s, GUINT_TO_POINTER (count - 1));
+    else
+    {
+        g_hash_table_remove (cell_strings, s);
+        g_free (s);
+    }
+}
+
+
+static void set_cell_contents (GtkCList *clist, GtkCListRow *clist_row, gint column, GtkCellType type,
+                               const gchar *text, guint8 spacing, GdkPixmap *pixmap, GdkBitmap *mask)
+{
+    if (!GNOME_CMD_CLIST (clist)->format_func)
+    {
+        parent_class->set_cell_contents (clist, clist_row, column, type, text, spacing, pixmap, mask);
+        return;
+    }
+
+    GtkCell *cell = &clist_row->cell[column];
+
+    if (cell->type == GTK_CELL_TEXT && GTK_CELL_TEXT (*cell)->text)
+    {
+        gchar *s = GTK_CELL_TEXT (*cell)->text;
+
+        // GtkCList frees the old text, an auto resized column measures it first
+        GTK_CELL_TEXT (*cell)->text = clist->column[column].auto_resize ? g_strdup (s) : NULL;
+        release_cell_string (s);
+    }
+
+    parent_class->set_cell_contents (clist, clist_row, column, type, text, spacing, pixmap, mask);
+
+    if (cell->type == GTK_CELL_TEXT && GTK_CELL_TEXT (*cell)->text)
+    {
+        gchar *copy = GTK_CELL_TEXT (*cell)->text;
+
+        GTK_CELL_TEXT (*cell)->text = acquire_cell_string (copy);
+        g_free (copy);
+    }
+}
+
+
 /*******************************
  * Gtk class implementation
  *******************************/
@@ -542,12 +620,15 @@ static void class_init (GnomeCmdCListClass *klass)
     widget_class->map = ::map;
 
     clist_class->draw_row = draw_row;
+    clist_class->set_cell_contents = set_cell_contents;
 }
 
 
 static void init (GnomeCmdCList *clist)
 {
     clist->drag_motion_row = -1;
+    clist->format_func = NULL;
+    clist->format_func_data = NULL;
 
     gtk_clist_set_selection_mode (GTK_CLIST (clist), GTK_SELECTION_SINGLE);
 
@@ -615,6 +696,67 @@ void gnome_cmd_clist_update_style (GnomeCmdCList *clist)
 }
 
 
+/**
+ * The text cells of a list with a format func share their strings with
+ * all other such lists, so the func must be set while the list is empty.
+ */
+void gnome_cmd_clist_set_format_func (GnomeCmdCList *clist, GnomeCmdCListFormatFunc func, gpointer user_data)
+{
+    g_return_if_fail (GNOME_CMD_IS_CLIST (clist));
+    g_return_if_fail (GTK_CLIST (clist)->rows == 0);
+
+    clist->format_func = func;
+    clist->format_func_data = user_data;
+}
+
+
+/**
+ * Empties the cells of @a row of a list with a format func, so that they
+ * are filled in again when the row is drawn next. A visible row is redrawn
+ * at once, the others cost nothing until they are scrolled into view.
+ */
+void gnome_cmd_clist_invalidate_row (GnomeCmdCList *clist, gint row)
+{
+    g_return_if_fail (GNOME_CMD_IS_CLIST (clist));
+    g_return_if_fail (clist->format_func != NULL);
+
+    GtkCList *gtk_clist = GTK_CLIST (clist);
+
+    if (row < 0 || row >= gtk_clist->rows)
+        return;
+
+    GtkCListRow *clist_row = (GtkCListRow *) ROW_ELEMENT (gtk_clist, row)->data;
+
+    for (gint i=0; i<gtk_clist->columns; i++)
+        GTK_CLIST_GET_CLASS (gtk_clist)->set_cell_contents (gtk_clist, clist_row, i, GTK_CELL_EMPTY, NULL, 0, NULL, NULL);
+
+    if (!gtk_clist->freeze_count && gtk_clist_row_is_visible (gtk_clist, row) != GTK_VISIBILITY_NONE)
+        draw_row (gtk_clist, NULL, row, clist_row);
+}
+
+
+void gnome_cmd_clist_set_row_colors (GnomeCmdCList *clist, GtkCListRow *clist_row, GdkColor *fg, GdkColor *bg)
+{
+    GdkColormap *colormap = GTK_WIDGET_REALIZED (clist) ? gtk_widget_get_colormap (GTK_WIDGET (clist)) : NULL;
+
+    if (fg)
+    {
+        clist_row->foreground = *fg;
+        clist_row->fg_set = TRUE;
+        if (colormap)
+            gdk_colormap_alloc_color (colormap, &clist_row->foreground, FALSE, TRUE);
+    }
+
+    if (bg)
+    {
+        clist_row->background = *bg;
+        clist_row->bg_set = TRUE;
+        if (colormap)
+            gdk_colormap_alloc_color (colormap, &clist_row->background, FALSE, TRUE);
+    }
+}
+
+
 void gnome_cmd_clist_set_voffset (GnomeCmdCList *clist, gint voffset)
 {
     g_return_if_fail (GNOME_CMD_IS_CLIST (clist));
@@ -28,11 +28,22 @@
 #define GNOME_CMD_CLIST_GET_CLASS(obj)    (G_TYPE_INSTANCE_GET_CLASS((obj), GNOME_CMD_TYPE_CLIST, GnomeCmdCListClass))
 
 
+struct GnomeCmdCList;
+
+/**
+ * Fills in the cells of @a clist_row. Called every time a row is about to
+ * be drawn, so it has to return at once if the row is already filled in.
+ */
+typedef void (* GnomeCmdCListFormatFunc) (GnomeCmdCList *clist, gint row, GtkCListRow *clist_row, gpointer user_data);
+
 struct GnomeCmdCList
 {
     GtkCList parent;
 
     gint drag_motion_row;
+
+    GnomeCmdCListFormatFunc format_func;     // if set, rows are added empty and filled in when they are drawn first, with pooled cell strings
+    gpointer format_func_data;
 };
 
 
@@ -54,6 +65,25 @@ inline GtkWidget *gnome_cmd_clist_new (gint columns)
 
 void gnome_cmd_clist_update_style (GnomeCmdCList *clist);
 
+void gnome_cmd_clist_set_format_func (GnomeCmdCList *clist, GnomeCmdCListFormatFunc func, gpointer user_data);
+void gnome_cmd_clist_invalidate_row (GnomeCmdCList *clist, gint row);
+
+// Cell setters for GnomeCmdCListFormatFunc, they take the row itself and don't redraw it
+inline void gnome_cmd_clist_set_cell_text (GnomeCmdCList *clist, GtkCListRow *clist_row, gint column, const gchar *text)
+{
+    GTK_CLIST_GET_CLASS (clist)->set_cell_contents (GTK_CLIST (clist), clist_row, column, GTK_CELL_TEXT, text, 0, NULL, NULL);
+}
+
+inline void gnome_cmd_clist_set_cell_pixmap (GnomeCmdCList *clist, GtkCListRow *clist_row, gint column, GdkPixmap *pixmap, GdkBitmap *mask)
+{
+    g_object_ref (pixmap);
+    if (mask)
+        g_object_ref (mask);
+    GTK_CLIST_GET_CLASS (clist)->set_cell_contents (GTK_CLIST (clist), clist_row, column, GTK_CELL_PIXMAP, NULL, 0, pixmap, mask);
+}
+
+void gnome_cmd_clist_set_row_colors (GnomeCmdCList *clist, GtkCListRow *clist_row, GdkColor *fg, GdkColor *bg);
+
 gint gnome_cmd_clist_get_voffset (GnomeCmdCList *clist);
 void gnome_cmd_clist_set_voffset (GnomeCmdCList *clist, gint voffset);
 
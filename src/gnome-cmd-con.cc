@@ -34,7 +34,17 @@ struct GnomeCmdConPrivate
     History        *dir_history;
     GnomeCmdBookmarkGroup *bookmarks;
     GList          *all_dirs;
-    GHashTable     *all_dirs_map;
+    GHashTable     *all_dirs_map;   // uri -> DirCacheEntry, every dir of the connection which is alive
+    GQueue          lru;            // of DirCacheEntries, the most recently used first
+    GnomeCmdConCacheStats cache_stats;
+};
+
+
+struct DirCacheEntry
+{
+    GnomeCmdDir *dir;               // not reffed, the dir removes itself when it's finalized
+    GList *link;                    // in priv->lru
+    gsize bytes;                    // approximate size of the dir's listing
 };
 
 enum
@@ -207,6 +217,7 @@ static void init (GnomeCmdCon *con)
     // con->priv->bookmarks->data = NULL;
     con->priv->all_dirs = NULL;
     con->priv->all_dirs_map = NULL;
+    g_queue_init (&con->priv->lru);
 }
 
 
@@ -474,6 +485,86 @@ GnomeVFSResult gnome_cmd_con_mkdir (GnomeCmdCon *con, const gchar *path_str)
 }
 
 
+/***********************************
+ * The dir cache
+ *
+ * Every dir of the connection which is alive is in all_dirs_map, so
+ * that there's only one GnomeCmdDir per uri. The listings the dirs keep
+ * are what makes the cache big: a listed dir holds its subdirs, which
+ * hold their listings, and so on. The dirs are kept in LRU order with
+ * the approximate size of their listings, and the listings of the
+ * least recently used dirs are dropped once all of them together
+ * exceed gnome_cmd_data.dir_cache_size.
+ ***********************************/
+
+inline DirCacheEntry *lookup_entry (GnomeCmdCon *con, GnomeCmdDir *dir)
+{
+    if (!con->priv->all_dirs_map)
+        return NULL;
+
+    gchar *uri_str = GNOME_CMD_FILE (dir)->get_uri_str();
+    DirCacheEntry *entry = (DirCacheEntry *) g_hash_table_lookup (con->priv->all_dirs_map, uri_str);
+    g_free (uri_str);
+
+    return entry && entry->dir == dir ? entry : NULL;
+}
+
+
+static void remove_entry (GnomeCmdCon *con, const gchar *uri_str)
+{
+    if (!con->priv->all_dirs_map)
+        return;
+
+    DirCacheEntry *entry = (DirCacheEntry *) g_hash_table_lookup (con->priv->all_dirs_map, uri_str);
+
+    if (!entry)
+        return;
+
+    con->priv->cache_stats.bytes -= entry->bytes;
+    g_queue_delete_link (&con->priv->lru, entry->link);
+    g_hash_table_remove (con->priv->all_dirs_map, uri_str);
+}
+
+
+// Drops the listings of the least recently used dirs until the cache is within its budget, @a keep is spared
+static void evict_dirs (GnomeCmdCon *con, GnomeCmdDir *keep)
+{
+    guint64 budget = (guint64) gnome_cmd_data.dir_cache_size << 20;
+    GnomeCmdConCacheStats &stats = con->priv->cache_stats;
+
+    GList *i = con->priv->lru.tail;
+
+    // a dropped listing may take the last references to subdirs with it, and their entries with
+    // them, so the dirs of the current entry and of the next one are held until it is left
+    GnomeCmdDir *dir = i ? gnome_cmd_dir_ref (((DirCacheEntry *) i->data)->dir) : NULL;
+
+    while (i && stats.bytes > budget)
+    {
+        DirCacheEntry *entry = (DirCacheEntry *) i->data;
+        GList *prev = i->prev;
+        GnomeCmdDir *prev_dir = prev ? gnome_cmd_dir_ref (((DirCacheEntry *) prev->data)->dir) : NULL;
+
+        // dirs shown in a panel or being listed keep their files
+        if (entry->dir != keep && entry->bytes > 0 && gnome_cmd_dir_drop_listing (entry->dir))
+        {
+            stats.bytes -= entry->bytes;
+            stats.evictions++;
+            entry->bytes = 0;
+
+            DEBUG ('k', "EVICTED 0x%p from the cache, %" G_GUINT64_FORMAT " bytes in %u dirs left\n",
+                   entry->dir, stats.bytes, g_queue_get_length (&con->priv->lru));
+        }
+
+        gnome_cmd_dir_unref (dir);          // may finalize it, and remove i
+        i = prev;
+        dir = prev_dir;
+    }
+
+    if (dir)
+        gnome_cmd_dir_unref (dir);
+}
+
+
 void gnome_cmd_con_add_to_cache (GnomeCmdCon *con, GnomeCmdDir *dir)
 {
     g_return_if_fail (GNOME_CMD_IS_CON (con));
@@ -482,10 +573,18 @@ void gnome_cmd_con_add_to_cache (GnomeCmdCon *con, GnomeCmdDir *dir)
     gchar *uri_str = GNOME_CMD_FILE (dir)->get_uri_str();
 
     if (!con->priv->all_dirs_map)
-        con->priv->all_dirs_map = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+        con->priv->all_dirs_map = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+    remove_entry (con, uri_str);
+
+    DirCacheEntry *entry = g_new0 (DirCacheEntry, 1);
+
+    entry->dir = dir;
+    g_queue_push_head (&con->priv->lru, entry);
+    entry->link = con->priv->lru.head;
 
     DEBUG ('k', "ADDING 0x%p %s to the cache\n", dir, uri_str);
-    g_hash_table_insert (con->priv->all_dirs_map, uri_str, dir);
+    g_hash_table_insert (con->priv->all_dirs_map, uri_str, entry);
 }
 
 
@@ -497,7 +596,7 @@ void gnome_cmd_con_remove_from_cache (GnomeCmdCon *con, GnomeCmdDir *dir)
     gchar *uri_str = GNOME_CMD_FILE (dir)->get_uri_str();
 
     DEBUG ('k', "REMOVING 0x%p %s from the cache\n", dir, uri_str);
-    g_hash_table_remove (con->priv->all_dirs_map, uri_str);
+    remove_entry (con, uri_str);
     g_free (uri_str);
 }
 
@@ -508,7 +607,7 @@ void gnome_cmd_con_remove_from_cache (GnomeCmdCon *con, const gchar *uri_str)
     g_return_if_fail (uri_str != NULL);
 
     DEBUG ('k', "REMOVING %s from the cache\n", uri_str);
-    g_hash_table_remove (con->priv->all_dirs_map, uri_str);
+    remove_entry (con, uri_str);
 }
 
 
@@ -520,7 +619,12 @@ GnomeCmdDir *gnome_cmd_con_cache_lookup (GnomeCmdCon *con, const gchar *uri_str)
     GnomeCmdDir *dir = NULL;
 
     if (con->priv->all_dirs_map)
-        dir = (GnomeCmdDir *) g_hash_table_lookup (con->priv->all_dirs_map, uri_str);
+    {
+        DirCacheEntry *entry = (DirCacheEntry *) g_hash_table_lookup (con->priv->all_dirs_map, uri_str);
+
+        if (entry)
+            dir = entry->dir;
+    }
 
     if (dir)
         DEBUG ('k', "FOUND 0x%p %s in the hash-table, reusing it!\n", dir, uri_str);
@@ -531,6 +635,54 @@ GnomeCmdDir *gnome_cmd_con_cache_lookup (GnomeCmdCon *con, const gchar *uri_str)
 }
 
 
+void gnome_cmd_con_cache_touch (GnomeCmdCon *con, GnomeCmdDir *dir, gboolean hit)
+{
+    g_return_if_fail (GNOME_CMD_IS_CON (con));
+    g_return_if_fail (GNOME_CMD_IS_DIR (dir));
+
+    if (hit)
+        con->priv->cache_stats.hits++;
+    else
+        con->priv->cache_stats.misses++;
+
+    DirCacheEntry *entry = lookup_entry (con, dir);
+
+    if (entry && entry->link != con->priv->lru.head)
+    {
+        g_queue_unlink (&con->priv->lru, entry->link);
+        g_queue_push_head_link (&con->priv->lru, entry->link);
+    }
+}
+
+
+void gnome_cmd_con_cache_set_size (GnomeCmdCon *con, GnomeCmdDir *dir, gsize bytes)
+{
+    g_return_if_fail (GNOME_CMD_IS_CON (con));
+    g_return_if_fail (GNOME_CMD_IS_DIR (dir));
+
+    DirCacheEntry *entry = lookup_entry (con, dir);
+
+    if (!entry)
+        return;
+
+    con->priv->cache_stats.bytes += bytes;
+    con->priv->cache_stats.bytes -= entry->bytes;
+    entry->bytes = bytes;
+
+    evict_dirs (con, dir);
+}
+
+
+void gnome_cmd_con_get_cache_stats (GnomeCmdCon *con, GnomeCmdConCacheStats *stats)
+{
+    g_return_if_fail (GNOME_CMD_IS_CON (con));
+    g_return_if_fail (stats != NULL);
+
+    *stats = con->priv->cache_stats;
+    stats->dirs = g_queue_get_length (&con->priv->lru);
+}
+
+
 const gchar *gnome_cmd_con_get_icon_name (ConnectionMethodID method)
 {
     return icon_name[method];
@@ -30,6 +30,15 @@
 
 struct GnomeCmdConPrivate;
 
+struct GnomeCmdConCacheStats
+{
+    guint dirs;                 // dirs in the cache, with or without their listing
+    guint64 bytes;              // approximate size of the cached listings
+    guint hits;                 // listings reused by gnome_cmd_dir_list_files ()
+    guint misses;               // listings read again
+    guint evictions;            // listings dropped to stay within gnome_cmd_data.dir_cache_size
+};
+
 #include <string>
 
 #include "gnome-cmd-path.h"
@@ -351,6 +360,20 @@ void gnome_cmd_con_remove_from_cache (GnomeCmdCon *con, const gchar *uri);
 
 GnomeCmdDir *gnome_cmd_con_cache_lookup (GnomeCmdCon *con, const gchar *uri);
 
+/**
+ * Marks @a dir as the most recently used one of the cache and counts a
+ * hit if its cached listing is reused, a miss otherwise.
+ */
+void gnome_cmd_con_cache_touch (GnomeCmdCon *con, GnomeCmdDir *dir, gboolean hit);
+
+/**
+ * Sets the approximate size of the listing of @a dir, which may drop the
+ * listings of the least recently used dirs.
+ */
+void gnome_cmd_con_cache_set_size (GnomeCmdCon *con, GnomeCmdDir *dir, gsize bytes);
+
+void gnome_cmd_con_get_cache_stats (GnomeCmdCon *con, GnomeCmdConCacheStats *stats);
+
 const gchar *gnome_cmd_con_get_icon_name (ConnectionMethodID method);
 
 inline const gchar *gnome_cmd_con_get_icon_name (GnomeCmdCon *con)
@@ -47,6 +47,12 @@ using namespace std;
 #define MAX_GUI_UPDATE_RATE 1000
 #define MIN_GUI_UPDATE_RATE 10
 #define DEFAULT_GUI_UPDATE_RATE 100
+#define DEFAULT_MONITOR_UPDATE_RATE 250
+#define DEFAULT_DIR_CACHE_SIZE 64
+#define DEFAULT_PREFETCH_BUDGET 512
+#define DEFAULT_NAVIGATION_TIMEOUT 15
+#define DEFAULT_COPY_WORKERS 4
+#define DEFAULT_XFER_JOBS_PER_DEVICE 1
 
 GnomeCmdData gnome_cmd_data;
 
@@ -2692,6 +2698,18 @@ GnomeCmdData::GnomeCmdData(): search_defaults(selections)
     dev_icon_size = 16;
     memset(fs_col_width, 0, sizeof(fs_col_width));
     gui_update_rate = DEFAULT_GUI_UPDATE_RATE;
+    stream_dir_listing = TRUE;
+    monitor_update_rate = DEFAULT_MONITOR_UPDATE_RATE;
+    lazy_mime_types = TRUE;
+    dir_cache_size = DEFAULT_DIR_CACHE_SIZE;
+    revalidate_remote_dirs = TRUE;
+    prefetch_budget = DEFAULT_PREFETCH_BUDGET;
+    navigation_timeout = DEFAULT_NAVIGATION_TIMEOUT;
+    native_local_copy = TRUE;
+    copy_workers = DEFAULT_COPY_WORKERS;
+    xfer_jobs_per_device = DEFAULT_XFER_JOBS_PER_DEVICE;
+    checkpointed_xfers = FALSE;
+    verify_resumed_xfers = FALSE;
 
     cmdline_history = NULL;
     cmdline_history_length = 0;
@@ -3594,6 +3612,18 @@ void GnomeCmdData::load()
     cmdline_history_length = g_settings_get_uint (options.gcmd_settings->general, GCMD_SETTINGS_CMDLINE_HISTORY_LENGTH);
     horizontal_orientation = g_settings_get_boolean (options.gcmd_settings->general, GCMD_SETTINGS_HORIZONTAL_ORIENTATION);
     gui_update_rate = g_settings_get_uint (options.gcmd_settings->general, GCMD_SETTINGS_GUI_UPDATE_RATE);
+    stream_dir_listing = g_settings_get_boolean (options.gcmd_settings->general, GCMD_SETTINGS_STREAM_DIR_LISTING);
+    monitor_update_rate = g_settings_get_uint (options.gcmd_settings->general, GCMD_SETTINGS_MONITOR_UPDATE_RATE);
+    lazy_mime_types = g_settings_get_boolean (options.gcmd_settings->general, GCMD_SETTINGS_LAZY_MIME_TYPES);
+    dir_cache_size = g_settings_get_uint (options.gcmd_settings->general, GCMD_SETTINGS_DIR_CACHE_SIZE);
+    revalidate_remote_dirs = g_settings_get_boolean (options.gcmd_settings->general, GCMD_SETTINGS_REVALIDATE_REMOTE_DIRS);
+    prefetch_budget = g_settings_get_uint (options.gcmd_settings->general, GCMD_SETTINGS_PREFETCH_BUDGET);
+    navigation_timeout = g_settings_get_uint (options.gcmd_settings->general, GCMD_SETTINGS_NAVIGATION_TIMEOUT);
+    native_local_copy = g_settings_get_boolean (options.gcmd_settings->general, GCMD_SETTINGS_NATIVE_LOCAL_COPY);
+    copy_workers = g_settings_get_uint (options.gcmd_settings->general, GCMD_SETTINGS_COPY_WORKERS);
+    xfer_jobs_per_device = g_settings_get_uint (options.gcmd_settings->general, GCMD_SETTINGS_XFER_JOBS_PER_DEVICE);
+    checkpointed_xfers = g_settings_get_boolean (options.gcmd_settings->general, GCMD_SETTINGS_CHECKPOINTED_XFERS);
+    verify_resumed_xfers = g_settings_get_boolean (options.gcmd_settings->general, GCMD_SETTINGS_VERIFY_RESUMED_XFERS);
     options.main_win_pos[0] = g_settings_get_int (options.gcmd_settings->general, GCMD_SETTINGS_MAIN_WIN_POS_X);
     options.main_win_pos[1] = g_settings_get_int (options.gcmd_settings->general, GCMD_SETTINGS_MAIN_WIN_POS_Y);
 
@@ -4209,6 +4239,18 @@ void GnomeCmdData::save()
     set_gsettings_when_changed      (options.gcmd_settings->general, GCMD_SETTINGS_CMDLINE_HISTORY_LENGTH, &(cmdline_history_length));
     set_gsettings_when_changed      (options.gcmd_settings->general, GCMD_SETTINGS_HORIZONTAL_ORIENTATION, &(horizontal_orientation));
     set_gsettings_when_changed      (options.gcmd_settings->general, GCMD_SETTINGS_GUI_UPDATE_RATE, &(gui_update_rate));
+    set_gsettings_when_changed      (options.gcmd_settings->general, GCMD_SETTINGS_STREAM_DIR_LISTING, &(stream_dir_listing));
+    set_gsettings_when_changed      (options.gcmd_settings->general, GCMD_SETTINGS_MONITOR_UPDATE_RATE, &(monitor_update_rate));
+    set_gsettings_when_changed      (options.gcmd_settings->general, GCMD_SETTINGS_LAZY_MIME_TYPES, &(lazy_mime_types));
+    set_gsettings_when_changed      (options.gcmd_settings->general, GCMD_SETTINGS_DIR_CACHE_SIZE, &(dir_cache_size));
+    set_gsettings_when_changed      (options.gcmd_settings->general, GCMD_SETTINGS_REVALIDATE_REMOTE_DIRS, &(revalidate_remote_dirs));
+    set_gsettings_when_changed      (options.gcmd_settings->general, GCMD_SETTINGS_PREFETCH_BUDGET, &(prefetch_budget));
+    set_gsettings_when_changed      (options.gcmd_settings->general, GCMD_SETTINGS_NAVIGATION_TIMEOUT, &(navigation_timeout));
+    set_gsettings_when_changed      (options.gcmd_settings->general, GCMD_SETTINGS_NATIVE_LOCAL_COPY, &(native_local_copy));
+    set_gsettings_when_changed      (options.gcmd_settings->general, GCMD_SETTINGS_COPY_WORKERS, &(copy_workers));
+    set_gsettings_when_changed      (options.gcmd_settings->general, GCMD_SETTINGS_XFER_JOBS_PER_DEVICE, &(xfer_jobs_per_device));
+    set_gsettings_when_changed      (options.gcmd_settings->general, GCMD_SETTINGS_CHECKPOINTED_XFERS, &(checkpointed_xfers));
+    set_gsettings_when_changed      (options.gcmd_settings->general, GCMD_SETTINGS_VERIFY_RESUMED_XFERS, &(verify_resumed_xfers));
     set_gsettings_when_changed      (options.gcmd_settings->general, GCMD_SETTINGS_MULTIPLE_INSTANCES, &(options.allow_multiple_instances));
     set_gsettings_enum_when_changed (options.gcmd_settings->general, GCMD_SETTINGS_QUICK_SEARCH_SHORTCUT, options.quick_search);
 
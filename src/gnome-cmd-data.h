@@ -80,6 +80,18 @@ GcmdSettings *gcmd_settings_new (void);
 #define GCMD_SETTINGS_SHOW_TOOLBAR                    "show-toolbar"
 #define GCMD_SETTINGS_SHOW_BUTTONBAR                  "show-buttonbar"
 #define GCMD_SETTINGS_GUI_UPDATE_RATE                 "gui-update-rate"
+#define GCMD_SETTINGS_STREAM_DIR_LISTING              "stream-dir-listing"
+#define GCMD_SETTINGS_MONITOR_UPDATE_RATE             "monitor-update-rate"
+#define GCMD_SETTINGS_LAZY_MIME_TYPES                 "lazy-mime-types"
+#define GCMD_SETTINGS_DIR_CACHE_SIZE                  "dir-cache-size"
+#define GCMD_SETTINGS_REVALIDATE_REMOTE_DIRS          "revalidate-remote-dirs"
+#define GCMD_SETTINGS_PREFETCH_BUDGET                 "prefetch-budget"
+#define GCMD_SETTINGS_NAVIGATION_TIMEOUT              "navigation-timeout"
+#define GCMD_SETTINGS_NATIVE_LOCAL_COPY               "native-local-copy"
+#define GCMD_SETTINGS_COPY_WORKERS                    "copy-workers"
+#define GCMD_SETTINGS_XFER_JOBS_PER_DEVICE            "xfer-jobs-per-device"
+#define GCMD_SETTINGS_CHECKPOINTED_XFERS              "checkpointed-xfers"
+#define GCMD_SETTINGS_VERIFY_RESUMED_XFERS            "verify-resumed-xfers"
 #define GCMD_SETTINGS_SYMLINK_PREFIX                  "symlink-string"
 #define GCMD_SETTINGS_MAIN_WIN_POS_X                  "main-win-pos-x"
 #define GCMD_SETTINGS_MAIN_WIN_POS_Y                  "main-win-pos-y"
@@ -629,6 +641,18 @@ struct GnomeCmdData
     guint                        dev_icon_size;
     guint                        fs_col_width[GnomeCmdFileList::NUM_COLUMNS];
     guint                        gui_update_rate;
+    gboolean                     stream_dir_listing;
+    guint                        monitor_update_rate;
+    gboolean                     lazy_mime_types;
+    guint                        dir_cache_size;            // in MiB, per connection
+    gboolean                     revalidate_remote_dirs;
+    guint                        prefetch_budget;           // in KiB per minute and connection, 0 turns prefetching off
+    guint                        navigation_timeout;        // in seconds
+    gboolean                     native_local_copy;
+    guint                        copy_workers;              // threads copying local files concurrently
+    guint                        xfer_jobs_per_device;      // transfers running at the same time on one disk or server
+    gboolean                     checkpointed_xfers;        // large local copies can be resumed, see xferjournal.h
+    gboolean                     verify_resumed_xfers;
 
     GList                       *cmdline_history;
     gint                         cmdline_history_length;
@@ -49,8 +49,10 @@ enum
     FILE_DELETED,
     FILE_CHANGED,
     FILE_RENAMED,
+    FILES_UPDATED,
     LIST_OK,
     LIST_FAILED,
+    LIST_PARTIAL,
     LAST_SIGNAL
 };
 
@@ -59,18 +61,27 @@ struct GnomeCmdDirPrivate
     GnomeVFSAsyncHandle *list_handle;
 
     gint ref_cnt;
-    GList *files;
     GnomeCmdFileCollection *file_collection;
     GnomeVFSResult last_result;
     GnomeCmdCon *con;
     GnomeCmdPath *path;
 
+    gboolean stream_started;
+    GList *pending_files;       // streamed files not yet announced by 'list-partial'
+    guint pending_cnt;
+    guint announced_cnt;
+
     gboolean lock;
     gboolean needs_mtime_update;
+    gboolean revalidating;
 
     Handle *handle;
     GnomeVFSMonitorHandle *monitor_handle;
     gint monitor_users;
+
+    GHashTable *monitor_events;     // uri_str -> last GnomeVFSMonitorEventType, collected for monitor_update_rate ms
+    guint monitor_events_id;
+    gboolean monitor_batch_running; // a batch of events is being stat'ed, the next one waits for it
 };
 
 
@@ -80,21 +91,198 @@ G_DEFINE_TYPE (GnomeCmdDir, gnome_cmd_dir, GNOME_CMD_TYPE_FILE)
 static guint signals[LAST_SIGNAL] = { 0 };
 
 
+/***********************************
+ * Coalescing the monitor events
+ *
+ * The events of a monitored dir are collected for monitor_update_rate ms,
+ * only the last event of each file counts. The files of such a batch are
+ * stat'ed by a worker thread and the main loop then compares the results
+ * with the file collection, so that a burst of events ends up as one
+ * 'files-updated' signal, no matter in which order the events came.
+ ***********************************/
+
+struct MonitorEvent
+{
+    gchar *uri_str;
+    gboolean deleted;
+    GnomeVFSFileInfo *info;     // set by the worker, NULL if the file is gone
+};
+
+
+struct MonitorBatch
+{
+    GnomeCmdDir *dir;
+    GList *events;
+};
+
+
+static GThreadPool *monitor_pool = NULL;
+
+static void queue_monitor_events (GnomeCmdDir *dir);
+
+
+static gboolean apply_monitor_batch (MonitorBatch *batch)
+{
+    GnomeCmdDir *dir = batch->dir;
+    GnomeCmdDirUpdate update = {NULL, NULL, NULL};
+
+    for (GList *i = batch->events; i; i = i->next)
+    {
+        MonitorEvent *event = (MonitorEvent *) i->data;
+        GnomeCmdFile *f = dir->priv->file_collection->find(event->uri_str);
+
+        if (!event->info)
+        {
+            if (f)
+            {
+                update.deleted = g_list_prepend (update.deleted, f->ref());
+                dir->priv->file_collection->remove(event->uri_str);
+            }
+        }
+        else
+            if (f)
+            {
+                f->update_info(event->info);
+                f->invalidate_metadata();
+                update.changed = g_list_prepend (update.changed, f);
+            }
+            else
+            {
+                if (event->info->type == GNOME_VFS_FILE_TYPE_DIRECTORY)
+                    f = GNOME_CMD_FILE (gnome_cmd_dir_new_from_info (event->info, dir));
+                else
+                    f = gnome_cmd_file_new (event->info, dir);
+
+                dir->priv->file_collection->add(f);
+                update.created = g_list_prepend (update.created, f);
+                event->info = NULL;         // taken over by f
+            }
+
+        if (event->info)
+            gnome_vfs_file_info_unref (event->info);
+        g_free (event->uri_str);
+        g_free (event);
+    }
+
+    g_list_free (batch->events);
+    g_free (batch);
+
+    DEBUG('n', "Monitor batch for %s: %d created, %d changed, %d deleted\n",
+          dir->priv->path->get_path(), g_list_length (update.created), g_list_length (update.changed), g_list_length (update.deleted));
+
+    if (update.created || update.changed || update.deleted)
+    {
+        dir->priv->needs_mtime_update = TRUE;
+        g_signal_emit (dir, signals[FILES_UPDATED], 0, &update);
+    }
+
+    g_list_free (update.created);
+    g_list_free (update.changed);
+    gnome_cmd_file_list_free (update.deleted);
+
+    dir->priv->monitor_batch_running = FALSE;
+
+    // events which came in meanwhile
+    if (dir->priv->monitor_events && g_hash_table_size (dir->priv->monitor_events) > 0)
+        queue_monitor_events (dir);
+
+    gnome_cmd_dir_unref (dir);
+
+    return FALSE;
+}
+
+
+static void stat_monitor_batch (MonitorBatch *batch, gpointer unused)
+{
+    GnomeVFSFileInfoOptions infoOpts = (GnomeVFSFileInfoOptions) (GNOME_VFS_FILE_INFO_FOLLOW_LINKS|GNOME_VFS_FILE_INFO_GET_MIME_TYPE);
+
+    for (GList *i = batch->events; i; i = i->next)
+    {
+        MonitorEvent *event = (MonitorEvent *) i->data;
+
+        if (event->deleted)
+            continue;
+
+        event->info = gnome_vfs_file_info_new ();
+
+        if (gnome_vfs_get_file_info (event->uri_str, event->info, infoOpts) != GNOME_VFS_OK)
+        {
+            DEBUG ('t', "Could not retrieve file information for %s\n", event->uri_str);
+            gnome_vfs_file_info_unref (event->info);
+            event->info = NULL;
+        }
+    }
+
+    g_idle_add ((GSourceFunc) apply_monitor_batch, batch);
+}
+
+
+static gboolean flush_monitor_events (GnomeCmdDir *dir)
+{
+    MonitorBatch *batch = g_new0 (MonitorBatch, 1);
+    GHashTableIter iter;
+    gpointer uri_str, event_type;
+
+    batch->dir = dir;           // takes over the reference of the timeout
+
+    g_hash_table_iter_init (&iter, dir->priv->monitor_events);
+
+    while (g_hash_table_iter_next (&iter, &uri_str, &event_type))
+    {
+        MonitorEvent *event = g_new0 (MonitorEvent, 1);
+
+        event->uri_str = (gchar *) uri_str;
+        event->deleted = GPOINTER_TO_INT (event_type) == GNOME_VFS_MONITOR_EVENT_DELETED;
+        batch->events = g_list_prepend (batch->events, event);
+
+        g_hash_table_iter_steal (&iter);
+    }
+
+    dir->priv->monitor_events_id = 0;
+    dir->priv->monitor_batch_running = TRUE;
+
+    if (!monitor_pool)
+        monitor_pool = g_thread_pool_new ((GFunc) stat_monitor_batch, NULL, 2, FALSE, NULL);
+
+    g_thread_pool_push (monitor_pool, batch, NULL);
+
+    return FALSE;
+}
+
+
+static void queue_monitor_events (GnomeCmdDir *dir)
+{
+    if (!dir->priv->monitor_events_id && !dir->priv->monitor_batch_running)
+        dir->priv->monitor_events_id = g_timeout_add (gnome_cmd_data.monitor_update_rate, (GSourceFunc) flush_monitor_events, gnome_cmd_dir_ref (dir));
+}
+
+
+inline void add_monitor_event (GnomeCmdDir *dir, const gchar *uri_str, GnomeVFSMonitorEventType event_type)
+{
+    if (!dir->priv->monitor_events)
+        dir->priv->monitor_events = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+    g_hash_table_replace (dir->priv->monitor_events, g_strdup (uri_str), GINT_TO_POINTER (event_type));
+
+    queue_monitor_events (dir);
+}
+
+
 static void monitor_callback (GnomeVFSMonitorHandle *handle, const gchar *monitor_uri, const gchar *info_uri, GnomeVFSMonitorEventType event_type, GnomeCmdDir *dir)
 {
     switch (event_type)
     {
         case GNOME_VFS_MONITOR_EVENT_CHANGED:
             DEBUG('n', "GNOME_VFS_MONITOR_EVENT_CHANGED for %s\n", info_uri);
-            gnome_cmd_dir_file_changed (dir, info_uri);
+            add_monitor_event (dir, info_uri, event_type);
             break;
         case GNOME_VFS_MONITOR_EVENT_DELETED:
             DEBUG('n', "GNOME_VFS_MONITOR_EVENT_DELETED for %s\n", info_uri);
-            gnome_cmd_dir_file_deleted (dir, info_uri);
+            add_monitor_event (dir, info_uri, event_type);
             break;
         case GNOME_VFS_MONITOR_EVENT_CREATED:
             DEBUG('n', "GNOME_VFS_MONITOR_EVENT_CREATED for %s\n", info_uri);
-            gnome_cmd_dir_file_created (dir, info_uri);
+            add_monitor_event (dir, info_uri, event_type);
             break;
         case GNOME_VFS_MONITOR_EVENT_METADATA_CHANGED:
         case GNOME_VFS_MONITOR_EVENT_STARTEXECUTING:
@@ -118,7 +306,6 @@ static void gnome_cmd_dir_init (GnomeCmdDir *dir)
     dir->priv->handle = handle_new (dir);
     // dir->priv->monitor_handle = NULL;
     // dir->priv->monitor_users = 0;
-    // dir->priv->files = NULL;
     dir->priv->file_collection = new GnomeCmdFileCollection;
 
     if (DEBUG_ENABLED ('c'))
@@ -137,6 +324,9 @@ static void gnome_cmd_dir_finalize (GObject *object)
 
     gnome_cmd_con_remove_from_cache (dir->priv->con, dir);
 
+    g_list_free (dir->priv->pending_files);
+    if (dir->priv->monitor_events)
+        g_hash_table_destroy (dir->priv->monitor_events);
     delete dir->priv->file_collection;
     delete dir->priv->path;
 
@@ -199,6 +389,16 @@ static void gnome_cmd_dir_class_init (GnomeCmdDirClass *klass)
             G_TYPE_NONE,
             1, G_TYPE_POINTER);
 
+    signals[FILES_UPDATED] =
+        g_signal_new ("files-updated",
+            G_TYPE_FROM_CLASS (klass),
+            G_SIGNAL_RUN_LAST,
+            G_STRUCT_OFFSET (GnomeCmdDirClass, files_updated),
+            NULL, NULL,
+            g_cclosure_marshal_VOID__POINTER,
+            G_TYPE_NONE,
+            1, G_TYPE_POINTER);
+
     signals[LIST_OK] =
         g_signal_new ("list-ok",
             G_TYPE_FROM_CLASS (klass),
@@ -219,13 +419,25 @@ static void gnome_cmd_dir_class_init (GnomeCmdDirClass *klass)
             G_TYPE_NONE,
             1, G_TYPE_INT);
 
+    signals[LIST_PARTIAL] =
+        g_signal_new ("list-partial",
+            G_TYPE_FROM_CLASS (klass),
+            G_SIGNAL_RUN_LAST,
+            G_STRUCT_OFFSET (GnomeCmdDirClass, list_partial),
+            NULL, NULL,
+            g_cclosure_marshal_VOID__POINTER,
+            G_TYPE_NONE,
+            1, G_TYPE_POINTER);
+
     object_class->finalize = gnome_cmd_dir_finalize;
     klass->file_created = NULL;
     klass->file_deleted = NULL;
     klass->file_changed = NULL;
     klass->file_renamed = NULL;
+    klass->files_updated = NULL;
     klass->list_ok = NULL;
     klass->list_failed = NULL;
+    klass->list_partial = NULL;
 }
 
 
@@ -298,6 +510,27 @@ GnomeCmdDir *gnome_cmd_dir_new_with_con (GnomeCmdCon *con)
 }
 
 
+#define NEW_DIR_INFO_OPTIONS ((GnomeVFSFileInfoOptions) (GNOME_VFS_FILE_INFO_FOLLOW_LINKS | \
+                                                       GNOME_VFS_FILE_INFO_GET_MIME_TYPE | \
+                                                       GNOME_VFS_FILE_INFO_FORCE_FAST_MIME_TYPE))
+
+
+// Takes over @a path and @a info
+static GnomeCmdDir *create_dir (GnomeCmdCon *con, GnomeCmdPath *path, GnomeVFSFileInfo *info)
+{
+    GnomeCmdDir *dir = (GnomeCmdDir *) g_object_new (GNOME_CMD_TYPE_DIR, NULL);
+    gnome_cmd_file_setup (GNOME_CMD_FILE (dir), info, NULL);
+
+    dir->priv->con = con;
+    gnome_cmd_dir_set_path (dir, path);
+    dir->priv->needs_mtime_update = FALSE;
+
+    gnome_cmd_con_add_to_cache (con, dir);
+
+    return dir;
+}
+
+
 GnomeCmdDir *gnome_cmd_dir_new (GnomeCmdCon *con, GnomeCmdPath *path)
 {
     g_return_val_if_fail (GNOME_CMD_IS_CON (con), NULL);
@@ -315,23 +548,11 @@ GnomeCmdDir *gnome_cmd_dir_new (GnomeCmdCon *con, GnomeCmdPath *path)
         return dir;
     }
 
-    GnomeVFSFileInfoOptions infoOpts = (GnomeVFSFileInfoOptions) (GNOME_VFS_FILE_INFO_FOLLOW_LINKS |
-                                                                  GNOME_VFS_FILE_INFO_GET_MIME_TYPE |
-                                                                  GNOME_VFS_FILE_INFO_FORCE_FAST_MIME_TYPE);
     GnomeVFSFileInfo *info = gnome_vfs_file_info_new ();
-    GnomeVFSResult res = gnome_vfs_get_file_info_uri (uri, info, infoOpts);
+    GnomeVFSResult res = gnome_vfs_get_file_info_uri (uri, info, NEW_DIR_INFO_OPTIONS);
 
     if (res == GNOME_VFS_OK)
-    {
-        dir = (GnomeCmdDir *) g_object_new (GNOME_CMD_TYPE_DIR, NULL);
-        gnome_cmd_file_setup (GNOME_CMD_FILE (dir), info, NULL);
-
-        dir->priv->con = con;
-        gnome_cmd_dir_set_path (dir, path);
-        dir->priv->needs_mtime_update = FALSE;
-
-        gnome_cmd_con_add_to_cache (con, dir);
-    }
+        dir = create_dir (con, path, info);
     else
     {
         gnome_cmd_show_message (*main_win, path->get_display_path(), gnome_vfs_result_to_string (res));
@@ -345,6 +566,166 @@ GnomeCmdDir *gnome_cmd_dir_new (GnomeCmdCon *con, GnomeCmdPath *path)
 }
 
 
+/***********************************
+ * Creating dirs without blocking
+ *
+ * A dir which isn't in the cache of its connection has to be stat'ed
+ * first, which is done by a worker thread. The request gives up after
+ * gnome_cmd_data.navigation_timeout seconds, a worker stuck on an
+ * unreachable mount then just finishes unnoticed, whenever it does.
+ ***********************************/
+
+struct GnomeCmdDirRequest
+{
+    GnomeCmdCon *con;
+    GnomeCmdPath *path;
+    gchar *uri_str;             // with the password, never to be shown
+    GnomeVFSFileInfo *info;
+    GnomeVFSResult result;
+    gboolean done;              // func has been called, or the request has been cancelled
+    guint timeout_id;
+    GnomeCmdDirReadyFunc func;
+    gpointer user_data;
+};
+
+
+static GThreadPool *stat_pool = NULL;
+
+
+inline void free_dir_request (GnomeCmdDirRequest *req)
+{
+    delete req->path;
+    if (req->info)
+        gnome_vfs_file_info_unref (req->info);
+    g_free (req->uri_str);
+    g_free (req);
+}
+
+
+// The worker is done with the request, so it's freed here whether func has been called already or not
+static gboolean deliver_dir_request (GnomeCmdDirRequest *req)
+{
+    if (!req->done)
+    {
+        req->done = TRUE;
+        g_source_remove (req->timeout_id);
+
+        DEBUG ('l', "Stat'ed %s: %s\n", req->path->get_path(), gnome_vfs_result_to_string (req->result));
+
+        GnomeCmdDir *dir = NULL;
+
+        if (req->result == GNOME_VFS_OK)
+        {
+            GnomeVFSURI *uri = gnome_cmd_con_create_uri (req->con, req->path);
+            gchar *uri_str = gnome_vfs_uri_to_string (uri, GNOME_VFS_URI_HIDE_PASSWORD);
+
+            // created by someone else meanwhile
+            dir = gnome_cmd_con_cache_lookup (req->con, uri_str);
+
+            if (!dir)
+            {
+                dir = create_dir (req->con, req->path, req->info);
+                req->path = NULL;
+                req->info = NULL;
+            }
+
+            g_free (uri_str);
+            gnome_vfs_uri_unref (uri);
+        }
+
+        req->func (dir, req->result, req->user_data);
+    }
+
+    free_dir_request (req);
+
+    return FALSE;
+}
+
+
+static void stat_dir (GnomeCmdDirRequest *req, gpointer unused)
+{
+    req->info = gnome_vfs_file_info_new ();
+    req->result = gnome_vfs_get_file_info (req->uri_str, req->info, NEW_DIR_INFO_OPTIONS);
+
+    if (req->result == GNOME_VFS_OK && req->info->type != GNOME_VFS_FILE_TYPE_DIRECTORY)
+        req->result = GNOME_VFS_ERROR_NOT_A_DIRECTORY;
+
+    g_idle_add ((GSourceFunc) deliver_dir_request, req);
+}
+
+
+static gboolean on_dir_request_timeout (GnomeCmdDirRequest *req)
+{
+    req->done = TRUE;
+    req->timeout_id = 0;
+
+    DEBUG ('l', "Timed out stat'ing %s\n", req->path->get_path());
+
+    req->func (NULL, GNOME_VFS_ERROR_TIMEOUT, req->user_data);
+
+    return FALSE;
+}
+
+
+GnomeCmdDirRequest *gnome_cmd_dir_new_async (GnomeCmdCon *con, GnomeCmdPath *path, GnomeCmdDirReadyFunc func, gpointer user_data)
+{
+    g_return_val_if_fail (GNOME_CMD_IS_CON (con), NULL);
+    g_return_val_if_fail (path != NULL, NULL);
+    g_return_val_if_fail (func != NULL, NULL);
+
+    GnomeVFSURI *uri = gnome_cmd_con_create_uri (con, path);
+
+    if (!uri)
+    {
+        delete path;
+        func (NULL, GNOME_VFS_ERROR_INVALID_URI, user_data);
+        return NULL;
+    }
+
+    gchar *uri_str = gnome_vfs_uri_to_string (uri, GNOME_VFS_URI_HIDE_PASSWORD);
+    GnomeCmdDir *dir = gnome_cmd_con_cache_lookup (con, uri_str);
+    g_free (uri_str);
+
+    if (dir)
+    {
+        gnome_vfs_uri_unref (uri);
+        delete path;
+        func (dir, GNOME_VFS_OK, user_data);
+        return NULL;
+    }
+
+    GnomeCmdDirRequest *req = g_new0 (GnomeCmdDirRequest, 1);
+
+    req->con = con;
+    req->path = path;
+    req->uri_str = gnome_vfs_uri_to_string (uri, GNOME_VFS_URI_HIDE_NONE);
+    req->func = func;
+    req->user_data = user_data;
+    req->timeout_id = g_timeout_add_seconds (gnome_cmd_data.navigation_timeout, (GSourceFunc) on_dir_request_timeout, req);
+
+    gnome_vfs_uri_unref (uri);
+
+    // no limit on the threads, a few of them may hang on unreachable mounts for good
+    if (!stat_pool)
+        stat_pool = g_thread_pool_new ((GFunc) stat_dir, NULL, -1, FALSE, NULL);
+
+    g_thread_pool_push (stat_pool, req, NULL);
+
+    return req;
+}
+
+
+void gnome_cmd_dir_request_cancel (GnomeCmdDirRequest *req)
+{
+    g_return_if_fail (req != NULL);
+    g_return_if_fail (!req->done);
+
+    req->done = TRUE;
+    g_source_remove (req->timeout_id);
+    req->timeout_id = 0;
+}
+
+
 GnomeCmdDir *gnome_cmd_dir_get_parent (GnomeCmdDir *dir)
 {
     g_return_val_if_fail (GNOME_CMD_IS_DIR (dir), NULL);
@@ -381,76 +762,205 @@ Handle *gnome_cmd_dir_get_handle (GnomeCmdDir *dir)
 }
 
 
+NameArena *gnome_cmd_dir_get_names (GnomeCmdDir *dir)
+{
+    g_return_val_if_fail (GNOME_CMD_IS_DIR (dir), NULL);
+
+    return dir->priv->file_collection->get_names();
+}
+
+
 GList *gnome_cmd_dir_get_files (GnomeCmdDir *dir)
 {
     g_return_val_if_fail (GNOME_CMD_IS_DIR (dir), NULL);
 
-    return dir->priv->files;
+    return dir->priv->file_collection->get_list();
 }
 
 
-static GList *create_file_list (GnomeCmdDir *dir, GList *info_list)
+// The approximate memory held by the listing of the dir, for the dir cache of its connection
+static gsize get_listing_size (GnomeCmdDir *dir)
+{
+    gsize bytes = 0;
+
+    for (GList *i = dir->priv->file_collection->get_list(); i; i = i->next)
+    {
+        GnomeCmdFile *f = (GnomeCmdFile *) i->data;
+        gsize name_len = f->info->name ? strlen (f->info->name) + 1 : 0;
+
+        // the file and its info, the collection's list and hash nodes, the name and in the arena its copy and collate key
+        bytes += sizeof(GnomeCmdFile) + sizeof(GnomeVFSFileInfo) + 6 * sizeof(gpointer);
+        bytes += 3 * name_len;
+
+        if (f->info->mime_type)
+            bytes += strlen (f->info->mime_type) + 1;
+        if (f->info->symlink_name)
+            bytes += strlen (f->info->symlink_name) + 1;
+    }
+
+    return bytes;
+}
+
+
+gboolean gnome_cmd_dir_drop_listing (GnomeCmdDir *dir)
+{
+    g_return_val_if_fail (GNOME_CMD_IS_DIR (dir), FALSE);
+
+    if (dir->priv->lock || dir->state == GnomeCmdDir::STATE_LISTING || gnome_cmd_dir_is_monitored (dir))
+        return FALSE;
+
+    DEBUG ('k', "Dropping the listing of 0x%p %s\n", dir, GNOME_CMD_FILE (dir)->get_name());
+
+    if (!dir->priv->file_collection->empty())
+        dir->priv->file_collection->clear();
+
+    // a panel entering the dir has to list it again instead of showing the empty collection
+    dir->state = GnomeCmdDir::STATE_EMPTY;
+
+    return TRUE;
+}
+
+
+// Creates GnomeCmdFile objects from the DirListEntries prepared by dirlist and adds them
+// to the file collection of the dir. The entries are consumed.
+static GList *create_file_list (GnomeCmdDir *dir, GList *entries)
 {
     GList *file_list = NULL;
 
-    // create a new list with GnomeCmdFile objects
+    dir->priv->file_collection->reserve(dir->priv->file_collection->size() + g_list_length (entries));
 
-    for (GList *i = info_list; i; i = i->next)
+    for (GList *i = entries; i; i = i->next)
     {
-        GnomeVFSFileInfo *info = (GnomeVFSFileInfo *) i->data;
+        DirListEntry *entry = (DirListEntry *) i->data;
+        GnomeVFSFileInfo *info = entry->info;
 
-        if (info && info->name)
+        if (!info || !info->name || strcmp (info->name, ".") == 0 || strcmp (info->name, "..") == 0)
         {
-
-            if (strcmp (info->name, ".") == 0 || strcmp (info->name, "..") == 0)
-            {
-                gnome_vfs_file_info_unref (info);
-                continue;
-            }
+            dirlist_free_entry (entry);
+            continue;
+        }
 
 #ifdef HAVE_SAMBA
-            GnomeCmdCon *con = gnome_cmd_dir_get_connection (dir);
-            if (GNOME_CMD_IS_CON_SMB (con)
-                && info->mime_type
-                && (strcmp (info->mime_type, "application/x-gnome-app-info") == 0 ||
-                    strcmp (info->mime_type, "application/x-desktop") == 0)
-                && strcmp (info->name, ".directory"))
-            {
-                // This is a hack to make samba workgroups etc
-                // look like normal directories
-                info->type = GNOME_VFS_FILE_TYPE_DIRECTORY;
-                // Determining smb MIME type: workgroup or server
-                gchar *uri_str = GNOME_CMD_FILE (dir)->get_uri_str();
-
-                info->mime_type = strcmp (uri_str, "smb:///") == 0 ? g_strdup ("x-directory/smb-workgroup") :
-                                                                     g_strdup ("x-directory/smb-server");
-            }
+        GnomeCmdCon *con = gnome_cmd_dir_get_connection (dir);
+        if (GNOME_CMD_IS_CON_SMB (con)
+            && info->mime_type
+            && (strcmp (info->mime_type, "application/x-gnome-app-info") == 0 ||
+                strcmp (info->mime_type, "application/x-desktop") == 0)
+            && strcmp (info->name, ".directory"))
+        {
+            // This is a hack to make samba workgroups etc
+            // look like normal directories
+            info->type = GNOME_VFS_FILE_TYPE_DIRECTORY;
+            // Determining smb MIME type: workgroup or server
+            gchar *uri_str = GNOME_CMD_FILE (dir)->get_uri_str();
+
+            info->mime_type = strcmp (uri_str, "smb:///") == 0 ? g_strdup ("x-directory/smb-workgroup") :
+                                                                 g_strdup ("x-directory/smb-server");
+        }
 #endif
 
-            GnomeCmdFile *f = info->type == GNOME_VFS_FILE_TYPE_DIRECTORY ? GNOME_CMD_FILE (gnome_cmd_dir_new_from_info (info, dir)) :
-                                                                            gnome_cmd_file_new (info, dir);
+        GnomeCmdFile *f;
 
-            gnome_cmd_file_ref (f);
-            file_list = g_list_append (file_list, f);
+        if (info->type == GNOME_VFS_FILE_TYPE_DIRECTORY)
+            f = GNOME_CMD_FILE (gnome_cmd_dir_new_from_info (info, dir));
+        else
+        {
+            f = gnome_cmd_file_new (info, dir, entry->collate_key, entry->names);
+            f->mime_type_guessed = entry->mime_guessed;
         }
+
+        gnome_cmd_file_ref (f);
+        dir->priv->file_collection->add(f);
+
+        file_list = g_list_prepend (file_list, f);
+        if (entry->names)
+            name_arena_unref (entry->names);
+        g_free (entry);
+    }
+
+    g_list_free (entries);
+
+    return g_list_reverse (file_list);
+}
+
+
+inline void emit_pending_files (GnomeCmdDir *dir)
+{
+    if (!dir->priv->pending_files)
+        return;
+
+    GList *files = dir->priv->pending_files;
+
+    dir->priv->announced_cnt += dir->priv->pending_cnt;
+    dir->priv->pending_files = NULL;
+    dir->priv->pending_cnt = 0;
+
+    DEBUG('l', "Emitting 'list-partial' signal, %d files so far\n", dir->priv->announced_cnt);
+    g_signal_emit (dir, signals[LIST_PARTIAL], 0, files);
+
+    g_list_free (files);
+}
+
+
+static void on_list_partial (GnomeCmdDir *dir, GList *entries)
+{
+    if (!dir->priv->stream_started)
+    {
+        if (!dir->priv->file_collection->empty())
+            dir->priv->file_collection->clear();
+
+        dir->priv->announced_cnt = 0;
+        dir->priv->stream_started = TRUE;
     }
 
-    return file_list;
+    GList *files = create_file_list (dir, entries);
+
+    dir->priv->pending_cnt += g_list_length (files);
+    dir->priv->pending_files = g_list_concat (dir->priv->pending_files, files);
+
+    // The first batch is announced at once so that the first screenful shows up immediately.
+    // After that a batch is held back until it is at least as big as everything announced
+    // before, which keeps the total cost of merging the batches into a file list linear
+    if (dir->priv->pending_cnt >= dir->priv->announced_cnt)
+        emit_pending_files (dir);
 }
 
 
 static void on_list_done (GnomeCmdDir *dir, GList *infolist, GnomeVFSResult result)
 {
+    gboolean streamed = dir->partial_func != NULL;
+
+    if (streamed)
+    {
+        // all files have already been created by on_list_partial (), the files still pending
+        // are shown along with all the others by the 'list-ok' handlers
+        dir->partial_func = NULL;
+
+        if (dir->state == GnomeCmdDir::STATE_LISTED && !dir->priv->stream_started && !dir->priv->file_collection->empty())
+            dir->priv->file_collection->clear();
+
+        // a failed or cancelled listing must not leave its partial batches behind,
+        // or they would be taken for a cached listing on the next visit
+        if (dir->state != GnomeCmdDir::STATE_LISTED && !dir->priv->file_collection->empty())
+            dir->priv->file_collection->clear();
+
+        g_list_free (dir->priv->pending_files);
+        dir->priv->pending_files = NULL;
+        dir->priv->pending_cnt = 0;
+        dir->priv->stream_started = FALSE;
+    }
+
     if (dir->state == GnomeCmdDir::STATE_LISTED)
     {
         DEBUG('l', "File listing succeded\n");
 
-        if (!dir->priv->file_collection->empty())
-            dir->priv->file_collection->clear();
+        if (!streamed)
+        {
+            if (!dir->priv->file_collection->empty())
+                dir->priv->file_collection->clear();
 
-        dir->priv->files = create_file_list (dir, infolist);
-        dir->priv->file_collection->add(dir->priv->files);
-        g_list_free (infolist);
+            g_list_free (create_file_list (dir, infolist));
+        }
 
         if (dir->dialog)
         {
@@ -460,13 +970,17 @@ static void on_list_done (GnomeCmdDir *dir, GList *infolist, GnomeVFSResult resu
         dir->priv->lock = FALSE;
         dir->priv->last_result = GNOME_VFS_OK;
 
+        gnome_cmd_con_cache_set_size (dir->priv->con, dir, get_listing_size (dir));
+
         DEBUG('l', "Emitting 'list-ok' signal\n");
-        g_signal_emit (dir, signals[LIST_OK], 0, dir->priv->files);
+        g_signal_emit (dir, signals[LIST_OK], 0, dir->priv->file_collection->get_list());
     }
     else if (dir->state == GnomeCmdDir::STATE_EMPTY)
     {
         DEBUG('l', "File listing failed: %s\n", gnome_vfs_result_to_string (result));
 
+        dirlist_free_entries (infolist);
+
         if (dir->dialog)
         {
             gtk_widget_destroy (dir->dialog);
@@ -533,6 +1047,15 @@ void gnome_cmd_dir_relist_files (GnomeCmdDir *dir, gboolean visprog)
 
     dir->done_func = (DirListDoneFunc) on_list_done;
 
+    if (gnome_cmd_data.stream_dir_listing)
+    {
+        dir->partial_func = (DirListPartialFunc) on_list_partial;
+        dirlist_stream (dir);
+        return;
+    }
+
+    dir->partial_func = NULL;
+
     if (visprog)
         create_list_progress_dialog (dir);
 
@@ -540,11 +1063,64 @@ void gnome_cmd_dir_relist_files (GnomeCmdDir *dir, gboolean visprog)
 }
 
 
+gboolean gnome_cmd_dir_prefetch (GnomeCmdDir *dir)
+{
+    g_return_val_if_fail (GNOME_CMD_IS_DIR (dir), FALSE);
+
+    if (dir->priv->lock || dir->state != GnomeCmdDir::STATE_EMPTY)
+        return FALSE;
+
+    dir->priv->lock = TRUE;
+
+    DEBUG ('l', "prefetching files for 0x%p %s\n", dir, dir->priv->path->get_path());
+
+    dir->done_func = (DirListDoneFunc) on_list_done;
+    dir->partial_func = NULL;
+
+    dirlist_prefetch (dir);
+
+    return TRUE;
+}
+
+
+void gnome_cmd_dir_cancel_listing (GnomeCmdDir *dir)
+{
+    g_return_if_fail (GNOME_CMD_IS_DIR (dir));
+
+    if (dir->state != GnomeCmdDir::STATE_LISTING)
+        return;
+
+    DEBUG('l', "Cancelling the listing of %s\n", dir->priv->path->get_path());
+
+    // on_list_done () gets to unlock the dir and to emit 'list-failed' anyway
+    dirlist_cancel (dir);
+
+    if (dir->dialog)
+    {
+        gtk_widget_destroy (dir->dialog);
+        dir->dialog = NULL;
+    }
+}
+
+
 void gnome_cmd_dir_list_files (GnomeCmdDir *dir, gboolean visprog)
 {
     g_return_if_fail (GNOME_CMD_IS_DIR (dir));
 
-    if (!dir->priv->files || gnome_cmd_dir_is_local (dir))
+    gboolean cached = dir->state == GnomeCmdDir::STATE_LISTED && !gnome_cmd_dir_is_local (dir);
+
+    gnome_cmd_con_cache_touch (dir->priv->con, dir, cached);
+
+    if (DEBUG_ENABLED ('k'))
+    {
+        GnomeCmdConCacheStats stats;
+
+        gnome_cmd_con_get_cache_stats (dir->priv->con, &stats);
+        DEBUG ('k', "Dir cache of %s: %u dirs, %" G_GUINT64_FORMAT " bytes, %u hits, %u misses, %u evictions\n",
+               gnome_cmd_con_get_alias (dir->priv->con), stats.dirs, stats.bytes, stats.hits, stats.misses, stats.evictions);
+    }
+
+    if (!cached)
     {
         DEBUG ('l', "relisting files for 0x%x %s %d\n",
                dir,
@@ -553,7 +1129,122 @@ void gnome_cmd_dir_list_files (GnomeCmdDir *dir, gboolean visprog)
         gnome_cmd_dir_relist_files (dir, visprog);
     }
     else
-        g_signal_emit (dir, signals[LIST_OK], 0, dir->priv->files);
+    {
+        g_signal_emit (dir, signals[LIST_OK], 0, dir->priv->file_collection->get_list());
+
+        if (gnome_cmd_data.revalidate_remote_dirs)
+            gnome_cmd_dir_revalidate (dir);
+    }
+}
+
+
+inline gboolean info_differs (GnomeVFSFileInfo *a, GnomeVFSFileInfo *b)
+{
+    return a->type != b->type ||
+           a->mtime != b->mtime ||
+           a->size != b->size ||
+           a->permissions != b->permissions ||
+           a->uid != b->uid ||
+           a->gid != b->gid ||
+           g_strcmp0 (a->symlink_name, b->symlink_name) != 0;
+}
+
+
+// Applies the difference between the cached files and a fresh listing as one 'files-updated' signal
+static void on_revalidated (GnomeCmdDir *dir, gboolean changed, GList *entries, time_t mtime, GnomeVFSResult result)
+{
+    dir->priv->revalidating = FALSE;
+
+    // relisted or dropped meanwhile, or the cached listing is kept as it is
+    if (dir->priv->lock || dir->state != GnomeCmdDir::STATE_LISTED || !changed || result != GNOME_VFS_OK)
+    {
+        dirlist_free_entries (entries);
+        return;
+    }
+
+    GnomeCmdDirUpdate update = {NULL, NULL, NULL};
+    GHashTable *seen = g_hash_table_new (g_direct_hash, g_direct_equal);
+    GList *new_entries = NULL;
+
+    for (GList *i = entries; i; i = i->next)
+    {
+        DirListEntry *entry = (DirListEntry *) i->data;
+        GnomeCmdFile *f = entry->info->name ? dir->priv->file_collection->find_by_name(entry->info->name) : NULL;
+
+        if (!f || f->info->type != entry->info->type)
+        {
+            new_entries = g_list_prepend (new_entries, entry);
+            continue;
+        }
+
+        g_hash_table_add (seen, f);
+
+        if (info_differs (f->info, entry->info))
+        {
+            f->update_info(entry->info);
+            f->mime_type_guessed = entry->mime_guessed;
+            f->invalidate_metadata();
+            update.changed = g_list_prepend (update.changed, f);
+        }
+
+        dirlist_free_entry (entry);
+    }
+
+    g_list_free (entries);
+
+    GHashTable *deleted = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+    for (GList *i = dir->priv->file_collection->get_list(); i; i = i->next)
+    {
+        GnomeCmdFile *f = (GnomeCmdFile *) i->data;
+
+        if (g_hash_table_contains (seen, f))
+            continue;
+
+        update.deleted = g_list_prepend (update.deleted, f->ref());
+        g_hash_table_add (deleted, f);
+    }
+
+    // in one pass over the collection, however many files are gone
+    dir->priv->file_collection->remove(deleted);
+
+    g_hash_table_destroy (deleted);
+    g_hash_table_destroy (seen);
+
+    // the files of the replaced entries are removed above, so that they can be created again
+    update.created = create_file_list (dir, g_list_reverse (new_entries));
+
+    GNOME_CMD_FILE (dir)->info->mtime = mtime;
+    dir->priv->needs_mtime_update = FALSE;
+
+    DEBUG('l', "Revalidated %s: %d created, %d changed, %d deleted\n",
+          dir->priv->path->get_path(), g_list_length (update.created), g_list_length (update.changed), g_list_length (update.deleted));
+
+    if (update.created || update.changed || update.deleted)
+    {
+        gnome_cmd_con_cache_set_size (dir->priv->con, dir, get_listing_size (dir));
+        g_signal_emit (dir, signals[FILES_UPDATED], 0, &update);
+    }
+
+    g_list_free (update.created);
+    g_list_free (update.changed);
+    gnome_cmd_file_list_free (update.deleted);
+}
+
+
+void gnome_cmd_dir_revalidate (GnomeCmdDir *dir)
+{
+    g_return_if_fail (GNOME_CMD_IS_DIR (dir));
+
+    // monitored dirs are kept up to date by their monitor
+    if (gnome_cmd_dir_is_monitored (dir))
+        return;
+
+    if (dir->priv->lock || dir->priv->revalidating || dir->state != GnomeCmdDir::STATE_LISTED)
+        return;
+
+    dir->priv->revalidating = TRUE;
+    dirlist_revalidate (dir, on_revalidated);
 }
 
 
@@ -717,7 +1408,6 @@ void gnome_cmd_dir_file_created (GnomeCmdDir *dir, const gchar *uri_str)
         f = gnome_cmd_file_new (info, dir);
 
     dir->priv->file_collection->add(f);
-    dir->priv->files = dir->priv->file_collection->get_list();
 
     dir->priv->needs_mtime_update = TRUE;
 
@@ -741,7 +1431,6 @@ void gnome_cmd_dir_file_deleted (GnomeCmdDir *dir, const gchar *uri_str)
     g_signal_emit (dir, signals[FILE_DELETED], 0, f);
 
     dir->priv->file_collection->remove(uri_str);
-    dir->priv->files = dir->priv->file_collection->get_list();
 }
 
 
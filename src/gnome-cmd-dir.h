@@ -34,14 +34,25 @@ GType gnome_cmd_dir_get_type ();
 
 struct GnomeCmdDir;
 struct GnomeCmdDirPrivate;
+struct DirListLocal;
 
 typedef void (* DirListDoneFunc) (GnomeCmdDir *dir, GList *files, GnomeVFSResult result);
+typedef void (* DirListPartialFunc) (GnomeCmdDir *dir, GList *files);
+
+// The files of a monitored dir which have changed within one monitor_update_rate window
+struct GnomeCmdDirUpdate
+{
+    GList *created;
+    GList *changed;
+    GList *deleted;         // already removed from the dir, but still alive while the signal is emitted
+};
 
 #include <string>
 
 #include "gnome-cmd-file.h"
 #include "gnome-cmd-path.h"
 #include "handle.h"
+#include "namearena.h"
 
 struct GnomeCmdDir
 {
@@ -60,11 +71,14 @@ struct GnomeCmdDir
     gint voffset;
     GList *infolist;
     GnomeVFSAsyncHandle *list_handle;
+    DirListLocal *list_local;   // set instead of list_handle while a local dir is listed without GnomeVFS
     GnomeVFSResult list_result;
     gint list_counter;
+    gint list_prep_pending;     // batches still being prepared by the listing worker threads
     State state;
 
     DirListDoneFunc done_func;
+    DirListPartialFunc partial_func;    // set while streaming, takes over each prepared batch of DirListEntries
 
     GtkWidget *dialog;
     GtkWidget *label;
@@ -79,8 +93,10 @@ struct GnomeCmdDirClass
     void (* file_deleted)       (GnomeCmdDir *dir, GnomeCmdFile *file);
     void (* file_changed)       (GnomeCmdDir *dir, GnomeCmdFile *file);
     void (* file_renamed)       (GnomeCmdDir *dir, GnomeCmdFile *file);
+    void (* files_updated)      (GnomeCmdDir *dir, GnomeCmdDirUpdate *update);
     void (* list_ok)            (GnomeCmdDir *dir, GList *files);
     void (* list_failed)        (GnomeCmdDir *dir, GnomeVFSResult result);
+    void (* list_partial)       (GnomeCmdDir *dir, GList *files);
 };
 
 struct GnomeCmdCon;
@@ -88,11 +104,31 @@ struct GnomeCmdCon;
 GnomeCmdDir *gnome_cmd_dir_new_from_info (GnomeVFSFileInfo *info, GnomeCmdDir *parent);
 GnomeCmdDir *gnome_cmd_dir_new_with_con (GnomeCmdCon *con);
 GnomeCmdDir *gnome_cmd_dir_new (GnomeCmdCon *con, GnomeCmdPath *path);
+
+struct GnomeCmdDirRequest;
+
+typedef void (* GnomeCmdDirReadyFunc) (GnomeCmdDir *dir, GnomeVFSResult result, gpointer user_data);
+
+/**
+ * Like gnome_cmd_dir_new (), but a dir which isn't cached yet is stat'ed
+ * by a worker thread and @a func is called in the main loop, with
+ * GNOME_VFS_ERROR_TIMEOUT after gnome_cmd_data.navigation_timeout
+ * seconds. For cached dirs @a func is called right away and NULL is
+ * returned. Takes over @a path.
+ */
+GnomeCmdDirRequest *gnome_cmd_dir_new_async (GnomeCmdCon *con, GnomeCmdPath *path, GnomeCmdDirReadyFunc func, gpointer user_data);
+
+// Must not be called once func has been called
+void gnome_cmd_dir_request_cancel (GnomeCmdDirRequest *req);
+
 GnomeCmdDir *gnome_cmd_dir_get_parent (GnomeCmdDir *dir);
 GnomeCmdDir *gnome_cmd_dir_get_child (GnomeCmdDir *dir, const gchar *child);
 GnomeCmdCon *gnome_cmd_dir_get_connection (GnomeCmdDir *dir);
 Handle *gnome_cmd_dir_get_handle (GnomeCmdDir *dir);
 
+// The arena for the names and collate keys of the current listing of @a dir
+NameArena *gnome_cmd_dir_get_names (GnomeCmdDir *dir);
+
 inline GnomeCmdFile *gnome_cmd_dir_new_parent_dir_file (GnomeCmdDir *dir)
 {
     GnomeVFSFileInfo *info = gnome_vfs_file_info_new ();
@@ -150,6 +186,28 @@ void gnome_cmd_dir_start_monitoring (GnomeCmdDir *dir);
 void gnome_cmd_dir_cancel_monitoring (GnomeCmdDir *dir);
 gboolean gnome_cmd_dir_is_monitored (GnomeCmdDir *dir);
 gboolean gnome_cmd_dir_is_local (GnomeCmdDir *dir);
+
+/**
+ * Frees the files of @a dir unless it's being listed or watched by a
+ * panel, they are read again by the next gnome_cmd_dir_list_files ().
+ * Returns FALSE if the listing has to be kept.
+ */
+gboolean gnome_cmd_dir_drop_listing (GnomeCmdDir *dir);
+
+/**
+ * Checks in the background whether the cached listing of a dir which no
+ * panel is watching is still up to date. If not, the dir is listed again and only the
+ * difference is applied, by one 'files-updated' signal.
+ */
+void gnome_cmd_dir_revalidate (GnomeCmdDir *dir);
+
+/**
+ * Lists @a dir in the background at the lowest priority, without any
+ * dialog, unless it's listed already. A panel entering the dir meanwhile
+ * just waits for this listing. Returns FALSE if nothing was started.
+ */
+gboolean gnome_cmd_dir_prefetch (GnomeCmdDir *dir);
+void gnome_cmd_dir_cancel_listing (GnomeCmdDir *dir);
 void gnome_cmd_dir_set_content_changed (GnomeCmdDir *dir);
 
 gboolean gnome_cmd_dir_update_mtime (GnomeCmdDir *dir);
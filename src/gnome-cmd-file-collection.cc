@@ -23,18 +23,120 @@
 
 #include "gnome-cmd-includes.h"
 #include "gnome-cmd-file-collection.h"
+#include "gnome-cmd-parallel-sort.h"
+
+#include <algorithm>
 
 using namespace std;
 
 
+#define UNREF_BATCH 5000        // files finalized per main loop iteration when a big collection goes away
+
+static GQueue unref_queue = G_QUEUE_INIT;       // GPtrArrays of files still reffed by freed collections
+static guint unref_source_id = 0;
+
+
+static gboolean unref_next_batch (gpointer unused)
+{
+    GPtrArray *files = (GPtrArray *) g_queue_peek_head (&unref_queue);
+    guint n = MIN (files->len, UNREF_BATCH);
+
+    for (guint i = files->len - n; i < files->len; ++i)
+        gnome_cmd_file_unref ((GnomeCmdFile *) g_ptr_array_index (files, i));
+
+    g_ptr_array_set_size (files, files->len - n);
+
+    if (files->len == 0)
+    {
+        g_ptr_array_free (files, TRUE);
+        g_queue_pop_head (&unref_queue);
+    }
+
+    if (!g_queue_is_empty (&unref_queue))
+        return TRUE;
+
+    unref_source_id = 0;
+
+    return FALSE;
+}
+
+
+GHashTable *gnome_cmd_file_collection_new_map (GnomeCmdFileCollection::Key key)
+{
+    if (key==GnomeCmdFileCollection::KEY_NAME)
+        return g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GDestroyNotify) gnome_cmd_file_unref);
+
+    return g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) gnome_cmd_file_unref);
+}
+
+
+// Leaving or relisting a huge dir doesn't wait for all of its files to be finalized,
+// they are unreffed in batches from the main loop
+void gnome_cmd_file_collection_free_map (GHashTable *map)
+{
+    if (g_hash_table_size (map) <= UNREF_BATCH)
+    {
+        g_hash_table_destroy (map);
+        return;
+    }
+
+    GPtrArray *files = g_ptr_array_sized_new (g_hash_table_size (map));
+    GHashTableIter iter;
+    gpointer f;
+
+    g_hash_table_iter_init (&iter, map);
+    while (g_hash_table_iter_next (&iter, NULL, &f))
+        g_ptr_array_add (files, f);
+
+    g_hash_table_steal_all (map);
+    g_hash_table_destroy (map);
+
+    g_queue_push_tail (&unref_queue, files);
+
+    if (!unref_source_id)
+        unref_source_id = g_idle_add (unref_next_batch, NULL);
+}
+
+
+// The last part of @a uri_str, which is enough for the files of a single dir
+inline gchar *get_name_from_uri (const gchar *uri_str)
+{
+    const gchar *s = strrchr (uri_str, '/');
+
+    return gnome_vfs_unescape_string (s ? s+1 : uri_str, NULL);
+}
+
+
 void GnomeCmdFileCollection::add(GnomeCmdFile *f)
 {
     g_return_if_fail (GNOME_CMD_IS_FILE (f));
 
-    list = g_list_append (list, f);
+    if (key==KEY_FILE)
+    {
+        if (g_hash_table_contains (map, f))
+            return;
+
+        g_hash_table_insert (map, f, f);
+    }
+    else
+    {
+        // the file of the same name isn't there anymore, the new one takes its place in the vector too
+        GnomeCmdFile *old = find_by_name(f->info->name);
+
+        if (old == f)
+            return;
 
-    gchar *uri_str = f->get_uri_str();
-    g_hash_table_insert (map, uri_str, f);
+        vector<GnomeCmdFile *>::iterator i = old ? std::find (files.begin(), files.end(), old) : files.end();
+
+        if (i!=files.end())
+            files.erase(i);
+
+        // a replaced key stays in the arena until the collection is cleared, which is rare enough
+        g_hash_table_insert (map, (gpointer) name_arena_add (names, f->info->name), f);
+    }
+
+    files.push_back(f);
+    invalidate_list();
     f->ref();
 }
 
@@ -43,13 +145,49 @@ gboolean GnomeCmdFileCollection::remove(GnomeCmdFile *f)
 {
     g_return_val_if_fail (GNOME_CMD_IS_FILE (f), FALSE);
 
-    list = g_list_remove (list, f);
+    // another file of the same name is left alone
+    if (key==KEY_NAME && find_by_name(f->info->name) != f)
+        return FALSE;
+
+    vector<GnomeCmdFile *>::iterator i = std::find (files.begin(), files.end(), f);
+
+    if (i!=files.end())
+    {
+        files.erase(i);
+        invalidate_list();
+    }
+
+    return g_hash_table_remove (map, key==KEY_NAME ? (gconstpointer) f->info->name : (gconstpointer) f);
+}
+
 
-    gchar *uri_str = f->get_uri_str();
-    gboolean retval = g_hash_table_remove (map, uri_str);
-    g_free (uri_str);
+guint GnomeCmdFileCollection::remove(GHashTable *file_set)
+{
+    g_return_val_if_fail (file_set != NULL, 0);
+
+    vector<GnomeCmdFile *> removed;
+    vector<GnomeCmdFile *>::iterator kept = files.begin();
+
+    // every file in the vector is the one in the map, under its name for KEY_NAME
+    for (vector<GnomeCmdFile *>::iterator i=files.begin(); i!=files.end(); ++i)
+        if (g_hash_table_contains (file_set, *i))
+        {
+            g_hash_table_steal (map, key==KEY_NAME ? (gconstpointer) (*i)->info->name : (gconstpointer) *i);
+            removed.push_back(*i);
+        }
+        else
+            *kept++ = *i;
+
+    files.erase(kept, files.end());
+
+    if (!removed.empty())
+        invalidate_list();
 
-    return retval;
+    // not before the vector is consistent again, a finalized file may be looked up
+    for (vector<GnomeCmdFile *>::iterator i=removed.begin(); i!=removed.end(); ++i)
+        gnome_cmd_file_unref (*i);
+
+    return removed.size();
 }
 
 
@@ -57,13 +195,9 @@ gboolean GnomeCmdFileCollection::remove(const gchar *uri_str)
 {
     g_return_val_if_fail (uri_str != NULL, FALSE);
 
-    GnomeCmdFile *file = find(uri_str);
-
-    if (!file)
-        return FALSE;
+    GnomeCmdFile *f = find(uri_str);
 
-    list = g_list_remove (list, file);
-    return g_hash_table_remove (map, uri_str);
+    return f ? remove(f) : FALSE;
 }
 
 
@@ -71,22 +205,66 @@ GnomeCmdFile *GnomeCmdFileCollection::find(const gchar *uri_str)
 {
     g_return_val_if_fail (uri_str != NULL, NULL);
 
-    return GNOME_CMD_FILE (g_hash_table_lookup (map, uri_str));
+    gchar *name = get_name_from_uri (uri_str);
+    GnomeCmdFile *f = NULL;
+
+    if (key==KEY_NAME)
+        f = name ? find_by_name(name) : NULL;
+    else
+        // files from many dirs, only the ones of the same name are compared by their URIs
+        for (vector<GnomeCmdFile *>::iterator i=files.begin(); name && !f && i!=files.end(); ++i)
+            if (strcmp ((*i)->info->name, name) == 0)
+            {
+                gchar *s = (*i)->get_uri_str();
+
+                if (strcmp (s, uri_str) == 0)
+                    f = *i;
+                g_free (s);
+            }
+
+    g_free (name);
+
+    return f;
 }
 
 
-void GnomeCmdFileCollection::clear()
+GList *GnomeCmdFileCollection::get_list()
 {
+    if (!list_is_stale)
+        return list;
+
     g_list_free (list);
     list = NULL;
-    g_hash_table_destroy (map);
-    map = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) gnome_cmd_file_unref);
+
+    for (vector<GnomeCmdFile *>::reverse_iterator i=files.rbegin(); i!=files.rend(); ++i)
+        list = g_list_prepend (list, *i);
+
+    list_is_stale = FALSE;
+
+    return list;
+}
+
+
+void GnomeCmdFileCollection::clear()
+{
+    vector<GnomeCmdFile *>().swap(files);
+    invalidate_list();
+    gnome_cmd_file_collection_free_map (map);
+    map = gnome_cmd_file_collection_new_map (key);
+
+    // the files still around keep the old arena for their collation keys
+    if (names)
+    {
+        name_arena_unref (names);
+        names = name_arena_new ();
+    }
 }
 
 
 GList *GnomeCmdFileCollection::sort(GCompareDataFunc compare_func, gpointer user_data)
 {
-    list = g_list_sort_with_data (list, compare_func, user_data);
+    GnomeCmd::parallel_stable_sort (files.data(), files.data() + files.size(), GnomeCmd::CompareDataLess(compare_func, user_data));
+    invalidate_list();
 
-    return list;
+    return get_list();
 }
@@ -21,52 +21,120 @@
 
 #pragma once
 
+#include <vector>
+
 #include "gnome-cmd-file.h"
+#include "namearena.h"
 
 
+/**
+ * A set of files. The files of a single directory, KEY_NAME, are looked
+ * up by their names, which are kept in the collection's NameArena; the
+ * files of the directory share it for their collation keys. Files from
+ * any number of dirs, like the ones shown in a panel or found by a
+ * search, may share names, so they are keyed by the files themselves,
+ * KEY_FILE.
+ */
 class GnomeCmdFileCollection
 {
-    GHashTable *map;
-    GList *list;
+  public:
+
+    enum Key
+    {
+        KEY_NAME,
+        KEY_FILE
+    };
+
+  private:
+
+    Key key;
+    GHashTable *map;                        // name or file -> GnomeCmdFile, the names are in the arena
+    NameArena *names;                       // NULL for KEY_FILE
+    std::vector<GnomeCmdFile *> files;      // contiguous storage, in order of insertion
+    GList *list;                            // built on demand by get_list()
+    gboolean list_is_stale;
+
+    void invalidate_list()  {  list_is_stale = TRUE;  }
 
   public:
 
-    GnomeCmdFileCollection();
+    explicit GnomeCmdFileCollection(Key key=KEY_NAME);
     ~GnomeCmdFileCollection();
 
-    guint size()        {  return g_list_length (list);  }
-    gboolean empty()    {  return list==NULL;            }
+    guint size()        {  return files.size();   }
+    gboolean empty()    {  return files.empty();  }
+    void reserve(guint n);
     void clear();
 
+    NameArena *get_names()      {  return names;  }       // KEY_NAME only
+
     void add(GnomeCmdFile *f);
-    void add(GList *files);
+    void add(GList *file_list);
     gboolean remove(GnomeCmdFile *f);
-    gboolean remove(const gchar *uri_str);
-
-    GList *get_list()   {  return list;  }
-
+    gboolean remove(const gchar *uri_str);                              // see find(uri_str)
+    guint remove(GHashTable *file_set);        // the files which are keys of file_set, in one pass, returns how many were removed
+
+    /**
+     * Returns the files as a GList. The list is owned by the collection
+     * and stays valid until the next call to get_list() following
+     * a change of the collection
+     */
+    GList *get_list();
+
+    /**
+     * Looks the file up by its name for KEY_NAME. For KEY_FILE the files of
+     * that name are scanned and their URIs compared, so don't use it on
+     * the collections shown in the panels, look them up by file instead
+     */
     GnomeCmdFile *find(const gchar *uri_str);
+    GnomeCmdFile *find_by_name(const gchar *name);     // KEY_NAME only
 
-    GList *sort(GCompareDataFunc compare_func, gpointer user_data);
+    GList *sort(GCompareDataFunc compare_func, gpointer user_data);      // compare_func may be called from several threads at once
 };
 
 
-inline GnomeCmdFileCollection::GnomeCmdFileCollection()
+GHashTable *gnome_cmd_file_collection_new_map (GnomeCmdFileCollection::Key key);
+void gnome_cmd_file_collection_free_map (GHashTable *map);
+
+
+inline GnomeCmdFileCollection::GnomeCmdFileCollection(Key key): key(key)
 {
-    map = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) gnome_cmd_file_unref);
+    map = gnome_cmd_file_collection_new_map (key);
+    names = key==KEY_NAME ? name_arena_new () : NULL;
     list = NULL;
+    list_is_stale = FALSE;
 }
 
 
 inline GnomeCmdFileCollection::~GnomeCmdFileCollection()
 {
-    g_hash_table_destroy (map);
+    gnome_cmd_file_collection_free_map (map);
+    if (names)
+        name_arena_unref (names);
     g_list_free (list);
 }
 
 
-inline void GnomeCmdFileCollection::add(GList *files)
+inline GnomeCmdFile *GnomeCmdFileCollection::find_by_name(const gchar *name)
+{
+    g_return_val_if_fail (key==KEY_NAME, NULL);
+
+    return GNOME_CMD_FILE (g_hash_table_lookup (map, name));
+}
+
+
+inline void GnomeCmdFileCollection::reserve(guint n)
 {
-    for (; files; files = files->next)
-        add(GNOME_CMD_FILE (files->data));
+    // grow geometrically, so that repeated reservations for incoming batches stay amortized O(1) per file
+    if (n > files.capacity())
+        files.reserve(MAX (n, 2*files.capacity()));
+}
+
+
+inline void GnomeCmdFileCollection::add(GList *file_list)
+{
+    reserve (size() + g_list_length (file_list));
+
+    for (; file_list; file_list = file_list->next)
+        add(GNOME_CMD_FILE (file_list->data));
 }
@@ -40,6 +40,10 @@
 #include "gnome-cmd-file-popmenu.h"
 #include "gnome-cmd-quicksearch-popup.h"
 #include "gnome-cmd-file-collection.h"
+#include "gnome-cmd-parallel-sort.h"
+#include "treesize.h"
+#include "mimeresolver.h"
+#include "prefetch.h"
 #include "ls_colors.h"
 #include "dialogs/gnome-cmd-delete-dialog.h"
 #include "dialogs/gnome-cmd-patternsel-dialog.h"
@@ -61,6 +65,17 @@ using namespace std;
 
 #define FL_PBAR_MAX 50
 
+/* Files created in the shown directory are collected for gui_update_rate ms and then
+ * inserted together. Up to this many are inserted one by one, bigger bursts are merged
+ * into the list in a single pass.
+ */
+#define MAX_SINGLE_INSERTS 16
+
+/* The time (in ms) the cursor has to rest on a remote dir before it's prefetched,
+ * together with the parent and the neighbours in the dir history.
+ */
+#define PREFETCH_DELAY 300
+
 
 enum
 {
@@ -71,6 +86,7 @@ enum
     FILES_CHANGED,       // The visible content of the file list has changed (files have been: selected, created, deleted or modified)
     DIR_CHANGED,         // The current directory has been changed
     CON_CHANGED,         // The current connection has been changed
+    LOADING_CHANGED,     // A directory has started or stopped loading, see is_loading()
     LAST_SIGNAL
 };
 
@@ -110,6 +126,8 @@ struct GnomeCmdFileListColumn
 };
 
 
+static void format_row (GnomeCmdCList *clist, gint row, GtkCListRow *clist_row, GnomeCmdFileList *fl);
+
 static gint sort_by_name (GnomeCmdFile *f1, GnomeCmdFile *f2, GnomeCmdFileList *fl);
 static gint sort_by_ext (GnomeCmdFile *f1, GnomeCmdFile *f2, GnomeCmdFileList *fl);
 static gint sort_by_dir (GnomeCmdFile *f1, GnomeCmdFile *f2, GnomeCmdFileList *fl);
@@ -143,19 +161,48 @@ struct GnomeCmdFileListClass
     void (* files_changed)       (GnomeCmdFileList *fl);
     void (* dir_changed)         (GnomeCmdFileList *fl, GnomeCmdDir *dir);
     void (* con_changed)         (GnomeCmdFileList *fl, GnomeCmdCon *con);
+    void (* loading_changed)     (GnomeCmdFileList *fl);
+};
+
+
+// A dir tree size being counted for the file list
+struct TreeSizeRequest
+{
+    GnomeCmdFileList *fl;
+    GnomeCmdFile *f;            // reffed
+    TreeSizeJob *job;           // NULL once the job is done
+    GnomeVFSFileSize size;      // counted so far
+};
+
+
+static void free_tree_size_request (TreeSizeRequest *req);
+
+
+// A real MIME type being looked up for the MIME icon of a file, see mimeresolver.h
+struct MimeTypeRequest
+{
+    GnomeCmdFileList *fl;
+    MimeRequest *req;           // NULL once the type has been resolved
+    gboolean visible;
 };
 
 
+static void free_mime_type_request (MimeTypeRequest *req);
+
+
 struct GnomeCmdFileList::Private
 {
     GtkWidget *column_pixmaps[NUM_COLUMNS];
     GtkWidget *column_labels[NUM_COLUMNS];
 
     gint cur_file;
-    GnomeCmdFileCollection visible_files;
+    GnomeCmdFileCollection visible_files;       // KEY_FILE, search results come from many dirs
     GnomeCmd::Collection<GnomeCmdFile *> selected_files;      // contains GnomeCmdFile pointers, no refing
+    GHashTable *file_rows;          // GnomeCmdFile* -> row+1 of every file in the clist, kept in sync with the rows
 
     gchar *base_dir;
+    const gchar *dir_text_dirname;  // interned dirname of the file formatted last...
+    gchar *dir_text;                // ...and the text of its dir column, shared by the following files of the same dir
 
     GCompareDataFunc sort_func;
     gint current_col;
@@ -170,6 +217,24 @@ struct GnomeCmdFileList::Private
     GtkWidget *quicksearch_popup;
     gchar *focus_later;
 
+    GnomeCmdDir *streamed_dir;      // the dir whose listing is being streamed into the list, if any
+
+    GList *pending_inserts;         // reffed files created in the connected dir, waiting to be inserted in one go
+    guint pending_inserts_id;
+
+    GHashTable *tree_sizes;         // GnomeCmdFile -> TreeSizeRequest, dir sizes being counted
+    GHashTable *mime_types;         // GnomeCmdFile -> MimeTypeRequest, guessed MIME types being resolved
+    guint prefetch_id;
+
+    GnomeCmdDirRequest *dir_request;    // the dir goto_directory() is waiting for
+    gchar *goto_path;
+    gchar *goto_focus;              // the file to focus once the dir is there
+    gboolean listing;               // cwd is being listed
+    gboolean loading;               // as last announced by 'loading-changed'
+    guint loading_watch_id;
+    gint loading_counter;           // cwd->list_counter when the watch looked last time
+    guint loading_stalled;          // seconds without any progress
+
     gboolean autoscroll_dir;
     guint autoscroll_timeout;
     gint autoscroll_y;
@@ -190,17 +255,34 @@ struct GnomeCmdFileList::Private
 };
 
 
-GnomeCmdFileList::Private::Private(GnomeCmdFileList *fl)
+GnomeCmdFileList::Private::Private(GnomeCmdFileList *fl): visible_files(GnomeCmdFileCollection::KEY_FILE)
 {
     memset(column_pixmaps, 0, sizeof(column_pixmaps));
     memset(column_labels, 0, sizeof(column_labels));
 
     base_dir = NULL;
+    dir_text_dirname = NULL;
+    dir_text = NULL;
 
     quicksearch_popup = NULL;
     selpat_dialog = NULL;
 
     focus_later = NULL;
+    streamed_dir = NULL;
+    pending_inserts = NULL;
+    pending_inserts_id = 0;
+    file_rows = g_hash_table_new (g_direct_hash, g_direct_equal);
+    tree_sizes = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) free_tree_size_request);
+    mime_types = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) free_mime_type_request);
+    prefetch_id = 0;
+    dir_request = NULL;
+    goto_path = NULL;
+    goto_focus = NULL;
+    listing = FALSE;
+    loading = FALSE;
+    loading_watch_id = 0;
+    loading_counter = 0;
+    loading_stalled = 0;
     shift_down = FALSE;
     shift_down_row = 0;
     right_mb_sel_state = FALSE;
@@ -237,6 +319,22 @@ GnomeCmdFileList::Private::Private(GnomeCmdFileList *fl)
 
 GnomeCmdFileList::Private::~Private()
 {
+    if (pending_inserts_id)
+        g_source_remove (pending_inserts_id);
+    gnome_cmd_file_list_free (pending_inserts);
+    if (prefetch_id)
+        g_source_remove (prefetch_id);
+    prefetch_cancel (this);
+    if (dir_request)
+        gnome_cmd_dir_request_cancel (dir_request);
+    if (loading_watch_id)
+        g_source_remove (loading_watch_id);
+    g_free (goto_path);
+    g_free (goto_focus);
+    g_hash_table_destroy (file_rows);
+    g_hash_table_destroy (tree_sizes);
+    g_hash_table_destroy (mime_types);
+    g_free (dir_text);
     g_object_unref (ifac);
 }
 
@@ -280,6 +378,8 @@ GnomeCmdFileList::GnomeCmdFileList(ColumnID sort_col, GtkSortType sort_order)
     priv->sort_raising[sort_col] = sort_order;
     priv->sort_func = file_list_column[sort_col].sort_func;
 
+    gnome_cmd_clist_set_format_func (*this, (GnomeCmdCListFormatFunc) format_row, this);
+
     create_column_titles();
 }
 
@@ -294,17 +394,149 @@ inline gchar *strip_extension (const gchar *fname)
 }
 
 
+#define MAX_CACHED_STRINGS 4096
+
+
+/**
+ * Formatted column strings keyed by (value, display mode), shared by all
+ * file lists. The cache starts over when the display mode changes or when
+ * it has grown to MAX_CACHED_STRINGS entries.
+ */
+class FormatCache
+{
+    GHashTable *strings;        // gint64 value -> formatted string
+    gint mode;
+
+  public:
+
+    typedef const gchar *(* FormatFunc) (gint64 value);
+
+    FormatCache(): strings(NULL), mode(-1)     {}
+
+    const gchar *get(gint64 value, gint value_mode, FormatFunc format);
+};
+
+
+const gchar *FormatCache::get(gint64 value, gint value_mode, FormatFunc format)
+{
+    if (!strings || mode != value_mode || g_hash_table_size (strings) >= MAX_CACHED_STRINGS)
+    {
+        if (strings)
+            g_hash_table_destroy (strings);
+        strings = g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free, g_free);
+        mode = value_mode;
+    }
+
+    gchar *s = (gchar *) g_hash_table_lookup (strings, &value);
+
+    if (!s)
+    {
+        gint64 *key = g_new (gint64, 1);
+        *key = value;
+        s = g_strdup (format (value));
+        g_hash_table_insert (strings, key, s);
+    }
+
+    return s;
+}
+
+
+static const gchar *format_size (gint64 size)
+{
+    return size2string (size, gnome_cmd_data.options.size_disp_mode);
+}
+
+
+static const gchar *format_date (gint64 date)
+{
+    return time2string ((time_t) date, gnome_cmd_data.options.date_format);
+}
+
+
+static const gchar *format_perm (gint64 perm)
+{
+    static gchar perm_str[10];
+
+    return perm2string ((GnomeVFSFilePermissions) perm, perm_str, sizeof(perm_str));
+}
+
+
+// The seconds told apart by a strftime () format, 1 if it shows them and 60 otherwise
+static gint get_date_granularity (const gchar *date_format)
+{
+    for (const gchar *s = date_format ? strchr (date_format, '%') : NULL; s; s = strchr (s, '%'))
+    {
+        // flags, field width and the E and O modifiers come before the conversion
+        for (++s; *s && strchr ("_-0^#123456789EO", *s); ++s);
+
+        if (!*s)
+            break;
+
+        if (strchr ("STscrX+", *s))
+            return 1;
+
+        ++s;        // the second % of %% as well
+    }
+
+    return 60;
+}
+
+
+/**
+ * The date format is a string, this turns it into a mode number which
+ * changes whenever the format does. @a granularity is set to the seconds
+ * the format tells apart.
+ */
+inline gint date_format_mode (gint &granularity)
+{
+    static gchar *date_format = NULL;
+    static gint mode = 0;
+    static gint date_granularity = 1;
+
+    if (g_strcmp0 (date_format, gnome_cmd_data.options.date_format) != 0)
+    {
+        g_free (date_format);
+        date_format = g_strdup (gnome_cmd_data.options.date_format);
+        date_granularity = get_date_granularity (date_format);
+        mode++;
+    }
+
+    granularity = date_granularity;
+
+    return mode;
+}
+
+
+/**
+ * The key of @a mtime in date_strings: all the times shown alike share
+ * one entry, so that a dir of files written over an hour needs 60 strings
+ * rather than thousands. Times are cut to whole minutes in UTC, which are
+ * whole minutes of the local time too, as the time zone offsets in use
+ * since the 1970s are.
+ */
+inline gint64 date_key (time_t mtime, gint granularity)
+{
+    gint64 t = mtime;
+
+    return t - ((t % granularity) + granularity) % granularity;
+}
+
+
+static FormatCache size_strings;
+static FormatCache date_strings;
+static FormatCache perm_strings;
+
+
 struct FileFormatData
 {
     gchar *text[GnomeCmdFileList::NUM_COLUMNS];
 
-    gchar *dpath;
     gchar *fname;
     gchar *fext;
 
     static gchar empty_string[];
 
-    FileFormatData(GnomeCmdFileList *fl, GnomeCmdFile *f, gboolean tree_size);
+    FileFormatData(GnomeCmdFileList *fl, GnomeCmdFile *f, GnomeVFSFileSize tree_size);     // tree_size is -1 if not known
     ~FileFormatData();
 };
 
@@ -312,7 +544,7 @@ struct FileFormatData
 gchar FileFormatData::empty_string[] = "";
 
 
-FileFormatData::FileFormatData(GnomeCmdFileList *fl, GnomeCmdFile *f, gboolean tree_size)
+FileFormatData::FileFormatData(GnomeCmdFileList *fl, GnomeCmdFile *f, GnomeVFSFileSize tree_size)
 {
     // If the user wants a character instead of icon for filetype set it now
     if (gnome_cmd_data.options.layout == GNOME_CMD_LAYOUT_TEXT)
@@ -320,12 +552,31 @@ FileFormatData::FileFormatData(GnomeCmdFileList *fl, GnomeCmdFile *f, gboolean t
     else
         text[GnomeCmdFileList::COLUMN_ICON] = NULL;
 
-    // Prepare the strings to show
-    gchar *t1 = f->get_path();
-    gchar *t2 = g_path_get_dirname (t1);
-    dpath = get_utf8 (t2);
-    g_free (t1);
-    g_free (t2);
+    // Prepare the strings to show, files of the same dir share the text of the dir column
+    const gchar *dirname = f->get_sort_dirname();
+
+    if (dirname != fl->priv->dir_text_dirname)
+    {
+        gchar *t1 = f->get_path();
+        gchar *t2 = g_path_get_dirname (t1);
+        gchar *dpath = get_utf8 (t2);
+        g_free (t1);
+        g_free (t2);
+
+        g_free (fl->priv->dir_text);
+
+        if (fl->priv->base_dir != NULL)
+        {
+            fl->priv->dir_text = g_strconcat (".", dpath + (strlen(fl->priv->base_dir)-1), NULL);
+            g_free (dpath);
+        }
+        else
+            fl->priv->dir_text = dpath;
+
+        fl->priv->dir_text_dirname = dirname;
+    }
+
+    text[GnomeCmdFileList::COLUMN_DIR] = fl->priv->dir_text;
 
     if (gnome_cmd_data.options.ext_disp_mode == GNOME_CMD_EXT_DISP_STRIPPED
         && f->info->type == GNOME_VFS_FILE_TYPE_REGULAR)
@@ -337,11 +588,6 @@ FileFormatData::FileFormatData(GnomeCmdFileList *fl, GnomeCmdFile *f, gboolean t
     else
         fname = get_utf8 (f->get_name());
 
-    if (fl->priv->base_dir != NULL)
-        text[GnomeCmdFileList::COLUMN_DIR] = g_strconcat(get_utf8("."), dpath + (strlen(fl->priv->base_dir)-1), NULL);
-    else 
-        text[GnomeCmdFileList::COLUMN_DIR] = dpath;
-
     DEBUG ('l', "FileFormatData text[GnomeCmdFileList::COLUMN_DIR]=[%s]\n", text[GnomeCmdFileList::COLUMN_DIR]);
 
     if (gnome_cmd_data.options.ext_disp_mode != GNOME_CMD_EXT_DISP_WITH_FNAME)
@@ -353,12 +599,19 @@ FileFormatData::FileFormatData(GnomeCmdFileList *fl, GnomeCmdFile *f, gboolean t
     text[GnomeCmdFileList::COLUMN_NAME]  = fname;
     text[GnomeCmdFileList::COLUMN_EXT]   = fext;
 
-    text[GnomeCmdFileList::COLUMN_SIZE]  = tree_size ? (gchar *) f->get_tree_size_as_str() : (gchar *) f->get_size();
+    if (f->info->type == GNOME_VFS_FILE_TYPE_DIRECTORY && (tree_size == (GnomeVFSFileSize) -1 || f->is_dotdot))
+        text[GnomeCmdFileList::COLUMN_SIZE] = (gchar *) f->get_size();
+    else
+        text[GnomeCmdFileList::COLUMN_SIZE] = (gchar *) size_strings.get(f->info->type == GNOME_VFS_FILE_TYPE_DIRECTORY ? tree_size : f->info->size,
+                                                                         gnome_cmd_data.options.size_disp_mode, format_size);
 
     if (f->info->type != GNOME_VFS_FILE_TYPE_DIRECTORY || !f->is_dotdot)
     {
-        text[GnomeCmdFileList::COLUMN_DATE]  = (gchar *) f->get_mdate(FALSE);
-        text[GnomeCmdFileList::COLUMN_PERM]  = (gchar *) f->get_perm();
+        gint granularity;
+        gint mode = date_format_mode (granularity);
+
+        text[GnomeCmdFileList::COLUMN_DATE]  = (gchar *) date_strings.get(date_key (f->info->mtime, granularity), mode, format_date);
+        text[GnomeCmdFileList::COLUMN_PERM]  = (gchar *) perm_strings.get(f->info->permissions, gnome_cmd_data.options.perm_disp_mode, format_perm);
         text[GnomeCmdFileList::COLUMN_OWNER] = (gchar *) f->get_owner();
         text[GnomeCmdFileList::COLUMN_GROUP] = (gchar *) f->get_group();
     }
@@ -374,7 +627,6 @@ FileFormatData::FileFormatData(GnomeCmdFileList *fl, GnomeCmdFile *f, gboolean t
 
 FileFormatData::~FileFormatData()
 {
-    g_free (dpath);
     g_free (fname);
     g_free (fext);
 }
@@ -900,10 +1152,13 @@ static gint sort_by_name (GnomeCmdFile *f1, GnomeCmdFile *f2, GnomeCmdFileList *
     if (f2->is_dotdot)
         return 1;
 
-    if (f1->info->type > f2->info->type)
+    const GnomeCmdFile::SortKey &k1 = f1->get_sort_key();
+    const GnomeCmdFile::SortKey &k2 = f2->get_sort_key();
+
+    if (k1.type > k2.type)
         return -1;
 
-    if (f1->info->type < f2->info->type)
+    if (k1.type < k2.type)
         return 1;
 
     gboolean raising = fl->priv->sort_raising[fl->priv->current_col];
@@ -920,23 +1175,26 @@ static gint sort_by_ext (GnomeCmdFile *f1, GnomeCmdFile *f2, GnomeCmdFileList *f
     if (f2->is_dotdot)
         return 1;
 
-    if (f1->info->type > f2->info->type)
+    const GnomeCmdFile::SortKey &k1 = f1->get_sort_key();
+    const GnomeCmdFile::SortKey &k2 = f2->get_sort_key();
+
+    if (k1.type > k2.type)
         return -1;
 
-    if (f1->info->type < f2->info->type)
+    if (k1.type < k2.type)
         return 1;
 
     gboolean raising = fl->priv->sort_raising[fl->priv->current_col];
 
-    if (!f1->get_extension() && !f2->get_extension())
+    if (!k1.extension && !k2.extension)
         return my_strcmp (f1->get_collation_fname(), f2->get_collation_fname(), fl->priv->sort_raising[1]);
 
-    if (!f1->get_extension())
+    if (!k1.extension)
         return raising?1:-1;
-    if (!f2->get_extension())
+    if (!k2.extension)
         return raising?-1:1;
 
-    gint ret = my_strcmp (f1->get_extension(), f2->get_extension(), raising);
+    gint ret = my_strcmp (k1.extension, k2.extension, raising);
 
     return ret ? ret : my_strcmp (f1->get_collation_fname(), f2->get_collation_fname(), fl->priv->sort_raising[1]);
 }
@@ -950,20 +1208,21 @@ static gint sort_by_dir (GnomeCmdFile *f1, GnomeCmdFile *f2, GnomeCmdFileList *f
     if (f2->is_dotdot)
         return 1;
 
-    if (f1->info->type > f2->info->type)
+    const GnomeCmdFile::SortKey &k1 = f1->get_sort_key();
+    const GnomeCmdFile::SortKey &k2 = f2->get_sort_key();
+
+    if (k1.type > k2.type)
         return -1;
 
-    if (f1->info->type < f2->info->type)
+    if (k1.type < k2.type)
         return 1;
 
     gboolean raising = fl->priv->sort_raising[fl->priv->current_col];
-    gchar *dirname1 = f1->get_dirname();
-    gchar *dirname2 = f2->get_dirname();
+    const gchar *dirname1 = f1->get_sort_dirname();
+    const gchar *dirname2 = f2->get_sort_dirname();
 
-    gint ret = my_strcmp (dirname1, dirname2, raising);
-
-    g_free (dirname1);
-    g_free (dirname2);
+    // dirnames are interned, files from the same dir don't need to be compared
+    gint ret = dirname1 == dirname2 ? 0 : my_strcmp (dirname1, dirname2, raising);
 
     if (!ret)
         ret = my_strcmp (f1->get_collation_fname(), f2->get_collation_fname(), raising);
@@ -980,14 +1239,17 @@ static gint sort_by_size (GnomeCmdFile *f1, GnomeCmdFile *f2, GnomeCmdFileList *
     if (f2->is_dotdot)
         return 1;
 
+    const GnomeCmdFile::SortKey &k1 = f1->get_sort_key();
+    const GnomeCmdFile::SortKey &k2 = f2->get_sort_key();
+
     gboolean raising = fl->priv->sort_raising[fl->priv->current_col];
     gboolean file_raising = fl->priv->sort_raising[1];
 
-    gint ret = my_intcmp (f1->info->type, f2->info->type, TRUE);
+    gint ret = my_intcmp (k1.type, k2.type, TRUE);
 
     if (!ret)
     {
-        ret = my_filesizecmp (f1->info->size, f2->info->size, raising);
+        ret = my_filesizecmp (k1.size, k2.size, raising);
         if (!ret)
             ret = my_strcmp (f1->get_collation_fname(), f2->get_collation_fname(), file_raising);
     }
@@ -1003,13 +1265,16 @@ static gint sort_by_perm (GnomeCmdFile *f1, GnomeCmdFile *f2, GnomeCmdFileList *
     if (f2->is_dotdot)
         return 1;
 
+    const GnomeCmdFile::SortKey &k1 = f1->get_sort_key();
+    const GnomeCmdFile::SortKey &k2 = f2->get_sort_key();
+
     gboolean raising = fl->priv->sort_raising[fl->priv->current_col];
     gboolean file_raising = fl->priv->sort_raising[1];
 
-    gint ret = my_intcmp (f1->info->type, f2->info->type, TRUE);
+    gint ret = my_intcmp (k1.type, k2.type, TRUE);
     if (!ret)
     {
-        ret = my_intcmp (f1->info->permissions, f2->info->permissions, raising);
+        ret = my_intcmp (k1.permissions, k2.permissions, raising);
         if (!ret)
             ret = my_strcmp (f1->get_collation_fname(), f2->get_collation_fname(), file_raising);
     }
@@ -1025,13 +1290,16 @@ static gint sort_by_date (GnomeCmdFile *f1, GnomeCmdFile *f2, GnomeCmdFileList *
     if (f2->is_dotdot)
         return 1;
 
+    const GnomeCmdFile::SortKey &k1 = f1->get_sort_key();
+    const GnomeCmdFile::SortKey &k2 = f2->get_sort_key();
+
     gboolean raising = fl->priv->sort_raising[fl->priv->current_col];
     gboolean file_raising = fl->priv->sort_raising[1];
 
-    gint ret = my_intcmp (f1->info->type, f2->info->type, TRUE);
+    gint ret = my_intcmp (k1.type, k2.type, TRUE);
     if (!ret)
     {
-        ret = my_intcmp (f1->info->mtime, f2->info->mtime, raising);
+        ret = my_intcmp (k1.mtime, k2.mtime, raising);
         if (!ret)
             ret = my_strcmp (f1->get_collation_fname(), f2->get_collation_fname(), file_raising);
     }
@@ -1047,13 +1315,16 @@ static gint sort_by_owner (GnomeCmdFile *f1, GnomeCmdFile *f2, GnomeCmdFileList
     if (f2->is_dotdot)
         return 1;
 
+    const GnomeCmdFile::SortKey &k1 = f1->get_sort_key();
+    const GnomeCmdFile::SortKey &k2 = f2->get_sort_key();
+
     gboolean raising = fl->priv->sort_raising[fl->priv->current_col];
     gboolean file_raising = fl->priv->sort_raising[1];
 
-    gint ret = my_intcmp (f1->info->type, f2->info->type, TRUE);
+    gint ret = my_intcmp (k1.type, k2.type, TRUE);
     if (!ret)
     {
-        ret = my_intcmp (f1->info->uid, f2->info->uid, raising);
+        ret = my_intcmp (k1.uid, k2.uid, raising);
         if (!ret)
             ret = my_strcmp (f1->get_collation_fname(), f2->get_collation_fname(), file_raising);
     }
@@ -1069,13 +1340,16 @@ static gint sort_by_group (GnomeCmdFile *f1, GnomeCmdFile *f2, GnomeCmdFileList
     if (f2->is_dotdot)
         return 1;
 
+    const GnomeCmdFile::SortKey &k1 = f1->get_sort_key();
+    const GnomeCmdFile::SortKey &k2 = f2->get_sort_key();
+
     gboolean raising = fl->priv->sort_raising[fl->priv->current_col];
     gboolean file_raising = fl->priv->sort_raising[1];
 
-    gint ret = my_intcmp (f1->info->type, f2->info->type, TRUE);
+    gint ret = my_intcmp (k1.type, k2.type, TRUE);
     if (!ret)
     {
-        ret = my_intcmp (f1->info->gid, f2->info->gid, raising);
+        ret = my_intcmp (k1.gid, k2.gid, raising);
         if (!ret)
             ret = my_strcmp (f1->get_collation_fname(), f2->get_collation_fname(), file_raising);
     }
@@ -1083,6 +1357,43 @@ static gint sort_by_group (GnomeCmdFile *f1, GnomeCmdFile *f2, GnomeCmdFileList
 }
 
 
+// Builds the sort keys of the files up front, so that a sort pass only compares them
+inline void prepare_sort_keys (GnomeCmdFileList *fl, GList *files)
+{
+    gboolean by_dir = fl->priv->current_col == GnomeCmdFileList::COLUMN_DIR;
+
+    for (; files; files = files->next)
+    {
+        GnomeCmdFile *f = (GnomeCmdFile *) files->data;
+
+        f->get_sort_key();
+        if (by_dir)
+            f->get_sort_dirname();
+    }
+}
+
+
+// Sorts a list of files in the current sort order, on several threads for big lists
+static GList *sort_files (GnomeCmdFileList *fl, GList *files)
+{
+    vector<GnomeCmdFile *> v;
+
+    prepare_sort_keys (fl, files);
+
+    for (GList *i = files; i; i = i->next)
+        v.push_back((GnomeCmdFile *) i->data);
+
+    GnomeCmd::parallel_stable_sort (v.data(), v.data() + v.size(), GnomeCmd::CompareDataLess(fl->priv->sort_func, fl));
+
+    // reuse the list nodes for the sorted files
+    GList *i = files;
+    for (vector<GnomeCmdFile *>::iterator j=v.begin(); j!=v.end(); ++j, i = i->next)
+        i->data = *j;
+
+    return files;
+}
+
+
 /*******************************
  * Callbacks
  *******************************/
@@ -1103,6 +1414,78 @@ static gint sort_by_group (GnomeCmdFile *f1, GnomeCmdFile *f2, GnomeCmdFileList
 }
 
 
+// Only dirs which exist already are prefetched, creating one would stat it in the main loop
+static GnomeCmdDir *lookup_dir (GnomeCmdCon *con, GnomeCmdPath *path)
+{
+    if (!path)
+        return NULL;
+
+    GnomeVFSURI *uri = gnome_cmd_con_create_uri (con, path);
+    delete path;
+
+    if (!uri)
+        return NULL;
+
+    gchar *uri_str = gnome_vfs_uri_to_string (uri, GNOME_VFS_URI_HIDE_PASSWORD);
+    GnomeCmdDir *dir = gnome_cmd_con_cache_lookup (con, uri_str);
+
+    g_free (uri_str);
+    gnome_vfs_uri_unref (uri);
+
+    return dir;
+}
+
+
+static gboolean prefetch_likely_dirs (GnomeCmdFileList *fl)
+{
+    fl->priv->prefetch_id = 0;
+
+    if (!fl->cwd || !fl->con)
+        return FALSE;
+
+    GList *dirs = NULL;
+    GnomeCmdFile *f = fl->get_focused_file();
+
+    if (f && GNOME_CMD_IS_DIR (f) && !f->is_dotdot)
+        dirs = g_list_append (dirs, f);
+
+    GnomeCmdDir *dir = lookup_dir (fl->con, gnome_cmd_dir_get_path (fl->cwd)->get_parent());
+
+    if (dir)
+        dirs = g_list_append (dirs, dir);
+
+    History *history = gnome_cmd_con_get_dir_history (fl->con);
+    const gchar *neighbours[] = {history->peek_back(), history->peek_forward()};
+
+    for (guint i=0; i<G_N_ELEMENTS(neighbours); ++i)
+        if (neighbours[i] && (dir = lookup_dir (fl->con, gnome_cmd_con_create_path (fl->con, neighbours[i]))))
+            dirs = g_list_append (dirs, dir);
+
+    prefetch_dirs (fl->priv, dirs);
+    g_list_free (dirs);
+
+    return FALSE;
+}
+
+
+inline void schedule_prefetch (GnomeCmdFileList *fl)
+{
+    if (!gnome_cmd_data.prefetch_budget || !fl->con || gnome_cmd_con_is_local (fl->con))
+        return;
+
+    if (fl->priv->prefetch_id)
+        g_source_remove (fl->priv->prefetch_id);
+
+    fl->priv->prefetch_id = g_timeout_add (PREFETCH_DELAY, (GSourceFunc) prefetch_likely_dirs, fl);
+}
+
+
+static void on_select_row (GtkCList *clist, gint row, gint column, GdkEvent *event, GnomeCmdFileList *fl)
+{
+    schedule_prefetch (fl);
+}
+
+
 static void on_scroll_vertical (GtkCList *clist, GtkScrollType scroll_type, gfloat position, GnomeCmdFileList *fl)
 {
     g_return_if_fail (GTK_IS_CLIST (clist));
@@ -1247,6 +1630,8 @@ static void mime_exec_single (GnomeCmdFile *f)
     GnomeVFSMimeApplication *vfs_app;
     GnomeCmdApp *app;
 
+    f->resolve_mime_type();
+
     if (!f->info->mime_type)
         return;
 
@@ -1511,12 +1896,63 @@ static void on_realize (GnomeCmdFileList *fl, gpointer user_data)
 }
 
 
+static gboolean insert_created_files (GnomeCmdFileList *fl, GList *files)
+{
+    gboolean inserted = FALSE;
+
+    DEBUG('l', "Inserting %d created files\n", g_list_length (files));
+
+    if (g_list_length (files) > MAX_SINGLE_INSERTS)
+        inserted = fl->insert_files(files);
+    else
+        for (GList *i = files; i; i = i->next)
+            if (fl->insert_file(GNOME_CMD_FILE (i->data)))
+                inserted = TRUE;
+
+    return inserted;
+}
+
+
+static gboolean insert_pending_files (GnomeCmdFileList *fl)
+{
+    GList *files = g_list_reverse (fl->priv->pending_inserts);
+
+    fl->priv->pending_inserts = NULL;
+    fl->priv->pending_inserts_id = 0;
+
+    gboolean inserted = insert_created_files (fl, files);
+
+    gnome_cmd_file_list_free (files);
+
+    if (inserted)
+        g_signal_emit (fl, signals[FILES_CHANGED], 0);
+
+    return FALSE;
+}
+
+
+inline void discard_pending_files (GnomeCmdFileList *fl)
+{
+    if (fl->priv->pending_inserts_id)
+    {
+        g_source_remove (fl->priv->pending_inserts_id);
+        fl->priv->pending_inserts_id = 0;
+    }
+
+    gnome_cmd_file_list_free (fl->priv->pending_inserts);
+    fl->priv->pending_inserts = NULL;
+}
+
+
 static void on_dir_file_created (GnomeCmdDir *dir, GnomeCmdFile *f, GnomeCmdFileList *fl)
 {
     g_return_if_fail (GNOME_CMD_IS_FILE_LIST (fl));
 
-    if (fl->insert_file(f))
-        g_signal_emit (fl, signals[FILES_CHANGED], 0);
+    // a burst of created files is inserted in one go, see insert_pending_files ()
+    fl->priv->pending_inserts = g_list_prepend (fl->priv->pending_inserts, gnome_cmd_file_ref (f));
+
+    if (!fl->priv->pending_inserts_id)
+        fl->priv->pending_inserts_id = g_timeout_add (gnome_cmd_data.gui_update_rate, (GSourceFunc) insert_pending_files, fl);
 }
 
 
@@ -1524,6 +1960,15 @@ static void on_dir_file_deleted (GnomeCmdDir *dir, GnomeCmdFile *f, GnomeCmdFile
 {
     g_return_if_fail (GNOME_CMD_IS_FILE_LIST (fl));
 
+    GList *pending = g_list_find (fl->priv->pending_inserts, f);
+
+    if (pending)
+    {
+        fl->priv->pending_inserts = g_list_delete_link (fl->priv->pending_inserts, pending);
+        gnome_cmd_file_unref (f);
+        return;
+    }
+
     if (fl->cwd == dir)
         if (fl->remove_file(f))
             g_signal_emit (fl, signals[FILES_CHANGED], 0);
@@ -1542,6 +1987,47 @@ static void on_dir_file_changed (GnomeCmdDir *dir, GnomeCmdFile *f, GnomeCmdFile
 }
 
 
+// All changes of the connected dir within one monitor window, see gnome-cmd-dir.cc
+static void on_dir_files_updated (GnomeCmdDir *dir, GnomeCmdDirUpdate *update, GnomeCmdFileList *fl)
+{
+    g_return_if_fail (GNOME_CMD_IS_FILE_LIST (fl));
+
+    gboolean changed = FALSE;
+
+    gtk_clist_freeze (*fl);
+
+    for (GList *i = update->deleted; i; i = i->next)
+    {
+        GList *pending = g_list_find (fl->priv->pending_inserts, i->data);
+
+        if (pending)
+        {
+            fl->priv->pending_inserts = g_list_delete_link (fl->priv->pending_inserts, pending);
+            gnome_cmd_file_unref (GNOME_CMD_FILE (i->data));
+        }
+    }
+
+    if (fl->cwd == dir && fl->remove_files(update->deleted))
+        changed = TRUE;
+
+    for (GList *i = update->changed; i; i = i->next)
+        if (fl->has_file(GNOME_CMD_FILE (i->data)))
+        {
+            fl->update_file(GNOME_CMD_FILE (i->data));
+            changed = TRUE;
+        }
+
+    // the dir has batched the created files already, so they are inserted right away
+    if (insert_created_files (fl, update->created))
+        changed = TRUE;
+
+    gtk_clist_thaw (*fl);
+
+    if (changed)
+        g_signal_emit (fl, signals[FILES_CHANGED], 0);
+}
+
+
 static void on_dir_file_renamed (GnomeCmdDir *dir, GnomeCmdFile *f, GnomeCmdFileList *fl)
 {
     g_return_if_fail (GNOME_CMD_IS_FILE_LIST (fl));
@@ -1559,6 +2045,92 @@ static void on_dir_file_renamed (GnomeCmdDir *dir, GnomeCmdFile *f, GnomeCmdFile
 }
 
 
+static void on_dir_list_partial (GnomeCmdDir *dir, GList *files, GnomeCmdFileList *fl)
+{
+    DEBUG('l', "on_dir_list_partial\n");
+
+    g_return_if_fail (GNOME_CMD_IS_DIR (dir));
+    g_return_if_fail (GNOME_CMD_IS_FILE_LIST (fl));
+
+    if (fl->cwd != dir)
+        return;
+
+    if (fl->priv->streamed_dir != dir)
+    {
+        // the first batch of a new listing replaces whatever was shown before
+        fl->priv->streamed_dir = dir;
+        fl->remove_all_files();
+
+        gchar *path = GNOME_CMD_FILE (dir)->get_path();
+        if (path && strcmp (path, G_DIR_SEPARATOR_S) != 0)
+            fl->append_file(gnome_cmd_dir_new_parent_dir_file (dir));
+        g_free (path);
+
+        if (fl->realized)
+            gtk_widget_set_sensitive (*fl, TRUE);
+    }
+
+    fl->insert_files(files);
+
+    g_signal_emit (fl, signals[FILES_CHANGED], 0);
+}
+
+
+// Gives up listings which haven't made any progress for gnome_cmd_data.navigation_timeout seconds
+static gboolean watch_loading (GnomeCmdFileList *fl)
+{
+    if (!fl->priv->listing)
+        return TRUE;
+
+    gint counter = g_atomic_int_get (&fl->cwd->list_counter);
+
+    if (counter != fl->priv->loading_counter)
+    {
+        fl->priv->loading_counter = counter;
+        fl->priv->loading_stalled = 0;
+        return TRUE;
+    }
+
+    if (++fl->priv->loading_stalled < gnome_cmd_data.navigation_timeout)
+        return TRUE;
+
+    gchar *path = GNOME_CMD_FILE (fl->cwd)->get_path();
+    gnome_cmd_show_message (*main_win, path, gnome_vfs_result_to_string (GNOME_VFS_ERROR_TIMEOUT));
+    g_free (path);
+
+    fl->priv->loading_watch_id = 0;
+    fl->cancel_loading();
+
+    return FALSE;
+}
+
+
+static void update_loading (GnomeCmdFileList *fl)
+{
+    gboolean loading = fl->is_loading();
+
+    if (loading == fl->priv->loading)
+        return;
+
+    fl->priv->loading = loading;
+
+    if (loading)
+    {
+        fl->priv->loading_counter = 0;
+        fl->priv->loading_stalled = 0;
+        fl->priv->loading_watch_id = g_timeout_add_seconds (1, (GSourceFunc) watch_loading, fl);
+    }
+    else
+        if (fl->priv->loading_watch_id)
+        {
+            g_source_remove (fl->priv->loading_watch_id);
+            fl->priv->loading_watch_id = 0;
+        }
+
+    g_signal_emit (fl, signals[LOADING_CHANGED], 0);
+}
+
+
 static void on_dir_list_ok (GnomeCmdDir *dir, GList *files, GnomeCmdFileList *fl)
 {
     DEBUG('l', "on_dir_list_ok\n");
@@ -1566,6 +2138,11 @@ static void on_dir_list_ok (GnomeCmdDir *dir, GList *files, GnomeCmdFileList *fl
     g_return_if_fail (GNOME_CMD_IS_DIR (dir));
     g_return_if_fail (GNOME_CMD_IS_FILE_LIST (fl));
 
+    // keep the scroll position the user may have changed while the files were streamed in
+    if (fl->priv->streamed_dir == dir)
+        dir->voffset = gnome_cmd_clist_get_voffset (*fl);
+    fl->priv->streamed_dir = NULL;
+
     if (fl->realized)
     {
         gtk_widget_set_sensitive (*fl, TRUE);
@@ -1581,18 +2158,25 @@ static void on_dir_list_ok (GnomeCmdDir *dir, GList *files, GnomeCmdFileList *fl
             g_signal_handlers_disconnect_by_func (fl->connected_dir, (gpointer) on_dir_file_deleted, fl);
             g_signal_handlers_disconnect_by_func (fl->connected_dir, (gpointer) on_dir_file_changed, fl);
             g_signal_handlers_disconnect_by_func (fl->connected_dir, (gpointer) on_dir_file_renamed, fl);
+            g_signal_handlers_disconnect_by_func (fl->connected_dir, (gpointer) on_dir_files_updated, fl);
         }
 
         g_signal_connect (dir, "file-created", G_CALLBACK (on_dir_file_created), fl);
         g_signal_connect (dir, "file-deleted", G_CALLBACK (on_dir_file_deleted), fl);
         g_signal_connect (dir, "file-changed", G_CALLBACK (on_dir_file_changed), fl);
         g_signal_connect (dir, "file-renamed", G_CALLBACK (on_dir_file_renamed), fl);
+        g_signal_connect (dir, "files-updated", G_CALLBACK (on_dir_files_updated), fl);
 
         fl->connected_dir = dir;
     }
 
+    fl->priv->listing = FALSE;
+    update_loading (fl);
+
     g_signal_emit (fl, signals[DIR_CHANGED], 0, dir);
 
+    schedule_prefetch (fl);
+
     DEBUG('l', "returning from on_dir_list_ok\n");
 }
 
@@ -1613,6 +2197,10 @@ static void on_dir_list_failed (GnomeCmdDir *dir, GnomeVFSResult result, GnomeCm
     if (result != GNOME_VFS_OK)
         gnome_cmd_show_message (NULL, _("Directory listing failed."), gnome_vfs_result_to_string (result));
 
+    fl->priv->streamed_dir = NULL;
+    fl->priv->listing = FALSE;
+    update_loading (fl);
+
     g_signal_handlers_disconnect_matched (fl->cwd, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, fl);
     fl->connected_dir = NULL;
     gnome_cmd_dir_unref (fl->cwd);
@@ -1624,6 +2212,7 @@ static void on_dir_list_failed (GnomeCmdDir *dir, GnomeVFSResult result, GnomeCm
         fl->cwd = fl->lwd;
         g_signal_connect (fl->cwd, "list-ok", G_CALLBACK (on_dir_list_ok), fl);
         g_signal_connect (fl->cwd, "list-failed", G_CALLBACK (on_dir_list_failed), fl);
+        g_signal_connect (fl->cwd, "list-partial", G_CALLBACK (on_dir_list_partial), fl);
         fl->lwd = NULL;
     }
     else
@@ -1819,6 +2408,16 @@ static void gnome_cmd_file_list_class_init (GnomeCmdFileListClass *klass)
             g_cclosure_marshal_VOID__POINTER,
             G_TYPE_NONE,
             1, G_TYPE_POINTER);
+
+    signals[LOADING_CHANGED] =
+        g_signal_new ("loading-changed",
+            G_TYPE_FROM_CLASS (klass),
+            G_SIGNAL_RUN_LAST,
+            G_STRUCT_OFFSET (GnomeCmdFileListClass, loading_changed),
+            NULL, NULL,
+            g_cclosure_marshal_VOID__VOID,
+            G_TYPE_NONE,
+            0);
 }
 
 
@@ -1829,6 +2428,7 @@ static void gnome_cmd_file_list_init (GnomeCmdFileList *fl)
     fl->init_dnd();
 
     g_signal_connect_after (fl, "scroll-vertical", G_CALLBACK (on_scroll_vertical), fl);
+    g_signal_connect_after (fl, "select-row", G_CALLBACK (on_select_row), fl);
     g_signal_connect (fl, "click-column", G_CALLBACK (on_column_clicked), fl);
 
     g_signal_connect (fl, "button-press-event", G_CALLBACK (on_button_press), fl);
@@ -1857,40 +2457,132 @@ GtkSortType GnomeCmdFileList::get_sort_order() const
 }
 
 
-inline void add_file_to_clist (GnomeCmdFileList *fl, GnomeCmdFile *f, gint in_row)
+// Renumbers the rows from row 'from' on in fl->priv->file_rows, needed after a row has been inserted or removed
+inline void update_file_rows (GnomeCmdFileList *fl, gint from)
 {
     GtkCList *clist = *fl;
+    gint row = from;
 
-    FileFormatData data(fl, f,FALSE);
+    for (GList *i = g_list_nth (clist->row_list, from); i; i = i->next, ++row)
+        g_hash_table_insert (fl->priv->file_rows, ((GtkCListRow *) i->data)->data, GINT_TO_POINTER (row+1));
+}
 
-    gint row = in_row == -1 ? gtk_clist_append (clist, data.text) : gtk_clist_insert (clist, in_row, data.text);
 
-    // Setup row data and color
-    if (!gnome_cmd_data.options.use_ls_colors)
-        gtk_clist_set_row_style (clist, row, (row % 2) ? alt_list_style : list_style);
-    else
+inline void clear_clist (GnomeCmdFileList *fl)
+{
+    gtk_clist_clear (*fl);
+    g_hash_table_remove_all (fl->priv->file_rows);
+}
+
+
+static void free_mime_type_request (MimeTypeRequest *req)
+{
+    if (req->req)
+        mime_resolver_cancel (req->req);
+
+    g_free (req);
+}
+
+
+static void on_mime_type_resolved (GnomeCmdFile *f, MimeTypeRequest *req)
+{
+    GnomeCmdFileList *fl = req->fl;
+
+    req->req = NULL;
+    g_hash_table_remove (fl->priv->mime_types, f);
+
+    gint row = fl->get_row_from_file(f);
+    if (row != -1)
+        gnome_cmd_clist_invalidate_row (*fl, row);
+}
+
+
+// Has the real MIME type of a file looked up in the background, for the MIME icon only. The
+// visible rows ask for it when they are drawn, which puts them before the others in the queue.
+static void resolve_mime_type (GnomeCmdFileList *fl, GnomeCmdFile *f, gboolean visible)
+{
+    if (!f->mime_type_guessed || gnome_cmd_data.options.layout != GNOME_CMD_LAYOUT_MIME_ICONS)
+        return;
+
+    MimeTypeRequest *req = (MimeTypeRequest *) g_hash_table_lookup (fl->priv->mime_types, f);
+
+    if (req && (req->visible || !visible))
+        return;
+
+    req = g_new0 (MimeTypeRequest, 1);
+    req->fl = fl;
+    req->visible = visible;
+    req->req = mime_resolver_request (f, visible, (MimeResolvedFunc) on_mime_type_resolved, req);
+
+    // a request of a row which has become visible replaces the background one
+    g_hash_table_insert (fl->priv->mime_types, f, req);
+}
+
+
+// Fills in the cells of a row when it is about to be drawn for the first time, see add_file_to_clist ()
+static void format_row (GnomeCmdCList *clist, gint row, GtkCListRow *clist_row, GnomeCmdFileList *fl)
+{
+    // the name is never empty, so an empty name cell tells the row hasn't been filled in yet
+    if (clist_row->cell[GnomeCmdFileList::COLUMN_NAME].type != GTK_CELL_EMPTY)
+        return;
+
+    GnomeCmdFile *f = (GnomeCmdFile *) clist_row->data;
+
+    if (!f)
+        return;
+
+    // a tree size being counted shows what has been counted so far
+    TreeSizeRequest *req = (TreeSizeRequest *) g_hash_table_lookup (fl->priv->tree_sizes, f);
+    FileFormatData data(fl, f, req ? req->size : f->has_tree_size() ? f->get_tree_size() : (GnomeVFSFileSize) -1);
+
+    for (gint i=0; i<GnomeCmdFileList::NUM_COLUMNS; i++)
+        if (data.text[i])
+            gnome_cmd_clist_set_cell_text (clist, clist_row, i, data.text[i]);
+
+    // selected rows keep the selection colors set by select_file ()
+    if (gnome_cmd_data.options.use_ls_colors && !fl->priv->selected_files.contain(f))
     {
         LsColor *col = ls_colors_get (f);
         if (col)
-        {
-            if (col->bg)
-                gtk_clist_set_background (clist, row, col->bg);
-            if (col->fg)
-                gtk_clist_set_foreground (clist, row, col->fg);
-        }
+            gnome_cmd_clist_set_row_colors (clist, clist_row, col->fg, col->bg);
     }
 
-    gtk_clist_set_row_data (clist, row, f);
-
     // If the use wants icons to show file types set it now
     if (gnome_cmd_data.options.layout != GNOME_CMD_LAYOUT_TEXT)
     {
         GdkPixmap *pixmap;
         GdkBitmap *mask;
 
+        // the guessed type is shown until the real one is known
+        resolve_mime_type (fl, f, TRUE);
+
         if (f->get_type_pixmap_and_mask(&pixmap, &mask))
-            gtk_clist_set_pixmap (clist, row, 0, pixmap, mask);
+            gnome_cmd_clist_set_cell_pixmap (clist, clist_row, 0, pixmap, mask);
     }
+}
+
+
+inline void add_file_to_clist (GnomeCmdFileList *fl, GnomeCmdFile *f, gint in_row)
+{
+    // rows are added empty, format_row () fills in the cells of only those which get drawn
+    static gchar *no_text[GnomeCmdFileList::NUM_COLUMNS];
+
+    GtkCList *clist = *fl;
+
+    gint row = in_row == -1 ? gtk_clist_append (clist, no_text) : gtk_clist_insert (clist, in_row, no_text);
+
+    // Setup row data and style
+    if (!gnome_cmd_data.options.use_ls_colors)
+        gtk_clist_set_row_style (clist, row, (row % 2) ? alt_list_style : list_style);
+
+    gtk_clist_set_row_data (clist, row, f);
+
+    resolve_mime_type (fl, f, FALSE);
+
+    if (row == clist->rows-1)
+        g_hash_table_insert (fl->priv->file_rows, f, GINT_TO_POINTER (row+1));
+    else
+        update_file_rows (fl, row);
 
     // If we have been waiting for this file to show up, focus it
     if (fl->priv->focus_later && strcmp (f->get_name(), fl->priv->focus_later)==0)
@@ -1923,25 +2615,173 @@ gboolean GnomeCmdFileList::insert_file(GnomeCmdFile *f)
     if (!file_is_wanted(f))
         return FALSE;
 
-    gint num_files = size();
+    // binary search for the first row sorting after f
+    gint lo = 0;
+    gint hi = size();
 
-    for (gint i=0; i<num_files; i++)
+    while (lo < hi)
     {
-        GnomeCmdFile *f2 = get_file_at_row(i);
-        if (priv->sort_func (f2, f, this) == 1)
+        gint mid = lo + (hi - lo) / 2;
+
+        if (priv->sort_func (get_file_at_row(mid), f, this) > 0)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+
+    // Insert the file at the end of the list
+    if (lo == (gint) size())
+    {
+        append_file(f);
+        return TRUE;
+    }
+
+    priv->visible_files.add(f);
+    add_file_to_clist (this, f, lo);
+
+    if (lo<=priv->cur_file)
+        priv->cur_file++;
+
+    return TRUE;
+}
+
+
+// Replaces the rows with files, which must be sorted already, keeping the focus, the selection and the scroll position
+static void refill_clist (GnomeCmdFileList *fl, GList *files)
+{
+    GnomeCmdFile *focused_file = fl->get_focused_file();
+    gint focus_row = GTK_CLIST (fl)->focus_row;
+    gint voffset = gnome_cmd_clist_get_voffset (*fl);
+
+    gtk_clist_freeze (*fl);
+    clear_clist (fl);
+
+    fl->priv->cur_file = -1;
+
+    for (; files; files = files->next)
+        add_file_to_clist (fl, GNOME_CMD_FILE (files->data), -1);
+
+    // refocus the previously focused file, or its row if it is gone, unless a file waited for
+    // has just been focused, and reselect the previously selected files
+    if (fl->priv->cur_file < 0 && focused_file)
+    {
+        gint row = fl->get_row_from_file(focused_file);
+
+        if (row < 0)
+            row = MIN (focus_row, GTK_CLIST (fl)->rows - 1);
+
+        if (GTK_WIDGET_HAS_FOCUS (fl))
+            fl->select_row(row);
+        else
+            fl->priv->cur_file = row;
+    }
+
+    for (GnomeCmd::Collection<GnomeCmdFile *>::iterator i=fl->priv->selected_files.begin(); i!=fl->priv->selected_files.end(); ++i)
+        fl->select_file(*i);
+
+    gtk_clist_thaw (*fl);
+
+    gnome_cmd_clist_set_voffset (*fl, voffset);
+}
+
+
+gboolean GnomeCmdFileList::insert_files(GList *files)
+{
+    GList *new_files = NULL;
+
+    for (; files; files = files->next)
+    {
+        GnomeCmdFile *f = GNOME_CMD_FILE (files->data);
+
+        if (file_is_wanted (f))
+            new_files = g_list_prepend (new_files, f);
+    }
+
+    if (!new_files)
+        return FALSE;
+
+    new_files = sort_files (this, new_files);
+
+    // merge the sorted batch with the rows already shown, which are sorted as well
+    GList *merged = NULL;
+    GList *rows = GTK_CLIST (this)->row_list;
+    GList *i = new_files;
+
+    while (rows || i)
+    {
+        GnomeCmdFile *f;
+
+        if (!i || (rows && priv->sort_func (((GtkCListRow *) rows->data)->data, i->data, this) <= 0))
+        {
+            f = GNOME_CMD_FILE (((GtkCListRow *) rows->data)->data);
+            rows = rows->next;
+        }
+        else
         {
+            f = GNOME_CMD_FILE (i->data);
             priv->visible_files.add(f);
-            add_file_to_clist (this, f, i);
+            i = i->next;
+        }
 
-            if (i<=priv->cur_file)
-                priv->cur_file++;
+        merged = g_list_prepend (merged, f);
+    }
 
-            return TRUE;
-        }
+    merged = g_list_reverse (merged);
+    g_list_free (new_files);
+
+    refill_clist (this, merged);
+
+    g_list_free (merged);
+
+    return TRUE;
+}
+
+
+gboolean GnomeCmdFileList::remove_files(GList *files)
+{
+    GHashTable *removed = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+    for (; files; files = files->next)
+        if (get_row_from_file(GNOME_CMD_FILE (files->data)) >= 0)
+            g_hash_table_add (removed, files->data);
+
+    guint n = g_hash_table_size (removed);
+
+    if (n == 0 || n <= MAX_SINGLE_INSERTS)
+    {
+        GHashTableIter iter;
+        gpointer f;
+
+        g_hash_table_iter_init (&iter, removed);
+        while (g_hash_table_iter_next (&iter, &f, NULL))
+            remove_file(GNOME_CMD_FILE (f));
+
+        g_hash_table_destroy (removed);
+
+        return n > 0;
     }
 
-    // Insert the file at the end of the list
-    append_file(f);
+    // too many for removing them one by one, every removal renumbers the rows after it
+    GList *kept = NULL;
+
+    for (GList *rows = GTK_CLIST (this)->row_list; rows; rows = rows->next)
+    {
+        GnomeCmdFile *f = GNOME_CMD_FILE (((GtkCListRow *) rows->data)->data);
+
+        if (g_hash_table_contains (removed, f))
+            priv->selected_files.remove(f);
+        else
+            kept = g_list_prepend (kept, f);
+    }
+
+    priv->visible_files.remove(removed);
+    g_hash_table_destroy (removed);
+
+    DEBUG('l', "Removing %u deleted files\n", n);
+
+    kept = g_list_reverse (kept);
+    refill_clist (this, kept);
+    g_list_free (kept);
 
     return TRUE;
 }
@@ -1959,19 +2799,21 @@ void GnomeCmdFileList::show_files(GnomeCmdDir *dir)
         GnomeCmdFile *f = GNOME_CMD_FILE (i->data);
 
         if (file_is_wanted (f))
-            files = g_list_append (files, f);
+            files = g_list_prepend (files, f);
     }
 
     // Create a parent dir file (..) if appropriate
     gchar *path = GNOME_CMD_FILE (dir)->get_path();
     if (path && strcmp (path, G_DIR_SEPARATOR_S) != 0)
-        files = g_list_append (files, gnome_cmd_dir_new_parent_dir_file (dir));
+        files = g_list_prepend (files, gnome_cmd_dir_new_parent_dir_file (dir));
     g_free (path);
 
     if (!files)
         return;
 
-    files = g_list_sort_with_data (files, (GCompareDataFunc) priv->sort_func, this);
+    files = sort_files (this, files);
+
+    priv->visible_files.reserve(g_list_length (files));
 
     gtk_clist_freeze (*this);
     for (GList *i = files; i; i = i->next)
@@ -1992,18 +2834,42 @@ void GnomeCmdFileList::update_file(GnomeCmdFile *f)
     if (row == -1)
         return;
 
-    FileFormatData data(this, f, FALSE);
+    // format_row () fills the row in again, right away if it is visible
+    gnome_cmd_clist_invalidate_row (*this, row);
+}
 
-    for (gint i=1; i<NUM_COLUMNS; i++)
-        gtk_clist_set_text (*this, row, i, data.text[i]);
 
-    if (gnome_cmd_data.options.layout != GNOME_CMD_LAYOUT_TEXT)
+// Cancels the job if it is still running
+static void free_tree_size_request (TreeSizeRequest *req)
+{
+    if (req->job)
+        treesize_cancel (req->job);
+
+    req->f->unref();
+    g_free (req);
+}
+
+
+static void on_tree_size_counted (TreeSizeJob *job, GnomeVFSFileSize size, gulong count, gboolean done, TreeSizeRequest *req)
+{
+    GnomeCmdFileList *fl = req->fl;
+    GnomeCmdFile *f = req->f;
+
+    req->size = size;
+
+    if (done)
+        f->set_tree_size(size);
+
+    gint row = fl->get_row_from_file(f);
+    if (row != -1)
+        gnome_cmd_clist_invalidate_row (*fl, row);
+
+    if (done)
     {
-        GdkPixmap *pixmap;
-        GdkBitmap *mask;
+        req->job = NULL;
+        g_hash_table_remove (fl->priv->tree_sizes, f);
 
-        if (f->get_type_pixmap_and_mask(&pixmap, &mask))
-            gtk_clist_set_pixmap (*this, row, 0, pixmap, mask);
+        g_signal_emit (fl, signals[FILES_CHANGED], 0);
     }
 }
 
@@ -2012,14 +2878,32 @@ void GnomeCmdFileList::show_dir_tree_size(GnomeCmdFile *f)
 {
     g_return_if_fail (GNOME_CMD_IS_FILE (f));
 
+    if (f->info->type != GNOME_VFS_FILE_TYPE_DIRECTORY || f->is_dotdot)
+        return;
+
     gint row = get_row_from_file(f);
     if (row == -1)
         return;
 
-    FileFormatData data(this, f,TRUE);
+    if (!f->has_tree_size() && !g_hash_table_lookup (priv->tree_sizes, f))
+    {
+        GnomeVFSURI *uri = f->get_uri();
+
+        if (!uri)
+            return;
+
+        // the size is counted in the background, format_row () shows the partial sizes as they come in
+        TreeSizeRequest *req = g_new0 (TreeSizeRequest, 1);
 
-    for (gint i=1; i<NUM_COLUMNS; i++)
-        gtk_clist_set_text (*this, row, i, data.text[i]);
+        req->fl = this;
+        req->f = f->ref();
+        req->job = treesize_start (uri, (TreeSizeFunc) on_tree_size_counted, req);
+        gnome_vfs_uri_unref (uri);
+
+        g_hash_table_insert (priv->tree_sizes, f, req);
+    }
+
+    gnome_cmd_clist_invalidate_row (*this, row);
 }
 
 
@@ -2044,6 +2928,8 @@ gboolean GnomeCmdFileList::remove_file(GnomeCmdFile *f)
         return FALSE;
 
     gtk_clist_remove (*this, row);
+    g_hash_table_remove (priv->file_rows, f);
+    update_file_rows (this, row);
 
     priv->selected_files.remove(f);
     priv->visible_files.remove(f);
@@ -2055,17 +2941,12 @@ gboolean GnomeCmdFileList::remove_file(GnomeCmdFile *f)
 }
 
 
-gboolean GnomeCmdFileList::remove_file(const gchar *uri_str)
-{
-    g_return_val_if_fail (uri_str != NULL, FALSE);
-
-    return remove_file (priv->visible_files.find(uri_str));
-}
-
-
 void GnomeCmdFileList::clear()
 {
-    gtk_clist_clear (*this);
+    discard_pending_files (this);
+    g_hash_table_remove_all (priv->tree_sizes);
+    g_hash_table_remove_all (priv->mime_types);
+    clear_clist (this);
     priv->visible_files.clear();
     priv->selected_files.clear();
 }
@@ -2097,6 +2978,24 @@ GnomeCmd::Collection<GnomeCmdFile *> &GnomeCmdFileList::get_marked_files()
 }
 
 
+guint GnomeCmdFileList::size()
+{
+    return priv->visible_files.size();
+}
+
+
+bool GnomeCmdFileList::empty()
+{
+    return priv->visible_files.empty();
+}
+
+
+gint GnomeCmdFileList::get_row_from_file(GnomeCmdFile *f)
+{
+    return GPOINTER_TO_INT (g_hash_table_lookup (priv->file_rows, f)) - 1;
+}
+
+
 GList *GnomeCmdFileList::get_visible_files()
 {
     return priv->visible_files.get_list();
@@ -2262,8 +3161,10 @@ void GnomeCmdFileList::sort()
 {
     GnomeCmdFile *selfile = get_selected_file();
 
+    prepare_sort_keys (this, priv->visible_files.get_list());
+
     gtk_clist_freeze (*this);
-    gtk_clist_clear (*this);
+    clear_clist (this);
 
     // resort the files and readd them to the list
     for (GList *list = priv->visible_files.sort(priv->sort_func, this); list; list = list->next)
@@ -2674,7 +3575,7 @@ gboolean GnomeCmdFileList::key_pressed(GdkEventKey *event)
 
 GList *GnomeCmdFileList::sort_selection(GList *list)
 {
-    return g_list_sort_with_data (list, (GCompareDataFunc) priv->sort_func, this);
+    return sort_files (this, list);
 }
 
 
@@ -2683,6 +3584,7 @@ void GnomeCmdFileList::set_base_dir (gchar *dir)
     g_return_if_fail (dir != NULL);
     if (priv->base_dir) { g_free (priv->base_dir); }
     priv->base_dir = dir;
+    priv->dir_text_dirname = NULL;        // the dir column text depends on the base dir
 }
 
 
@@ -2761,18 +3663,19 @@ void GnomeCmdFileList::set_directory(GnomeCmdDir *dir)
         lwd = cwd;
         gnome_cmd_dir_cancel_monitoring (lwd);
         g_signal_handlers_disconnect_matched (lwd, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, this);
-        if (gnome_cmd_dir_is_local (lwd) && !gnome_cmd_dir_is_monitored (lwd) && gnome_cmd_dir_needs_mtime_update (lwd))
-            gnome_cmd_dir_update_mtime (lwd);
         cwd->voffset = gnome_cmd_clist_get_voffset (*this);
     }
 
     cwd = dir;
 
+    priv->listing = dir->state != GnomeCmdDir::STATE_LISTED;
+
     switch (dir->state)
     {
         case GnomeCmdDir::STATE_EMPTY:
             g_signal_connect (dir, "list-ok", G_CALLBACK (on_dir_list_ok), this);
             g_signal_connect (dir, "list-failed", G_CALLBACK (on_dir_list_failed), this);
+            g_signal_connect (dir, "list-partial", G_CALLBACK (on_dir_list_partial), this);
             gnome_cmd_dir_list_files (dir, gnome_cmd_con_needs_list_visprog (con));
             break;
 
@@ -2780,17 +3683,20 @@ void GnomeCmdFileList::set_directory(GnomeCmdDir *dir)
         case GnomeCmdDir::STATE_CANCELING:
             g_signal_connect (dir, "list-ok", G_CALLBACK (on_dir_list_ok), this);
             g_signal_connect (dir, "list-failed", G_CALLBACK (on_dir_list_failed), this);
+            g_signal_connect (dir, "list-partial", G_CALLBACK (on_dir_list_partial), this);
             break;
 
         case GnomeCmdDir::STATE_LISTED:
             g_signal_connect (dir, "list-ok", G_CALLBACK (on_dir_list_ok), this);
             g_signal_connect (dir, "list-failed", G_CALLBACK (on_dir_list_failed), this);
+            g_signal_connect (dir, "list-partial", G_CALLBACK (on_dir_list_partial), this);
 
-            // check if the dir has up-to-date file list; if not and it's a local dir - relist it
-            if (gnome_cmd_dir_is_local (dir) && !gnome_cmd_dir_is_monitored (dir) && gnome_cmd_dir_update_mtime (dir))
-                gnome_cmd_dir_relist_files (dir, gnome_cmd_con_needs_list_visprog (con));
-            else
-                on_dir_list_ok (dir, NULL, this);
+            // the dir is shown as cached, the changes are applied by 'files-updated' once it's revalidated;
+            // local dirs may have changed while no panel was watching them
+            on_dir_list_ok (dir, NULL, this);
+
+            if (gnome_cmd_dir_is_local (dir) || gnome_cmd_data.revalidate_remote_dirs)
+                gnome_cmd_dir_revalidate (dir);
             break;
 
         default:
@@ -2798,6 +3704,8 @@ void GnomeCmdFileList::set_directory(GnomeCmdDir *dir)
     }
 
     gnome_cmd_dir_start_monitoring (dir);
+
+    update_loading (this);
 }
 
 
@@ -2831,12 +3739,37 @@ gboolean GnomeCmdFileList::file_is_wanted(GnomeCmdFile *f)
 }
 
 
+static void on_goto_dir_ready (GnomeCmdDir *dir, GnomeVFSResult result, GnomeCmdFileList *fl)
+{
+    fl->priv->dir_request = NULL;
+
+    if (dir)
+    {
+        fl->set_directory(dir);
+
+        // focus the current dir when going back to the parent dir
+        if (fl->priv->goto_focus)
+            fl->focus_file(fl->priv->goto_focus, FALSE);
+    }
+    else
+        gnome_cmd_show_message (*main_win, fl->priv->goto_path, gnome_vfs_result_to_string (result));
+
+    g_free (fl->priv->goto_path);
+    g_free (fl->priv->goto_focus);
+    fl->priv->goto_path = NULL;
+    fl->priv->goto_focus = NULL;
+
+    update_loading (fl);
+}
+
+
 void GnomeCmdFileList::goto_directory(const gchar *in_dir)
 {
     g_return_if_fail (in_dir != NULL);
 
-    GnomeCmdDir *new_dir = NULL;
-    const gchar *focus_dir = NULL;
+    GnomeCmdCon *new_con = con;
+    GnomeCmdPath *path = NULL;
+    gchar *focus_dir = NULL;
     gchar *dir;
 
     if (g_str_has_prefix (in_dir, "~"))
@@ -2847,45 +3780,74 @@ void GnomeCmdFileList::goto_directory(const gchar *in_dir)
     if (strcmp (dir, "..") == 0)
     {
         // let's get the parent directory
-        new_dir = gnome_cmd_dir_get_parent (cwd);
-        if (!new_dir)
-        {
-            g_free (dir);
-            return;
-        }
-        focus_dir = GNOME_CMD_FILE (cwd)->get_name();
+        path = gnome_cmd_dir_get_path (cwd)->get_parent();
+        focus_dir = g_strdup (GNOME_CMD_FILE (cwd)->get_name());
     }
     else
     {
         // check if it's an absolute address or not
         if (dir[0] == '/')
-            new_dir = gnome_cmd_dir_new (con, gnome_cmd_con_create_path (con, dir));
+            path = gnome_cmd_con_create_path (con, dir);
         else
 #ifdef HAVE_SAMBA
             if (g_str_has_prefix (dir, "\\\\"))
             {
-                GnomeCmdPath *path = gnome_cmd_con_create_path (get_smb_con (), dir);
-                if (path)
-                    new_dir = gnome_cmd_dir_new (get_smb_con (), path);
+                new_con = get_smb_con ();
+                path = gnome_cmd_con_create_path (new_con, dir);
             }
             else
 #endif
-                new_dir = gnome_cmd_dir_get_child (cwd, dir);
+                path = gnome_cmd_dir_get_path (cwd)->get_child(dir);
+    }
+
+    if (!path)
+    {
+        g_free (focus_dir);
+        g_free (dir);
+        return;
     }
 
-    if (new_dir)
-        set_directory(new_dir);
+    // the last one wins
+    cancel_loading();
+
+    priv->goto_path = dir;
+    priv->goto_focus = focus_dir;
+    priv->dir_request = gnome_cmd_dir_new_async (new_con, path, (GnomeCmdDirReadyFunc) on_goto_dir_ready, this);
+
+    update_loading (this);
+}
 
-    // focus the current dir when going back to the parent dir
-    if (focus_dir)
-        focus_file(focus_dir, FALSE);
 
-    g_free (dir);
+gboolean GnomeCmdFileList::is_loading()
+{
+    return priv->dir_request || priv->listing;
+}
+
+
+void GnomeCmdFileList::cancel_loading()
+{
+    if (priv->dir_request)
+    {
+        gnome_cmd_dir_request_cancel (priv->dir_request);
+        priv->dir_request = NULL;
+        g_free (priv->goto_path);
+        g_free (priv->goto_focus);
+        priv->goto_path = NULL;
+        priv->goto_focus = NULL;
+    }
+
+    // the panel goes back to the last dir once the listing has been given up, see on_dir_list_failed ()
+    if (priv->listing)
+        gnome_cmd_dir_cancel_listing (cwd);
+
+    update_loading (this);
 }
 
 
 void GnomeCmdFileList::invalidate_tree_size()
 {
+    g_hash_table_remove_all (priv->tree_sizes);
+
     for (GList *i = get_visible_files(); i; i = i->next)
     {
         GnomeCmdFile *f = (GnomeCmdFile *) i->data;
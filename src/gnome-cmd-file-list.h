@@ -107,20 +107,20 @@ struct GnomeCmdFileList
     GnomeCmdFileList(ColumnID sort_col, GtkSortType sort_order);
     ~GnomeCmdFileList();
 
-    guint size()                          {  return g_list_length (get_visible_files());  }
-    bool empty()                          {  return get_visible_files()==NULL;            }    // FIXME should be: size()==0
+    guint size();
+    bool empty();
     void clear();
 
     void reload();
 
     void append_file(GnomeCmdFile *f);
     gboolean insert_file(GnomeCmdFile *f);      // Returns TRUE if file added to shown file list, FALSE otherwise
+    gboolean insert_files(GList *files);        // Merges a batch of files into the shown (sorted) file list, returns TRUE if any file was added
     gboolean remove_file(GnomeCmdFile *f);
-    gboolean remove_file(const gchar *uri_str);
-    void remove_files(GList *files);
+    gboolean remove_files(GList *files);        // Removes a batch of files from the shown file list, returns TRUE if any file was removed
     void remove_all_files()             {  clear();  }
 
-    gboolean has_file(const GnomeCmdFile *f);
+    gboolean has_file(GnomeCmdFile *f);              // constant time, through the row index
 
     void select_file(GnomeCmdFile *f, gint row=-1);
     void unselect_file(GnomeCmdFile *f, gint row=-1);
@@ -141,7 +141,7 @@ struct GnomeCmdFileList
 
     void select_row(gint row);
     GnomeCmdFile *get_file_at_row(gint row)            {  return static_cast<GnomeCmdFile *>(gtk_clist_get_row_data (*this, row));  }
-    gint get_row_from_file(GnomeCmdFile *f)            {  return gtk_clist_find_row_from_data (*this, f);               }
+    gint get_row_from_file(GnomeCmdFile *f);           // constant time, returns -1 if f is not shown
     void focus_file(const gchar *focus_file, gboolean scroll_to_file=TRUE);
 
     void sort();
@@ -209,7 +209,10 @@ struct GnomeCmdFileList
      */
     void set_connection(GnomeCmdCon *con, GnomeCmdDir *start_dir=NULL);
     void set_directory(GnomeCmdDir *dir);
-    void goto_directory(const gchar *dir);
+    void goto_directory(const gchar *dir);          // asynchronous, see is_loading()
+
+    gboolean is_loading();                          // a dir is being stat'ed or listed for the list
+    void cancel_loading();
 
     void update_style();
 
@@ -233,15 +236,9 @@ inline GnomeCmdFileList::~GnomeCmdFileList()
     gnome_cmd_dir_unref (lwd);
 }
 
-inline void GnomeCmdFileList::remove_files (GList *files)
-{
-    for (; files; files = files->next)
-	    remove_file(static_cast<GnomeCmdFile *>(files->data));
-}
-
-inline gboolean GnomeCmdFileList::has_file(const GnomeCmdFile *f)
+inline gboolean GnomeCmdFileList::has_file(GnomeCmdFile *f)
 {
-    return g_list_index (get_visible_files(), f) != -1;
+    return get_row_from_file(f) != -1;
 }
 
 inline GnomeCmdFile *GnomeCmdFileList::get_selected_file()
@@ -559,6 +559,7 @@ inline gchar *get_default_application_action_name (GList *files, gchar **icon_pa
         return g_strdup (_("_Open"));
 
     GnomeCmdFile *f = (GnomeCmdFile *) files->data;
+    f->resolve_mime_type();
     gchar *uri_str = f->get_uri_str();
     GnomeVFSMimeApplication *app = gnome_vfs_mime_get_default_application_for_uri (uri_str, f->info->mime_type);
     
@@ -642,6 +643,7 @@ GtkWidget *gnome_cmd_file_popmenu_new (GnomeCmdFileList *fl)
 
     GnomeCmdFile *f = (GnomeCmdFile *) files->data;
 
+    f->resolve_mime_type();
 
     // Fill the "Open With" menu with applications
     gint i = -1;
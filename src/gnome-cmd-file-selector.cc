@@ -60,6 +60,7 @@ class GnomeCmdFileSelector::Private
 
     GList *old_btns;
     GtkWidget *filter_box;
+    GtkWidget *loading_box;         // shown while the current file list is loading a dir
 
     History *dir_history;
     gboolean active;
@@ -80,6 +81,7 @@ inline GnomeCmdFileSelector::Private::Private()
 {
     old_btns = NULL;
     filter_box = NULL;
+    loading_box = NULL;
     active = FALSE;
     realized = FALSE;
     sel_first_file = TRUE;
@@ -464,6 +466,7 @@ static void on_notebook_switch_page (GtkNotebook *notebook, GtkNotebookPage *pag
     fs->update_direntry();
     fs->update_selected_files_label();
     fs->update_vol_label();
+    fs->update_loading_box();
 
     if (prev_dir!=fs->get_directory())
         g_signal_emit (fs, signals[DIR_CHANGED], 0, fs->get_directory());
@@ -582,6 +585,19 @@ static void on_list_dir_changed (GnomeCmdFileList *fl, GnomeCmdDir *dir, GnomeCm
 }
 
 
+static void on_list_loading_changed (GnomeCmdFileList *fl, GnomeCmdFileSelector *fs)
+{
+    if (fs->file_list()==fl)
+        fs->update_loading_box();
+}
+
+
+static void on_loading_cancel (GtkButton *button, GnomeCmdFileSelector *fs)
+{
+    fs->file_list()->cancel_loading();
+}
+
+
 static void on_list_files_changed (GnomeCmdFileList *fl, GnomeCmdFileSelector *fs)
 {
     g_return_if_fail (GNOME_CMD_IS_FILE_SELECTOR (fs));
@@ -855,10 +871,21 @@ static void init (GnomeCmdFileSelector *fs)
     g_object_set_data_full (*fs, "infolabel", fs->info_label, g_object_unref);
     gtk_misc_set_alignment (GTK_MISC (fs->info_label), 0.0f, 0.5f);
 
+    // create the box shown while a dir is loading, it's only about the panel's own list
+    fs->priv->loading_box = create_hbox (*fs, FALSE, 6);
+    GtkWidget *loading_label = create_label (*fs, _("Loading directory…"));
+    GtkWidget *loading_cancel_btn = create_stock_button_with_data (*fs, GTK_STOCK_CANCEL, GTK_SIGNAL_FUNC (on_loading_cancel), fs);
+    gtk_misc_set_alignment (GTK_MISC (loading_label), 0.0f, 0.5f);
+    gtk_box_pack_start (GTK_BOX (fs->priv->loading_box), loading_label, TRUE, TRUE, 6);
+    gtk_box_pack_start (GTK_BOX (fs->priv->loading_box), loading_cancel_btn, FALSE, FALSE, 0);
+    gtk_widget_set_no_show_all (fs->priv->loading_box, TRUE);
+    gtk_widget_hide (fs->priv->loading_box);
+
     // pack the widgets
     GtkWidget *padding = create_hbox (*fs, FALSE, 6);
     gtk_box_pack_start (GTK_BOX (fs), fs->con_hbox, FALSE, FALSE, 0);
     gtk_box_pack_start (GTK_BOX (vbox), fs->dir_indicator, FALSE, FALSE, 0);
+    gtk_box_pack_start (GTK_BOX (vbox), fs->priv->loading_box, FALSE, FALSE, 0);
     gtk_box_pack_start (GTK_BOX (vbox), GTK_WIDGET (fs->notebook), TRUE, TRUE, 0);
     gtk_box_pack_start (GTK_BOX (vbox), padding, FALSE, TRUE, 0);
     gtk_box_pack_start (GTK_BOX (padding), fs->info_label, FALSE, TRUE, 6);
@@ -1491,6 +1518,15 @@ void GnomeCmdFileSelector::show_filter()
 }
 
 
+void GnomeCmdFileSelector::update_loading_box()
+{
+    if (file_list()->is_loading())
+        gtk_widget_show (priv->loading_box);
+    else
+        gtk_widget_hide (priv->loading_box);
+}
+
+
 gboolean GnomeCmdFileSelector::is_active()
 {
     return priv->active;
@@ -1536,6 +1572,7 @@ GtkWidget *GnomeCmdFileSelector::new_tab(GnomeCmdDir *dir, GnomeCmdFileList::Col
     g_signal_connect (fl, "con-changed", G_CALLBACK (on_list_con_changed), this);
     g_signal_connect (fl, "dir-changed", G_CALLBACK (on_list_dir_changed), this);
     g_signal_connect (fl, "files-changed", G_CALLBACK (on_list_files_changed), this);
+    g_signal_connect (fl, "loading-changed", G_CALLBACK (on_list_loading_changed), this);
 
     if (activate)
     {
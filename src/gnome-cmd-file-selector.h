@@ -100,6 +100,7 @@ struct GnomeCmdFileSelector
     void update_direntry();
     void update_vol_label();
     void update_selected_files_label();
+    void update_loading_box();
     void update_style();
     void update_connections();
     void update_show_devbuttons();
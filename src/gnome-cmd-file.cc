@@ -25,12 +25,14 @@
 #include "gnome-cmd-includes.h"
 #include "utils.h"
 #include "owner.h"
+#include "treesize.h"
 #include "imageloader.h"
 #include "gnome-cmd-data.h"
 #include "gnome-cmd-plain-path.h"
 #include "gnome-cmd-main-win.h"
 #include "gnome-cmd-con-list.h"
 #include "gnome-cmd-xfer.h"
+#include "namearena.h"
 #include "tags/gnome-cmd-tags.h"
 #include "intviewer/libgviewer.h"
 #include "dialogs/gnome-cmd-file-props-dialog.h"
@@ -53,13 +55,17 @@ GList *all_files = NULL;
 struct GnomeCmdFile::Private
 {
     Handle *dir_handle;
+    NameArena *names;               // holds the collate key, NULL if the file owns it
     GTimeVal last_update;
     gint ref_cnt;
     GnomeVFSFileSize tree_size;
 };
 
+typedef GnomeCmdFile::Private GnomeCmdFilePrivate;
 
-G_DEFINE_TYPE (GnomeCmdFile, gnome_cmd_file, GNOME_CMD_TYPE_FILE_INFO)
+
+// the private data is allocated together with the instance
+G_DEFINE_TYPE_WITH_PRIVATE (GnomeCmdFile, gnome_cmd_file, GNOME_CMD_TYPE_FILE_INFO)
 
 
 inline gboolean has_parent_dir (GnomeCmdFile *f)
@@ -81,7 +87,7 @@ static void gnome_cmd_file_init (GnomeCmdFile *f)
     // f->info = NULL;
     // f->collate_key = NULL;
 
-    f->priv = g_new0 (GnomeCmdFile::Private, 1);
+    f->priv = (GnomeCmdFile::Private *) gnome_cmd_file_get_instance_private (f);
 
     // f->priv->dir_handle = NULL;
 
@@ -107,7 +113,10 @@ static void gnome_cmd_file_finalize (GObject *object)
     if (f->info->name[0] != '.')
         DEBUG ('f', "file destroying 0x%p %s\n", f, f->info->name);
 
-    g_free (f->collate_key);
+    if (f->priv->names)
+        name_arena_unref (f->priv->names);
+    else
+        g_free ((gchar *) f->collate_key);
     gnome_vfs_file_info_unref (f->info);
     if (f->priv->dir_handle)
         handle_unref (f->priv->dir_handle);
@@ -118,8 +127,6 @@ static void gnome_cmd_file_finalize (GObject *object)
         deleted_files_cnt++;
     }
 
-    g_free (f->priv);
-
     G_OBJECT_CLASS (gnome_cmd_file_parent_class)->finalize (object);
 }
 
@@ -151,11 +158,11 @@ GnomeCmdFile *gnome_cmd_file_new (const gchar *local_full_path)
 }
 
 
-GnomeCmdFile *gnome_cmd_file_new (GnomeVFSFileInfo *info, GnomeCmdDir *dir)
+GnomeCmdFile *gnome_cmd_file_new (GnomeVFSFileInfo *info, GnomeCmdDir *dir, const gchar *collate_key, NameArena *names)
 {
     GnomeCmdFile *f = (GnomeCmdFile *) g_object_new (GNOME_CMD_TYPE_FILE, NULL);
 
-    gnome_cmd_file_setup (f, info, dir);
+    gnome_cmd_file_setup (f, info, dir, collate_key, names);
 
     return f;
 }
@@ -193,38 +200,74 @@ void GnomeCmdFile::invalidate_metadata()
 }
 
 
-void gnome_cmd_file_setup (GnomeCmdFile *f, GnomeVFSFileInfo *info, GnomeCmdDir *dir)
+gchar *gnome_cmd_file_create_collate_key (const gchar *name)
 {
-    g_return_if_fail (f != NULL);
-
-    f->info = info;
-    GNOME_CMD_FILE_INFO (f)->info = info;
-
-    f->is_dotdot = info->type==GNOME_VFS_FILE_TYPE_DIRECTORY && strcmp(info->name, "..")==0;    // check if file is '..'
+    g_return_val_if_fail (name != NULL, NULL);
 
     gchar *utf8_name;
 
     if (!gnome_cmd_data.options.case_sens_sort)
     {
-        gchar *s = get_utf8 (info->name);
+        gchar *s = get_utf8 (name);
         utf8_name = g_utf8_casefold (s, -1);
         g_free (s);
     }
     else
-        utf8_name = get_utf8 (info->name);
+        utf8_name = get_utf8 (name);
 
-    f->collate_key = g_utf8_collate_key_for_filename (utf8_name, -1);
+    gchar *collate_key = g_utf8_collate_key_for_filename (utf8_name, -1);
     g_free (utf8_name);
 
+    return collate_key;
+}
+
+
+// Takes over @a collate_key
+static void set_collate_key (GnomeCmdFile *f, gchar *collate_key)
+{
+    if (f->priv->names)
+    {
+        // renames only, the key of a changed file stays the same
+        if (!f->collate_key || strcmp (f->collate_key, collate_key) != 0)
+            f->collate_key = name_arena_add (f->priv->names, collate_key);
+        g_free (collate_key);
+    }
+    else
+    {
+        g_free ((gchar *) f->collate_key);
+        f->collate_key = collate_key;
+    }
+}
+
+
+void gnome_cmd_file_setup (GnomeCmdFile *f, GnomeVFSFileInfo *info, GnomeCmdDir *dir, const gchar *collate_key, NameArena *names)
+{
+    g_return_if_fail (f != NULL);
+
+    f->info = info;
+    GNOME_CMD_FILE_INFO (f)->info = info;
+
+    f->is_dotdot = info->type==GNOME_VFS_FILE_TYPE_DIRECTORY && strcmp(info->name, "..")==0;    // check if file is '..'
+
     if (dir)
     {
         f->priv->dir_handle = gnome_cmd_dir_get_handle (dir);
         handle_ref (f->priv->dir_handle);
 
-        GNOME_CMD_FILE_INFO (f)->uri = gnome_cmd_dir_get_child_uri (dir, f->info->name);
-        gnome_vfs_uri_ref (GNOME_CMD_FILE_INFO (f)->uri);
+        // dirs outlive the listing they are part of in the dir cache, they don't keep its arena
+        if (!GNOME_CMD_IS_DIR (f) && !names)
+            f->priv->names = name_arena_ref (gnome_cmd_dir_get_names (dir));
     }
 
+    if (collate_key && names)
+    {
+        // prepared in bulk by the listing workers
+        f->priv->names = name_arena_ref (names);
+        f->collate_key = collate_key;
+    }
+    else
+        set_collate_key (f, gnome_cmd_file_create_collate_key (info->name));
+
     gnome_vfs_file_info_ref (f->info);
 }
 
@@ -261,6 +304,7 @@ GnomeVFSResult GnomeCmdFile::chmod(GnomeVFSFilePermissions perm)
     g_return_val_if_fail (info != NULL, GNOME_VFS_ERROR_CORRUPTED_DATA);
 
     info->permissions = perm;
+    invalidate_sort_key();
     GnomeVFSURI *uri = get_uri();
     GnomeVFSResult ret = gnome_vfs_set_file_info_uri (uri, info, GNOME_VFS_SET_FILE_INFO_PERMISSIONS);
     gnome_vfs_uri_unref (uri);
@@ -284,6 +328,7 @@ GnomeVFSResult GnomeCmdFile::chown(uid_t uid, gid_t gid)
     if (uid != (uid_t)-1)
         info->uid = uid;
     info->gid = gid;
+    invalidate_sort_key();
 
     GnomeVFSURI *uri = get_uri();
     GnomeVFSResult ret = gnome_vfs_set_file_info_uri (uri, info, GNOME_VFS_SET_FILE_INFO_OWNER);
@@ -457,6 +502,34 @@ const gchar *GnomeCmdFile::get_extension()
 }
 
 
+void GnomeCmdFile::update_sort_key()
+{
+    g_return_if_fail (info != NULL);
+
+    sort_key.type = info->type;
+    sort_key.permissions = info->permissions & 07777;
+    sort_key.uid = info->uid;
+    sort_key.gid = info->gid;
+    sort_key.mtime = info->mtime;
+    sort_key.size = info->size;
+    sort_key.extension = get_extension();
+    sort_key.valid = TRUE;
+}
+
+
+const gchar *GnomeCmdFile::get_sort_dirname()
+{
+    if (!sort_key.dirname)
+    {
+        gchar *dirname = get_dirname();
+        sort_key.dirname = g_intern_string (dirname);
+        g_free (dirname);
+    }
+
+    return sort_key.dirname;
+}
+
+
 const gchar *GnomeCmdFile::get_owner()
 {
     g_return_val_if_fail (info != NULL, NULL);
@@ -542,7 +615,7 @@ GnomeVFSFileSize GnomeCmdFile::get_tree_size()
         return priv->tree_size;
 
     GnomeVFSURI *uri = get_uri();
-    priv->tree_size = calc_tree_size (uri,NULL);
+    priv->tree_size = treesize_calc (uri, NULL);
     gnome_vfs_uri_unref (uri);
 
     return priv->tree_size;
@@ -615,9 +688,41 @@ gboolean GnomeCmdFile::get_type_pixmap_and_mask(GdkPixmap **pixmap, GdkBitmap **
 }
 
 
+// Takes over @a mime_type, the real type of a file whose type has been guessed so far
+void GnomeCmdFile::set_mime_type(gchar *mime_type)
+{
+    g_return_if_fail (info != NULL);
+    g_return_if_fail (mime_type != NULL);
+
+    g_free (info->mime_type);
+    info->mime_type = mime_type;
+    info->valid_fields = (GnomeVFSFileInfoFields) (info->valid_fields | GNOME_VFS_FILE_INFO_FIELDS_MIME_TYPE);
+    mime_type_guessed = FALSE;
+}
+
+
+// Looks up the real MIME type right away if it has been guessed, for anything which depends on it
+void GnomeCmdFile::resolve_mime_type()
+{
+    if (!mime_type_guessed)
+        return;
+
+    gchar *uri_str = get_uri_str();
+    gchar *mime_type = gnome_vfs_get_mime_type (uri_str);
+
+    g_free (uri_str);
+
+    if (mime_type)
+        set_mime_type(mime_type);
+    else
+        mime_type_guessed = FALSE;      // keep the guess, it can't be done better
+}
+
+
 gboolean GnomeCmdFile::has_mime_type(const gchar *mime_type)
 {
     g_return_val_if_fail (info != NULL, FALSE);
+    resolve_mime_type();
     g_return_val_if_fail (info->mime_type != NULL, FALSE);
     g_return_val_if_fail (mime_type != NULL, FALSE);
 
@@ -628,6 +733,7 @@ gboolean GnomeCmdFile::has_mime_type(const gchar *mime_type)
 gboolean GnomeCmdFile::mime_begins_with(const gchar *mime_type_start)
 {
     g_return_val_if_fail (info != NULL, FALSE);
+    resolve_mime_type();
     g_return_val_if_fail (info->mime_type != NULL, FALSE);
     g_return_val_if_fail (mime_type_start != NULL, FALSE);
 
@@ -770,24 +876,26 @@ void GnomeCmdFile::update_info(GnomeVFSFileInfo *file_info)
 {
     g_return_if_fail (file_info != NULL);
 
-    g_free (collate_key);
+    GnomeCmdFileInfo *file_info_parent = GNOME_CMD_FILE_INFO (this);
+
     gnome_vfs_file_info_unref (this->info);
     gnome_vfs_file_info_ref (file_info);
     this->info = file_info;
+    mime_type_guessed = FALSE;
 
-    gchar *utf8_name;
+    gnome_vfs_file_info_unref (file_info_parent->info);
+    gnome_vfs_file_info_ref (file_info);
+    file_info_parent->info = file_info;
 
-    if (!gnome_cmd_data.options.case_sens_sort)
+    // built again by gnome_cmd_file_list_export_uris() for a renamed file
+    if (file_info_parent->uri)
     {
-        gchar *s = get_utf8 (file_info->name);
-        utf8_name = g_utf8_casefold (s, -1);
-        g_free (s);
+        gnome_vfs_uri_unref (file_info_parent->uri);
+        file_info_parent->uri = NULL;
     }
-    else
-        utf8_name = get_utf8 (file_info->name);
 
-    collate_key = g_utf8_collate_key_for_filename (utf8_name, -1);
-    g_free (utf8_name);
+    set_collate_key (this, gnome_cmd_file_create_collate_key (file_info->name));
+    invalidate_sort_key();
 }
 
 
@@ -889,6 +997,18 @@ void gnome_cmd_file_list_free (GList *files)
 }
 
 
+void gnome_cmd_file_list_export_uris (GList *files)
+{
+    for (; files; files = files->next)
+    {
+        GnomeCmdFile *f = GNOME_CMD_FILE (files->data);
+
+        if (!GNOME_CMD_FILE_INFO (f)->uri)
+            GNOME_CMD_FILE_INFO (f)->uri = f->get_uri();
+    }
+}
+
+
 GnomeCmdDir *GnomeCmdFile::get_parent_dir()
 {
     return ::get_parent_dir (this);
@@ -923,6 +1043,12 @@ void GnomeCmdFile::invalidate_tree_size()
 }
 
 
+void GnomeCmdFile::set_tree_size(GnomeVFSFileSize size)
+{
+    priv->tree_size = size;
+}
+
+
 gboolean GnomeCmdFile::has_tree_size()
 {
     return priv->tree_size != (GnomeVFSFileSize)-1;
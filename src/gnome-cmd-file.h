@@ -35,6 +35,7 @@ GType gnome_cmd_file_get_type ();
 class GnomeCmdFileMetadata;
 
 struct GnomeCmdDir;
+struct NameArena;
 
 
 struct GnomeCmdFile
@@ -46,10 +47,24 @@ struct GnomeCmdFile
     Private *priv;
 
     GnomeVFSFileInfo *info;
-    gboolean is_dotdot;
-    gchar *collate_key;                 // necessary for proper sorting of UTF-8 encoded file names
+    guint is_dotdot : 1;
+    guint mime_type_guessed : 1;        // info->mime_type is guessed from the name only, see mimeresolver.h
+    const gchar *collate_key;           // necessary for proper sorting of UTF-8 encoded file names, in a NameArena
     GnomeCmdFileMetadata *metadata;
 
+    struct SortKey                      // everything the file list sorts on and displays, packed
+    {
+        time_t mtime;
+        GnomeVFSFileSize size;
+        const gchar *extension;         // points into info->name, NULL for dirs and names without extension
+        const gchar *dirname;           // interned, NULL until get_sort_dirname() has been called
+        guint32 uid;
+        guint32 gid;
+        guint16 permissions;            // without the GNOME_VFS_PERM_ACCESS_* bits
+        guint8 type;
+        guint8 valid;
+    } sort_key;
+
     GnomeCmdFile *ref();
     void unref();
 
@@ -65,7 +80,12 @@ struct GnomeCmdFile
     GnomeVFSURI *get_uri(const gchar *name=NULL);
     gchar *get_uri_str(GnomeVFSURIHideOptions hide_options=GNOME_VFS_URI_HIDE_PASSWORD);
 
-    char *get_collation_fname() const    {  return collate_key ? collate_key : info->name;  }
+    const char *get_collation_fname() const  {  return collate_key ? collate_key : info->name;  }
+
+    const SortKey &get_sort_key()        {  if (!sort_key.valid) update_sort_key();  return sort_key;  }
+    const gchar *get_sort_dirname();
+    void invalidate_sort_key()           {  sort_key.valid = FALSE;  sort_key.dirname = NULL;  }
+    void update_sort_key();
 
     const gchar *get_extension();
     const gchar *get_owner();
@@ -79,6 +99,8 @@ struct GnomeCmdFile
     const gchar *get_perm();
     const gchar *get_mime_type();
     const gchar *get_mime_type_desc();
+    void set_mime_type(gchar *mime_type);
+    void resolve_mime_type();
     gboolean has_mime_type(const gchar *mime_type);
     gboolean mime_begins_with(const gchar *mime_type_start);
 
@@ -101,6 +123,7 @@ struct GnomeCmdFile
     gboolean needs_update();
 
     void invalidate_tree_size();
+    void set_tree_size(GnomeVFSFileSize size);
     gboolean has_tree_size();
 
     GnomeVFSMimeApplication *get_default_application();
@@ -120,8 +143,19 @@ inline gchar *GnomeCmdFile::get_name()
 
 GnomeCmdFile *gnome_cmd_file_new_from_uri (GnomeVFSURI *uri);
 GnomeCmdFile *gnome_cmd_file_new (const gchar *local_full_path);
-GnomeCmdFile *gnome_cmd_file_new (GnomeVFSFileInfo *info, GnomeCmdDir *dir);
-void gnome_cmd_file_setup (GnomeCmdFile *f, GnomeVFSFileInfo *info, GnomeCmdDir *dir);
+
+/**
+ * @a collate_key, if given, is in @a names, which is then kept by the
+ * file. Otherwise the key is put into the arena of @a dir.
+ */
+GnomeCmdFile *gnome_cmd_file_new (GnomeVFSFileInfo *info, GnomeCmdDir *dir, const gchar *collate_key=NULL, NameArena *names=NULL);
+void gnome_cmd_file_setup (GnomeCmdFile *f, GnomeVFSFileInfo *info, GnomeCmdDir *dir, const gchar *collate_key=NULL, NameArena *names=NULL);
+
+/**
+ * Returns a newly allocated collation key for @a name, honouring the
+ * case sensitivity sort option. Can be called from any thread.
+ */
+gchar *gnome_cmd_file_create_collate_key (const gchar *name);
 
 inline GnomeCmdFile *gnome_cmd_file_ref (GnomeCmdFile *f)
 {
@@ -177,6 +211,12 @@ void gnome_cmd_file_show_cap_paste (GnomeCmdFile *f);
 GList *gnome_cmd_file_list_copy (GList *files);
 void gnome_cmd_file_list_free (GList *files);
 
+/**
+ * Sets GnomeCmdFileInfo::uri of @a files, which is only built for the
+ * plugins reading it, to spare an URI per listed file.
+ */
+void gnome_cmd_file_list_export_uris (GList *files);
+
 inline void gnome_cmd_file_list_ref (GList *files)
 {
     g_list_foreach (files, (GFunc) gnome_cmd_file_ref, NULL);
@@ -190,16 +230,19 @@ inline void gnome_cmd_file_list_unref (GList *files)
 inline const gchar *GnomeCmdFile::get_mime_type()
 {
     g_return_val_if_fail (info != NULL, NULL);
+    resolve_mime_type();
     return gnome_vfs_file_info_get_mime_type (info);
 }
 
 inline const gchar *GnomeCmdFile::get_mime_type_desc()
 {
     g_return_val_if_fail (info != NULL, NULL);
+    resolve_mime_type();
     return info->mime_type ? gnome_vfs_mime_get_description (info->mime_type) : NULL;
 }
 
 inline GnomeVFSMimeApplication *GnomeCmdFile::get_default_application()
 {
+    resolve_mime_type();
     return info->mime_type ? gnome_vfs_mime_get_default_application (info->mime_type) : NULL;
 }
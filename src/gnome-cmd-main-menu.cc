@@ -457,6 +457,12 @@ static void init (GnomeCmdMainMenu *main_menu)
             GNOME_APP_PIXMAP_NONE, NULL,
             NULL
         },
+        {
+            MENU_TYPE_ITEM, _("_Transfers…"), "", NULL,
+            (gpointer) file_transfers, NULL,
+            GNOME_APP_PIXMAP_NONE, NULL,
+            NULL
+        },
         MENUTYPE_SEPARATOR,
         {
             MENU_TYPE_ITEM, _("Start _GNOME Commander as root"), "", NULL,
@@ -1402,6 +1402,11 @@ GnomeCmdState *GnomeCmdMainWin::get_state() const
     state->active_dir_selected_files = fs1->file_list()->get_selected_files();
     state->inactive_dir_selected_files = fs2->file_list()->get_selected_files();
 
+    // the plugins read the URIs of the files they act on straight from GnomeCmdFileInfo,
+    // building them for all the visible files would cost a pass over both panels per menu
+    gnome_cmd_file_list_export_uris (state->active_dir_selected_files);
+    gnome_cmd_file_list_export_uris (state->inactive_dir_selected_files);
+
     return state;
 }
 
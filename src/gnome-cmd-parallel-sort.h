@@ -0,0 +1,140 @@
+/**
+ * @file gnome-cmd-parallel-sort.h
+ * @copyright (C) 2013-2017 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace GnomeCmd
+{
+    /**
+     * Arrays shorter than twice this size are sorted by the calling
+     * thread only, below that starting the threads costs more than it saves.
+     */
+    const gsize PARALLEL_SORT_MIN_CHUNK = 16384;
+
+    /**
+     * Adapts a GCompareDataFunc to the 'less' predicate of the std algorithms.
+     */
+    struct CompareDataLess
+    {
+        GCompareDataFunc compare_func;
+        gpointer user_data;
+
+        CompareDataLess(GCompareDataFunc func, gpointer data): compare_func(func), user_data(data)   {}
+
+        bool operator () (gconstpointer p1, gconstpointer p2) const
+        {
+            return compare_func (p1, p2, user_data) < 0;
+        }
+    };
+
+    template <typename T, typename Compare>
+    struct ParallelSortTask
+    {
+        T *first;
+        T *middle;          // NULL: sort [first, last), otherwise merge [first, middle) and [middle, last)
+        T *last;
+        Compare *comp;
+
+        static gpointer run(gpointer data)
+        {
+            ParallelSortTask *task = static_cast<ParallelSortTask *> (data);
+
+            if (task->middle)
+                std::inplace_merge (task->first, task->middle, task->last, *task->comp);
+            else
+                std::stable_sort (task->first, task->last, *task->comp);
+
+            return NULL;
+        }
+    };
+
+    /**
+     * Stable sort of [first, last) split over the available processors:
+     * the chunks are sorted concurrently and then merged pairwise, with
+     * the merges of each round running concurrently as well. @a comp is
+     * called from several threads at once, so it must not modify anything.
+     */
+    template <typename T, typename Compare>
+    void parallel_stable_sort(T *first, T *last, Compare comp, gsize min_chunk=PARALLEL_SORT_MIN_CHUNK)
+    {
+        gsize n = last - first;
+        gsize n_chunks = MIN ((gsize) g_get_num_processors (), n / MAX (min_chunk, 1));
+
+        if (n_chunks < 2)
+        {
+            std::stable_sort (first, last, comp);
+            return;
+        }
+
+        std::vector<T *> bounds;
+
+        for (gsize i=0; i<n_chunks; ++i)
+            bounds.push_back(first + i * n / n_chunks);
+        bounds.push_back(last);
+
+        std::vector<ParallelSortTask<T,Compare> > tasks;
+        std::vector<GThread *> threads;
+
+        for (gsize i=0; i+1<bounds.size(); ++i)
+        {
+            ParallelSortTask<T,Compare> task = {bounds[i], NULL, bounds[i+1], &comp};
+            tasks.push_back(task);
+        }
+
+        while (!tasks.empty())
+        {
+            // the first task of a round is run by the calling thread
+            for (gsize i=1; i<tasks.size(); ++i)
+                threads.push_back(g_thread_new ("gcmd-sort", ParallelSortTask<T,Compare>::run, &tasks[i]));
+
+            ParallelSortTask<T,Compare>::run(&tasks[0]);
+
+            for (gsize i=0; i<threads.size(); ++i)
+                g_thread_join (threads[i]);
+
+            threads.clear();
+            tasks.clear();
+
+            if (bounds.size() <= 2)
+                break;
+
+            // merge neighbouring runs, an odd run at the end is carried over to the next round
+            std::vector<T *> merged_bounds;
+
+            for (gsize i=0; i+1<bounds.size(); i+=2)
+            {
+                merged_bounds.push_back(bounds[i]);
+
+                if (i+2 < bounds.size())
+                {
+                    ParallelSortTask<T,Compare> task = {bounds[i], bounds[i+1], bounds[i+2], &comp};
+                    tasks.push_back(task);
+                }
+            }
+            merged_bounds.push_back(last);
+
+            bounds.swap(merged_bounds);
+        }
+    }
+}
@@ -35,6 +35,7 @@
 #include "gnome-cmd-python-plugin.h"
 #include "gnome-cmd-user-actions.h"
 #include "gnome-cmd-dir-indicator.h"
+#include "gnome-cmd-xfer-manager.h"
 #include "gnome-cmd-style.h"
 #include "plugin_manager.h"
 #include "cap.h"
@@ -234,6 +235,7 @@ static UserActionData user_actions_data[] = {
                                              // {file_run, "file.run"},
                                              {file_sendto, "file.sendto", N_("Send files")},
                                              {file_sync_dirs, "file.synchronize_directories", N_("Synchronize directories")},
+                                             {file_transfers, "file.transfers", N_("Show transfers")},
                                              // {file_umount, "file.umount"},
                                              {file_view, "file.view", N_("View file")},
                                              {help_about, "help.about", N_("About GNOME Commander")},
@@ -1035,6 +1037,12 @@ void file_sync_dirs (GtkMenuItem *menuitem, gpointer not_used)
 }
 
 
+void file_transfers (GtkMenuItem *menuitem, gpointer not_used)
+{
+    gnome_cmd_xfer_manager_show ();
+}
+
+
 void file_exit (GtkMenuItem *menuitem, gpointer not_used)
 {
     gint x, y;
@@ -0,0 +1,541 @@
+/**
+ * @file gnome-cmd-xfer-manager.cc
+ * @copyright (C) 2013-2017 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/sysmacros.h>
+#endif
+
+#include "gnome-cmd-includes.h"
+#include "gnome-cmd-xfer-manager.h"
+#include "gnome-cmd-data.h"
+#include "gnome-cmd-main-win.h"
+#include "gnome-cmd-treeview.h"
+#include "utils.h"
+
+using namespace std;
+
+
+enum JobState
+{
+    JOB_QUEUED,
+    JOB_RUNNING
+};
+
+
+struct GnomeCmdXferJob
+{
+    guint id;
+    gchar *title;
+    gchar *devices[2];          // of the first source and of the target, NULL if unknown
+    gboolean devices_known;     // not before the lookup thread is done, see lookup_devices ()
+    JobState state;
+    gboolean paused;
+
+    GnomeCmdXferJobFunc start_func;
+    GnomeCmdXferJobPauseFunc pause_func;
+    GnomeCmdXferJobFunc cancel_func;
+    gpointer user_data;
+
+    GtkTreeIter iter;           // in store, GtkListStore iters persist
+};
+
+
+enum
+{
+    COL_TITLE,
+    COL_STATE,
+    COL_PROGRESS,
+    COL_JOB,
+    NUM_COLS
+};
+
+
+static GList *jobs = NULL;                  // in the order they are started
+static guint last_job_id = 0;
+static GtkListStore *store = NULL;
+static GtkWidget *jobs_win = NULL;
+static GtkWidget *jobs_view = NULL;
+
+
+/***********************************
+ * Devices
+ ***********************************/
+
+/**
+ * A name of the physical device @a path is on: the whole disk for
+ * partitions, so that two partitions of one disk are one device, the
+ * st_dev of the file system for everything else.
+ */
+static gchar *get_local_device (const gchar *path)
+{
+    struct stat st;
+
+    if (stat (path, &st) != 0)
+        return NULL;
+
+#ifdef __linux__
+    gchar *sys_path = g_strdup_printf ("/sys/dev/block/%u:%u", major (st.st_dev), minor (st.st_dev));
+    gchar *real_path = realpath (sys_path, NULL);
+    gchar *partition_path = real_path ? g_build_filename (real_path, "partition", NULL) : NULL;
+    gchar *device = NULL;
+
+    if (real_path)
+    {
+        gchar *disk_path = g_file_test (partition_path, G_FILE_TEST_EXISTS) ? g_path_get_dirname (real_path) : g_strdup (real_path);
+        gchar *disk = g_path_get_basename (disk_path);
+
+        device = g_strconcat ("disk:", disk, NULL);
+
+        g_free (disk);
+        g_free (disk_path);
+    }
+
+    free (real_path);
+    g_free (partition_path);
+    g_free (sys_path);
+
+    if (device)
+        return device;
+#endif
+
+    return g_strdup_printf ("dev:%lu", (gulong) st.st_dev);
+}
+
+
+// Remote locations are told apart by their host, every server counts as a device of its own
+static gchar *get_device (GnomeVFSURI *uri)
+{
+    if (g_strcmp0 (gnome_vfs_uri_get_scheme (uri), "file") == 0)
+    {
+        gchar *uri_str = gnome_vfs_uri_to_string (uri, GNOME_VFS_URI_HIDE_NONE);
+        gchar *path = gnome_vfs_get_local_path_from_uri (uri_str);
+        gchar *device = path ? get_local_device (path) : NULL;
+
+        g_free (path);
+        g_free (uri_str);
+
+        return device;
+    }
+
+    return g_strdup_printf ("%s://%s", gnome_vfs_uri_get_scheme (uri), gnome_vfs_uri_get_host_name (uri));
+}
+
+
+// Paused running jobs keep their devices, so that resuming them never exceeds the limit
+static guint count_jobs_on_device (const gchar *device)
+{
+    guint n = 0;
+
+    for (GList *i = jobs; i; i = i->next)
+    {
+        GnomeCmdXferJob *job = (GnomeCmdXferJob *) i->data;
+
+        if (job->state == JOB_RUNNING)
+            for (guint d=0; d<G_N_ELEMENTS(job->devices); ++d)
+                if (g_strcmp0 (job->devices[d], device) == 0)
+                {
+                    ++n;
+                    break;
+                }
+    }
+
+    return n;
+}
+
+
+inline gboolean can_start (GnomeCmdXferJob *job)
+{
+    for (guint d=0; d<G_N_ELEMENTS(job->devices); ++d)
+        if (job->devices[d] && count_jobs_on_device (job->devices[d]) >= gnome_cmd_data.xfer_jobs_per_device)
+            return FALSE;
+
+    return TRUE;
+}
+
+
+/***********************************
+ * The queue
+ ***********************************/
+
+static void update_row (GnomeCmdXferJob *job)
+{
+    const gchar *state = job->paused ? _("paused") :
+                         job->state == JOB_RUNNING ? _("running") : _("queued");
+
+    gtk_list_store_set (store, &job->iter, COL_STATE, state, -1);
+}
+
+
+// Starts the queued jobs in order, each one whose devices aren't busy
+static void schedule ()
+{
+    for (GList *i = jobs; i; )
+    {
+        GnomeCmdXferJob *job = (GnomeCmdXferJob *) i->data;
+
+        if (job->state != JOB_QUEUED || job->paused || !job->devices_known || !can_start (job))
+        {
+            i = i->next;
+            continue;
+        }
+
+        DEBUG ('x', "Starting transfer job %s\n", job->title);
+
+        job->state = JOB_RUNNING;
+        update_row (job);
+        job->start_func (job->user_data);
+
+        // the job may have finished right away, which changes the list
+        i = jobs;
+    }
+}
+
+
+static GnomeCmdXferJob *find_job (guint id)
+{
+    for (GList *i = jobs; i; i = i->next)
+        if (((GnomeCmdXferJob *) i->data)->id == id)
+            return (GnomeCmdXferJob *) i->data;
+
+    return NULL;
+}
+
+
+struct DeviceLookup
+{
+    guint job_id;
+    GnomeVFSURI *uris[2];
+    gchar *devices[2];
+};
+
+
+static gboolean on_devices_found (DeviceLookup *lookup)
+{
+    // the job may have been cancelled meanwhile
+    GnomeCmdXferJob *job = find_job (lookup->job_id);
+
+    if (job)
+    {
+        job->devices[0] = lookup->devices[0];
+        job->devices[1] = lookup->devices[1];
+        job->devices_known = TRUE;
+
+        // the same device twice is counted once
+        if (g_strcmp0 (job->devices[0], job->devices[1]) == 0)
+        {
+            g_free (job->devices[1]);
+            job->devices[1] = NULL;
+        }
+
+        DEBUG ('x', "Queued transfer job %s, devices %s and %s\n", job->title, job->devices[0], job->devices[1]);
+
+        schedule ();
+
+        // a job which has to wait shouldn't just seem to do nothing
+        job = find_job (lookup->job_id);
+
+        if (job && job->state == JOB_QUEUED && !job->paused)
+            gnome_cmd_xfer_manager_show ();
+    }
+    else
+    {
+        g_free (lookup->devices[0]);
+        g_free (lookup->devices[1]);
+    }
+
+    g_free (lookup);
+
+    return FALSE;
+}
+
+
+// stat () on a hung network mount would block, so the devices are looked up in a thread of their own for each job
+static gpointer lookup_devices (DeviceLookup *lookup)
+{
+    for (guint d=0; d<G_N_ELEMENTS(lookup->uris); ++d)
+    {
+        lookup->devices[d] = get_device (lookup->uris[d]);
+        gnome_vfs_uri_unref (lookup->uris[d]);
+    }
+
+    g_idle_add ((GSourceFunc) on_devices_found, lookup);
+
+    return NULL;
+}
+
+
+static void free_job (GnomeCmdXferJob *job)
+{
+    jobs = g_list_remove (jobs, job);
+    gtk_list_store_remove (store, &job->iter);
+
+    g_free (job->title);
+    g_free (job->devices[0]);
+    g_free (job->devices[1]);
+    g_free (job);
+}
+
+
+GnomeCmdXferJob *gnome_cmd_xfer_manager_add (const gchar *title,
+                                             GList *src_uri_list,
+                                             GnomeVFSURI *dest_uri,
+                                             GnomeCmdXferJobFunc start_func,
+                                             GnomeCmdXferJobPauseFunc pause_func,
+                                             GnomeCmdXferJobFunc cancel_func,
+                                             gpointer user_data)
+{
+    g_return_val_if_fail (src_uri_list != NULL, NULL);
+    g_return_val_if_fail (dest_uri != NULL, NULL);
+    g_return_val_if_fail (start_func != NULL, NULL);
+    g_return_val_if_fail (cancel_func != NULL, NULL);
+
+    if (!store)
+        store = gtk_list_store_new (NUM_COLS, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_INT, G_TYPE_POINTER);
+
+    GnomeCmdXferJob *job = g_new0 (GnomeCmdXferJob, 1);
+
+    job->id = ++last_job_id;
+    job->title = g_strdup (title);
+    job->state = JOB_QUEUED;
+    job->start_func = start_func;
+    job->pause_func = pause_func;
+    job->cancel_func = cancel_func;
+    job->user_data = user_data;
+
+    jobs = g_list_append (jobs, job);
+
+    gtk_list_store_append (store, &job->iter);
+    gtk_list_store_set (store, &job->iter, COL_TITLE, job->title, COL_PROGRESS, 0, COL_JOB, job, -1);
+    update_row (job);
+
+    DeviceLookup *lookup = g_new0 (DeviceLookup, 1);
+
+    lookup->job_id = job->id;
+    lookup->uris[0] = gnome_vfs_uri_dup ((GnomeVFSURI *) src_uri_list->data);
+    lookup->uris[1] = gnome_vfs_uri_dup (dest_uri);
+
+    g_thread_unref (g_thread_new ("gcmd-xfer-devices", (GThreadFunc) lookup_devices, lookup));
+
+    return job;
+}
+
+
+void gnome_cmd_xfer_manager_set_progress (GnomeCmdXferJob *job, gfloat progress)
+{
+    g_return_if_fail (job != NULL);
+
+    gtk_list_store_set (store, &job->iter, COL_PROGRESS, (gint) (CLAMP (progress, 0.0f, 1.0f) * 100.0f), -1);
+}
+
+
+void gnome_cmd_xfer_manager_job_finished (GnomeCmdXferJob *job)
+{
+    g_return_if_fail (job != NULL);
+
+    DEBUG ('x', "Finished transfer job %s\n", job->title);
+
+    free_job (job);
+    schedule ();
+}
+
+
+/***********************************
+ * The job list window
+ ***********************************/
+
+inline GnomeCmdXferJob *get_selected_job ()
+{
+    GtkTreeIter iter;
+    GnomeCmdXferJob *job = NULL;
+
+    if (gtk_tree_selection_get_selected (gtk_tree_view_get_selection (GTK_TREE_VIEW (jobs_view)), NULL, &iter))
+        gtk_tree_model_get (GTK_TREE_MODEL (store), &iter, COL_JOB, &job, -1);
+
+    return job;
+}
+
+
+static void on_pause (GtkButton *button, gpointer unused)
+{
+    GnomeCmdXferJob *job = get_selected_job ();
+
+    if (!job || job->paused || (job->state == JOB_RUNNING && !job->pause_func))
+        return;
+
+    job->paused = TRUE;
+
+    if (job->state == JOB_RUNNING)
+        job->pause_func (TRUE, job->user_data);
+
+    update_row (job);
+    schedule ();
+}
+
+
+static void on_resume (GtkButton *button, gpointer unused)
+{
+    GnomeCmdXferJob *job = get_selected_job ();
+
+    if (!job || !job->paused)
+        return;
+
+    job->paused = FALSE;
+
+    if (job->state == JOB_RUNNING)
+        job->pause_func (FALSE, job->user_data);
+
+    update_row (job);
+    schedule ();
+}
+
+
+static void move_job (gint delta)
+{
+    GnomeCmdXferJob *job = get_selected_job ();
+
+    if (!job)
+        return;
+
+    GList *link = g_list_find (jobs, job);
+    GList *other = delta < 0 ? link->prev : link->next;
+
+    if (!other)
+        return;
+
+    gtk_list_store_swap (store, &job->iter, &((GnomeCmdXferJob *) other->data)->iter);
+
+    link->data = other->data;
+    other->data = job;
+
+    // a job moved to the front may be startable now
+    schedule ();
+}
+
+
+static void on_move_up (GtkButton *button, gpointer unused)
+{
+    move_job (-1);
+}
+
+
+static void on_move_down (GtkButton *button, gpointer unused)
+{
+    move_job (+1);
+}
+
+
+static void on_cancel (GtkButton *button, gpointer unused)
+{
+    GnomeCmdXferJob *job = get_selected_job ();
+
+    if (!job)
+        return;
+
+    if (job->state == JOB_RUNNING)
+    {
+        // the job cleans up and calls gnome_cmd_xfer_manager_job_finished () itself
+        if (job->paused)
+            job->pause_func (FALSE, job->user_data);
+        job->cancel_func (job->user_data);
+        return;
+    }
+
+    GnomeCmdXferJobFunc cancel_func = job->cancel_func;
+    gpointer user_data = job->user_data;
+
+    free_job (job);
+    cancel_func (user_data);
+}
+
+
+static void on_close (GtkButton *button, GtkWidget *win)
+{
+    gtk_widget_destroy (win);
+}
+
+
+static void on_jobs_win_destroy (GtkWidget *win, gpointer unused)
+{
+    jobs_win = NULL;
+    jobs_view = NULL;
+}
+
+
+void gnome_cmd_xfer_manager_show ()
+{
+    if (jobs_win)
+    {
+        gtk_window_present (GTK_WINDOW (jobs_win));
+        return;
+    }
+
+    if (!store)
+        store = gtk_list_store_new (NUM_COLS, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_INT, G_TYPE_POINTER);
+
+    jobs_win = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+    gtk_window_set_title (GTK_WINDOW (jobs_win), _("Transfers"));
+    gtk_window_set_transient_for (GTK_WINDOW (jobs_win), *main_win);
+    gtk_window_set_default_size (GTK_WINDOW (jobs_win), 520, 240);
+    g_signal_connect (jobs_win, "destroy", G_CALLBACK (on_jobs_win_destroy), NULL);
+
+    GtkWidget *vbox = create_vbox (jobs_win, FALSE, 6);
+    gtk_container_add (GTK_CONTAINER (jobs_win), vbox);
+    gtk_container_set_border_width (GTK_CONTAINER (vbox), 6);
+
+    GtkWidget *sw = create_sw (jobs_win);
+    gtk_scrolled_window_set_shadow_type (GTK_SCROLLED_WINDOW (sw), GTK_SHADOW_IN);
+    gtk_box_pack_start (GTK_BOX (vbox), sw, TRUE, TRUE, 0);
+
+    jobs_view = gtk_tree_view_new_with_model (GTK_TREE_MODEL (store));
+    g_object_set (jobs_view, "rules-hint", TRUE, NULL);
+
+    GtkCellRenderer *renderer = NULL;
+    GtkTreeViewColumn *col = gnome_cmd_treeview_create_new_text_column (GTK_TREE_VIEW (jobs_view), renderer, COL_TITLE, _("Transfer"));
+    gtk_tree_view_column_set_expand (col, TRUE);
+    g_object_set (renderer, "ellipsize-set", TRUE, "ellipsize", PANGO_ELLIPSIZE_MIDDLE, NULL);
+
+    gnome_cmd_treeview_create_new_text_column (GTK_TREE_VIEW (jobs_view), COL_STATE, _("State"));
+
+    renderer = gtk_cell_renderer_progress_new ();
+    col = gtk_tree_view_column_new_with_attributes (_("Progress"), renderer, "value", COL_PROGRESS, NULL);
+    gtk_tree_view_column_set_min_width (col, 100);
+    gtk_tree_view_append_column (GTK_TREE_VIEW (jobs_view), col);
+
+    gtk_container_add (GTK_CONTAINER (sw), jobs_view);
+    gtk_widget_show (jobs_view);
+
+    GtkWidget *bbox = create_hbuttonbox (jobs_win);
+    gtk_button_box_set_layout (GTK_BUTTON_BOX (bbox), GTK_BUTTONBOX_END);
+    gtk_box_set_spacing (GTK_BOX (bbox), 6);
+    gtk_box_pack_start (GTK_BOX (vbox), bbox, FALSE, FALSE, 0);
+
+    gtk_container_add (GTK_CONTAINER (bbox), create_stock_button_with_data (jobs_win, GTK_STOCK_GO_UP, G_CALLBACK (on_move_up), NULL));
+    gtk_container_add (GTK_CONTAINER (bbox), create_stock_button_with_data (jobs_win, GTK_STOCK_GO_DOWN, G_CALLBACK (on_move_down), NULL));
+    gtk_container_add (GTK_CONTAINER (bbox), create_stock_button_with_data (jobs_win, GTK_STOCK_MEDIA_PAUSE, G_CALLBACK (on_pause), NULL));
+    gtk_container_add (GTK_CONTAINER (bbox), create_stock_button_with_data (jobs_win, GTK_STOCK_MEDIA_PLAY, G_CALLBACK (on_resume), NULL));
+    gtk_container_add (GTK_CONTAINER (bbox), create_stock_button_with_data (jobs_win, GTK_STOCK_CANCEL, G_CALLBACK (on_cancel), NULL));
+    gtk_container_add (GTK_CONTAINER (bbox), create_stock_button (jobs_win, GTK_STOCK_CLOSE, G_CALLBACK (on_close)));
+
+    gtk_widget_show_all (jobs_win);
+}
@@ -0,0 +1,54 @@
+/**
+ * @file gnome-cmd-xfer-manager.h
+ * @copyright (C) 2013-2017 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+struct GnomeCmdXferJob;
+
+typedef void (* GnomeCmdXferJobFunc) (gpointer user_data);
+typedef void (* GnomeCmdXferJobPauseFunc) (gboolean paused, gpointer user_data);
+
+/**
+ * Queues a transfer from @a src_uri_list into the dir @a dest_uri. The
+ * job is started with @a start_func as soon as its devices are looked
+ * up, which is done off the GTK thread, and fewer than
+ * gnome_cmd_data.xfer_jobs_per_device other running jobs, paused or
+ * not, read from or write to the same physical devices. @a start_func
+ * is never called from within this function. @a pause_func, if not NULL,
+ * pauses and resumes the job while it's running. @a cancel_func is
+ * called for a job cancelled in the job list, if it's still queued it
+ * has to free its data. Every started job has to call
+ * gnome_cmd_xfer_manager_job_finished () once it's done or cancelled.
+ */
+GnomeCmdXferJob *gnome_cmd_xfer_manager_add (const gchar *title,
+                                             GList *src_uri_list,
+                                             GnomeVFSURI *dest_uri,
+                                             GnomeCmdXferJobFunc start_func,
+                                             GnomeCmdXferJobPauseFunc pause_func,
+                                             GnomeCmdXferJobFunc cancel_func,
+                                             gpointer user_data);
+
+void gnome_cmd_xfer_manager_set_progress (GnomeCmdXferJob *job, gfloat progress);
+
+void gnome_cmd_xfer_manager_job_finished (GnomeCmdXferJob *job);
+
+/**
+ * Shows the window with all queued and running jobs.
+ */
+void gnome_cmd_xfer_manager_show ();
@@ -20,6 +20,10 @@
  */
 
 #include <config.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "gnome-cmd-includes.h"
@@ -28,9 +32,13 @@
 #include "gnome-cmd-file-list.h"
 #include "gnome-cmd-dir.h"
 #include "gnome-cmd-xfer-progress-win.h"
+#include "gnome-cmd-xfer-manager.h"
 #include "gnome-cmd-main-win.h"
 #include "gnome-cmd-data.h"
+#include "localcopy.h"
+#include "xferjournal.h"
 #include "utils.h"
+#include "treesize.h"
 
 using namespace std;
 
@@ -41,7 +49,9 @@ using namespace std;
 struct XferData
 {
     GnomeVFSXferOptions xferOptions;
+    GnomeVFSXferOverwriteMode xferOverwriteMode;
     GnomeVFSAsyncHandle *handle;
+    GnomeCmdXferJob *job;           // NULL for downloads to /tmp, which aren't queued
 
     // Source and target uri's. The first src_uri should be transfered to the first dest_uri and so on...
     GList *src_uri_list;
@@ -73,7 +83,7 @@ struct XferData
 
     gboolean done;
     gboolean aborted;
-
+    gboolean paused;                // only for native local transfers, read by their threads
 };
 
 
@@ -124,23 +134,27 @@ create_xfer_data (GnomeVFSXferOptions xferOptions, GList *src_uri_list, GList *d
     data->done = FALSE;
     data->aborted = FALSE;
 
-    // If this is a move-operation, determine totals
-    // The async_xfer_callback-results for file and byte totals are not reliable
-    if (xferOptions == GNOME_VFS_XFER_REMOVESOURCE) {
-        GList *uris;
-        data->bytes_total = 0;
-        data->files_total = 0;
-        for (uris = data->src_uri_list; uris != NULL; uris = uris->next) {
-            GnomeVFSURI *uri;
-            uri = (GnomeVFSURI*)uris->data;
-            data->bytes_total += calc_tree_size(uri,&(data->files_total));
-        }
-    }
-
     return data;
 }
 
 
+// For move-operations the async_xfer_callback-results for file and byte totals are not reliable, they are determined beforehand
+static void calc_move_totals (XferData *data)
+{
+    if (data->xferOptions != GNOME_VFS_XFER_REMOVESOURCE)
+        return;
+
+    data->bytes_total = 0;
+    data->files_total = 0;
+
+    for (GList *uris = data->src_uri_list; uris; uris = uris->next)
+    {
+        GnomeVFSURI *uri = (GnomeVFSURI *) uris->data;
+        data->bytes_total += treesize_calc (uri, &(data->files_total));
+    }
+}
+
+
 inline gchar *file_details(const gchar *text_uri)
 {
     GnomeVFSFileInfo *info = gnome_vfs_file_info_new ();
@@ -255,6 +269,9 @@ static gboolean update_xfer_gui_func (XferData *data)
         if (data->on_completed_func)
             data->on_completed_func (data->on_completed_data, NULL);
 
+        if (data->job)
+            gnome_cmd_xfer_manager_job_finished (data->job);
+
         gtk_widget_destroy (GTK_WIDGET (data->win));
         return FALSE;
     }
@@ -291,6 +308,8 @@ static gboolean update_xfer_gui_func (XferData *data)
             {
                 data->first_time = FALSE;
                 gnome_cmd_xfer_progress_win_set_total_progress (data->win, data->bytes_copied, data->file_size, data->total_bytes_copied, data->bytes_total);
+                if (data->job)
+                    gnome_cmd_xfer_manager_set_progress (data->job, total_prog);
                 while (gtk_events_pending ())
                     gtk_main_iteration_do (FALSE);
             }
@@ -340,6 +359,9 @@ static gboolean update_xfer_gui_func (XferData *data)
             data->win = NULL;
         }
 
+        if (data->job)
+            gnome_cmd_xfer_manager_job_finished (data->job);
+
         free_xfer_data (data);
 
         return FALSE;
@@ -351,6 +373,912 @@ static gboolean update_xfer_gui_func (XferData *data)
 }
 
 
+/***********************************
+ * Native local transfers
+ ***********************************/
+
+#define LOCAL_XFER_REPORT_INTERVAL 100000       // in microseconds, between progress reports to the main loop
+#define LOCAL_XFER_CHECKPOINT_SIZE (64*1024*1024)   // between checkpoints, smaller files are simply copied again
+
+/**
+ * Copies between file:// URIs. A walker thread creates the dirs and
+ * symlinks in order and asks about existing targets, the data of regular
+ * files is copied by a pool of gnome_cmd_data.copy_workers threads, see
+ * localcopy_pool_new () and localcopy_data (). Every report is handed to
+ * async_xfer_callback () in the main loop, one at a time, and the
+ * reporting thread waits for its reply, just like gnome_vfs_async_xfer ()
+ * does.
+ *
+ * Moves within one file system are renames done by the walker alone.
+ * Whatever can't be renamed, sources on other file systems and dirs to
+ * be merged into existing ones, is copied and deleted by GnomeVFS
+ * afterwards.
+ *
+ * With gnome_cmd_data.checkpointed_xfers, copies of large files record
+ * checkpoints in the journal of xferjournal.h. A retry continues from
+ * the last one, and so does a later copy to a target left behind.
+ */
+struct LocalXfer
+{
+    XferData *data;                             // only read by the threads, apart from data->aborted
+    GList *src_paths;
+    GList *dest_paths;
+    gboolean follow_links;
+    gboolean move;
+    gboolean checkpoints;
+    gboolean verify;                            // the part copied before a checkpoint, when resuming
+    dev_t dest_dev;                             // moves only, of the dir moved into
+    GList *fallback;                            // walker only, ascending indices of the moves left to GnomeVFS
+    GnomeVFSXferOverwriteMode overwrite_mode;   // walker only
+    guint workers;
+    gint stopped;                               // after an abort chosen in a dialog
+
+    LocalCopyPool *pool;
+    GList *created_dirs;                        // walker only, their permissions are set once all files are copied
+
+    GMutex progress_lock;                       // for the counters below
+    gulong file_index;
+    GnomeVFSFileSize total_bytes_copied;
+
+    GMutex report_lock;                         // held for a whole report, for info and last_report
+    GnomeVFSXferProgressInfo info;
+    gint64 last_report;
+
+    GMutex reply_lock;
+    GCond replied_cond;
+    gint reply;
+    gboolean replied;
+};
+
+
+// A file, dir or symlink being copied by the walker or, for regular files, by a worker
+struct LocalXferItem
+{
+    LocalXfer *xfer;
+    gchar *src;
+    gchar *dest;
+    struct stat st;
+    GnomeVFSFileSize bytes_copied;
+    GnomeVFSFileSize resume_offset;             // where the current attempt has started
+    GnomeVFSFileSize checkpoint;                // the data up to here is on disk, and in the journal
+    int dest_fd;                                // while the data is copied
+};
+
+
+inline void local_xfer_item_free (LocalXferItem *item)
+{
+    g_free (item->src);
+    g_free (item->dest);
+    g_free (item);
+}
+
+
+inline gboolean local_xfer_aborted (LocalXfer *xfer)
+{
+    return g_atomic_int_get (&xfer->data->aborted) || g_atomic_int_get (&xfer->stopped);
+}
+
+
+// Holds the calling thread while the transfer is paused in the job list
+inline void local_xfer_wait_while_paused (LocalXfer *xfer)
+{
+    while (g_atomic_int_get (&xfer->data->paused) && !local_xfer_aborted (xfer))
+        g_usleep (LOCAL_XFER_REPORT_INTERVAL);
+}
+
+
+inline void local_xfer_add_bytes (LocalXfer *xfer, GnomeVFSFileSize bytes)
+{
+    g_mutex_lock (&xfer->progress_lock);
+    xfer->total_bytes_copied += bytes;
+    g_mutex_unlock (&xfer->progress_lock);
+}
+
+
+static gboolean on_local_xfer_report (LocalXfer *xfer)
+{
+    gint reply = async_xfer_callback (NULL, &xfer->info, xfer->data);
+
+    g_mutex_lock (&xfer->reply_lock);
+    xfer->reply = reply;
+    xfer->replied = TRUE;
+    g_cond_signal (&xfer->replied_cond);
+    g_mutex_unlock (&xfer->reply_lock);
+
+    return FALSE;
+}
+
+
+// Needs xfer->report_lock, returns the reply of async_xfer_callback ()
+static gint local_xfer_report_locked (LocalXfer *xfer, LocalXferItem *item)
+{
+    g_mutex_lock (&xfer->progress_lock);
+    xfer->info.file_index = xfer->file_index;
+    xfer->info.total_bytes_copied = xfer->total_bytes_copied;
+    g_mutex_unlock (&xfer->progress_lock);
+
+    xfer->info.source_name = gnome_vfs_get_uri_from_local_path (item->src);
+    xfer->info.target_name = gnome_vfs_get_uri_from_local_path (item->dest);
+    xfer->info.file_size = S_ISREG (item->st.st_mode) ? item->st.st_size : 0;
+    xfer->info.bytes_copied = item->bytes_copied;
+
+    g_mutex_lock (&xfer->reply_lock);
+    xfer->replied = FALSE;
+    g_idle_add ((GSourceFunc) on_local_xfer_report, xfer);
+    while (!xfer->replied)
+        g_cond_wait (&xfer->replied_cond, &xfer->reply_lock);
+    g_mutex_unlock (&xfer->reply_lock);
+
+    g_free (xfer->info.source_name);
+    g_free (xfer->info.target_name);
+    xfer->info.source_name = NULL;
+    xfer->info.target_name = NULL;
+    xfer->last_report = g_get_monotonic_time ();
+
+    return xfer->reply;
+}
+
+
+static gint local_xfer_report (LocalXfer *xfer, LocalXferItem *item, GnomeVFSXferProgressStatus status, GnomeVFSResult vfs_status)
+{
+    g_mutex_lock (&xfer->report_lock);
+
+    xfer->info.status = status;
+    xfer->info.vfs_status = vfs_status;
+
+    gint reply = local_xfer_report_locked (xfer, item);
+
+    xfer->info.status = GNOME_VFS_XFER_PROGRESS_STATUS_OK;
+    xfer->info.vfs_status = GNOME_VFS_OK;
+
+    g_mutex_unlock (&xfer->report_lock);
+
+    return reply;
+}
+
+
+// Skipped while another thread is reporting, the next piece of progress will do
+static void local_xfer_report_progress (LocalXfer *xfer, LocalXferItem *item)
+{
+    if (!g_mutex_trylock (&xfer->report_lock))
+        return;
+
+    if (g_get_monotonic_time () - xfer->last_report >= LOCAL_XFER_REPORT_INTERVAL)
+        local_xfer_report_locked (xfer, item);
+
+    g_mutex_unlock (&xfer->report_lock);
+}
+
+
+// Asks what to do about @a result, TRUE to retry. The whole transfer is stopped if aborted.
+static gboolean local_xfer_retry (LocalXfer *xfer, LocalXferItem *item, GnomeVFSResult result)
+{
+    if (local_xfer_aborted (xfer))
+        return FALSE;
+
+    DEBUG ('x', "Native transfer of %s failed: %s\n", item->src, gnome_vfs_result_to_string (result));
+
+    switch (local_xfer_report (xfer, item, GNOME_VFS_XFER_PROGRESS_STATUS_VFSERROR, result))
+    {
+        case GNOME_VFS_XFER_ERROR_ACTION_RETRY:
+            return TRUE;
+
+        case GNOME_VFS_XFER_ERROR_ACTION_SKIP:
+            return FALSE;
+
+        default:
+            g_atomic_int_set (&xfer->stopped, TRUE);
+            return FALSE;
+    }
+}
+
+
+enum LocalTarget
+{
+    LOCAL_TARGET_FREE,
+    LOCAL_TARGET_MERGE,           // an existing dir, the source dir is copied into it
+    LOCAL_TARGET_RESUME,          // a file partly copied before, continued from item->resume_offset
+    LOCAL_TARGET_SKIP
+};
+
+
+// Clears the way to the target of @a item, asking about existing files the way GnomeVFS does
+static LocalTarget local_xfer_check_target (LocalXfer *xfer, LocalXferItem *item)
+{
+    for (;;)
+    {
+        struct stat dest_st;
+
+        if (lstat (item->dest, &dest_st) != 0)
+            return LOCAL_TARGET_FREE;
+
+        // the target of a cancelled or failed copy isn't asked about, it's what has been asked for
+        if (xfer->checkpoints && S_ISREG (item->st.st_mode) && S_ISREG (dest_st.st_mode))
+        {
+            item->resume_offset = xfer_journal_lookup (item->src, &item->st, item->dest, &dest_st);
+
+            if (item->resume_offset > 0 && item->resume_offset <= (GnomeVFSFileSize) dest_st.st_size)
+                return LOCAL_TARGET_RESUME;
+
+            item->resume_offset = 0;
+        }
+
+        GnomeVFSResult error = GNOME_VFS_ERROR_FILE_EXISTS;
+        gboolean replace = FALSE;
+
+        // the source itself is never replaced, it would be truncated before it's read
+        if (dest_st.st_dev != item->st.st_dev || dest_st.st_ino != item->st.st_ino)
+            switch (xfer->overwrite_mode)
+            {
+                case GNOME_VFS_XFER_OVERWRITE_MODE_QUERY:
+                    switch (local_xfer_report (xfer, item, GNOME_VFS_XFER_PROGRESS_STATUS_OVERWRITE, GNOME_VFS_OK))
+                    {
+                        case GNOME_VFS_XFER_OVERWRITE_ACTION_REPLACE_ALL:
+                            xfer->overwrite_mode = GNOME_VFS_XFER_OVERWRITE_MODE_REPLACE;
+                            // fall through
+                        case GNOME_VFS_XFER_OVERWRITE_ACTION_REPLACE:
+                            replace = TRUE;
+                            break;
+
+                        case GNOME_VFS_XFER_OVERWRITE_ACTION_SKIP_ALL:
+                            xfer->overwrite_mode = GNOME_VFS_XFER_OVERWRITE_MODE_SKIP;
+                            // fall through
+                        case GNOME_VFS_XFER_OVERWRITE_ACTION_SKIP:
+                            return LOCAL_TARGET_SKIP;
+
+                        default:
+                            g_atomic_int_set (&xfer->stopped, TRUE);
+                            return LOCAL_TARGET_SKIP;
+                    }
+                    break;
+
+                case GNOME_VFS_XFER_OVERWRITE_MODE_REPLACE:
+                    replace = TRUE;
+                    break;
+
+                case GNOME_VFS_XFER_OVERWRITE_MODE_SKIP:
+                    return LOCAL_TARGET_SKIP;
+
+                default:
+                    break;
+            }
+
+        if (replace)
+        {
+            if (S_ISDIR (dest_st.st_mode) && S_ISDIR (item->st.st_mode))
+                return LOCAL_TARGET_MERGE;
+
+            // whole trees aren't removed to make room for a file
+            if (S_ISDIR (dest_st.st_mode))
+                error = GNOME_VFS_ERROR_IS_DIRECTORY;
+            else
+                if (unlink (item->dest) == 0)
+                    return LOCAL_TARGET_FREE;
+                else
+                    error = gnome_vfs_result_from_errno ();
+        }
+
+        if (!local_xfer_retry (xfer, item, error))
+            return LOCAL_TARGET_SKIP;
+    }
+}
+
+
+// Only what has reached the disk is recorded, it's all that's left after a crash or a dropped connection
+static gboolean local_xfer_record_checkpoint (LocalXferItem *item, GnomeVFSFileSize offset)
+{
+    struct stat dest_st;
+
+    if (fdatasync (item->dest_fd) != 0 || fstat (item->dest_fd, &dest_st) != 0)
+        return FALSE;
+
+    xfer_journal_record (item->src, &item->st, item->dest, &dest_st, offset);
+
+    return TRUE;
+}
+
+
+static void local_xfer_checkpoint (LocalXferItem *item)
+{
+    if (local_xfer_record_checkpoint (item, item->bytes_copied))
+        item->checkpoint = item->bytes_copied;
+}
+
+
+static gboolean on_local_copy_progress (GnomeVFSFileSize bytes_copied, LocalXferItem *item)
+{
+    bytes_copied += item->resume_offset;
+
+    local_xfer_add_bytes (item->xfer, bytes_copied - item->bytes_copied);
+    item->bytes_copied = bytes_copied;
+
+    if (item->xfer->checkpoints && item->bytes_copied - item->checkpoint >= LOCAL_XFER_CHECKPOINT_SIZE && item->bytes_copied < (GnomeVFSFileSize) item->st.st_size)
+        local_xfer_checkpoint (item);
+
+    local_xfer_report_progress (item->xfer, item);
+    local_xfer_wait_while_paused (item->xfer);
+
+    return !local_xfer_aborted (item->xfer);
+}
+
+
+static gboolean on_local_verify_progress (GnomeVFSFileSize bytes_compared, LocalXferItem *item)
+{
+    local_xfer_report_progress (item->xfer, item);
+    local_xfer_wait_while_paused (item->xfer);
+
+    return !local_xfer_aborted (item->xfer);
+}
+
+
+// Prepares the continuation of a partial target at item->resume_offset, or at 0 if the part copied before differs
+static GnomeVFSResult local_xfer_resume (LocalXfer *xfer, LocalXferItem *item, int src_fd, int dest_fd)
+{
+    // the target is kept if anything goes wrong from here
+    item->checkpoint = item->resume_offset;
+
+    if (xfer->verify)
+    {
+        GnomeVFSResult result = localcopy_verify (src_fd, dest_fd, item->resume_offset,
+                                                  (LocalCopyProgressFunc) on_local_verify_progress, item);
+
+        if (result == GNOME_VFS_ERROR_CORRUPTED_DATA)
+        {
+            DEBUG ('x', "The part of %s copied before differs, copying it again\n", item->dest);
+            xfer_journal_remove (item->dest);
+            item->resume_offset = item->checkpoint = 0;
+        }
+        else
+            if (result != GNOME_VFS_OK)
+                return result;
+    }
+
+    // whatever has been written after the checkpoint may not have reached the disk
+    if (ftruncate (dest_fd, item->resume_offset) != 0 ||
+        lseek (src_fd, item->resume_offset, SEEK_SET) < 0 ||
+        lseek (dest_fd, item->resume_offset, SEEK_SET) < 0)
+        return gnome_vfs_result_from_errno ();
+
+    g_mutex_lock (&xfer->progress_lock);
+    xfer->total_bytes_copied = xfer->total_bytes_copied - item->bytes_copied + item->resume_offset;
+    g_mutex_unlock (&xfer->progress_lock);
+    item->bytes_copied = item->resume_offset;
+
+    DEBUG ('x', "Resuming the copy of %s at %" G_GUINT64_FORMAT "\n", item->src, (guint64) item->resume_offset);
+
+    return GNOME_VFS_OK;
+}
+
+
+static void local_xfer_copy_data (LocalXfer *xfer, LocalXferItem *item)
+{
+    for (;;)
+    {
+        int src_fd;
+        int dest_fd;
+
+        while ((src_fd = open (item->src, O_RDONLY | O_CLOEXEC)) < 0)
+            if (!local_xfer_retry (xfer, item, gnome_vfs_result_from_errno ()))
+                return;
+
+        // a resumed target may be read to verify it, any other has been removed by local_xfer_check_target (), a reflink needs a new file anyway
+        int flags = item->resume_offset > 0 ? O_RDWR | O_CLOEXEC : O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC;
+
+        while ((dest_fd = open (item->dest, flags, 0600)) < 0)
+            if (!local_xfer_retry (xfer, item, gnome_vfs_result_from_errno ()))
+            {
+                close (src_fd);
+                return;
+            }
+
+        LocalCopyMethod method = LOCALCOPY_BUFFER;
+        GnomeVFSResult result = item->resume_offset > 0 ? local_xfer_resume (xfer, item, src_fd, dest_fd) : GNOME_VFS_OK;
+
+        item->dest_fd = dest_fd;
+
+        if (result == GNOME_VFS_OK)
+            result = localcopy_data (src_fd, dest_fd, item->st.st_size - item->resume_offset,
+                                     (LocalCopyProgressFunc) on_local_copy_progress, item, &method);
+
+        if (result == GNOME_VFS_OK)
+            localcopy_set_attributes (dest_fd, &item->st);
+
+        close (src_fd);
+
+        // NFS and CIFS report write errors on close
+        if (close (dest_fd) != 0 && result == GNOME_VFS_OK)
+            result = gnome_vfs_result_from_errno ();
+
+        if (result == GNOME_VFS_OK)
+        {
+            if (item->checkpoint > 0)
+                xfer_journal_remove (item->dest);
+
+            DEBUG ('x', "Copied %s natively, method %d\n", item->src, method);
+            return;
+        }
+
+        // a checkpointed target is kept for the retry, or for copying it again later
+        if (item->checkpoint == 0)
+            unlink (item->dest);
+
+        g_mutex_lock (&xfer->progress_lock);
+        xfer->total_bytes_copied = xfer->total_bytes_copied - item->bytes_copied + item->checkpoint;
+        g_mutex_unlock (&xfer->progress_lock);
+        item->bytes_copied = item->checkpoint;
+        item->resume_offset = item->checkpoint;
+
+        if (result == GNOME_VFS_ERROR_INTERRUPTED || !local_xfer_retry (xfer, item, result))
+            return;
+    }
+}
+
+
+// Runs on the workers of xfer->pool
+static void local_xfer_copy_file (LocalXferItem *item, LocalXfer *xfer)
+{
+    if (!local_xfer_aborted (xfer))
+        local_xfer_copy_data (xfer, item);
+
+    g_mutex_lock (&xfer->progress_lock);
+    // skipped and failed files count as done, so that the total progress reaches the end
+    xfer->total_bytes_copied += item->st.st_size - item->bytes_copied;
+    g_mutex_unlock (&xfer->progress_lock);
+
+    local_xfer_item_free (item);
+}
+
+
+static void local_xfer_copy_item (LocalXfer *xfer, gchar *src, gchar *dest);
+
+
+static void local_xfer_copy_dir (LocalXfer *xfer, LocalXferItem *item, gboolean merge)
+{
+    GDir *dir = NULL;
+
+    while (!merge && mkdir (item->dest, 0700) != 0)
+        if (!local_xfer_retry (xfer, item, gnome_vfs_result_from_errno ()))
+        {
+            local_xfer_item_free (item);
+            return;
+        }
+
+    // the permissions of a created dir are set last, it may not be writable
+    if (!merge)
+        xfer->created_dirs = g_list_prepend (xfer->created_dirs, item);
+
+    while (!(dir = g_dir_open (item->src, 0, NULL)))
+        if (!local_xfer_retry (xfer, item, gnome_vfs_result_from_errno ()))
+            break;
+
+    for (const gchar *name; dir && !local_xfer_aborted (xfer) && (name = g_dir_read_name (dir)); )
+        local_xfer_copy_item (xfer, g_build_filename (item->src, name, NULL), g_build_filename (item->dest, name, NULL));
+
+    if (dir)
+        g_dir_close (dir);
+
+    if (merge)
+        local_xfer_item_free (item);
+}
+
+
+// Runs on the walker, takes @a src and @a dest
+static void local_xfer_copy_item (LocalXfer *xfer, gchar *src, gchar *dest)
+{
+    local_xfer_wait_while_paused (xfer);
+
+    LocalXferItem *item = g_new0 (LocalXferItem, 1);
+
+    item->xfer = xfer;
+    item->src = src;
+    item->dest = dest;
+
+    g_mutex_lock (&xfer->progress_lock);
+    xfer->file_index++;
+    g_mutex_unlock (&xfer->progress_lock);
+
+    while ((xfer->follow_links ? stat (src, &item->st) : lstat (src, &item->st)) != 0)
+        if (!local_xfer_retry (xfer, item, gnome_vfs_result_from_errno ()))
+        {
+            local_xfer_item_free (item);
+            return;
+        }
+
+    local_xfer_report_progress (xfer, item);
+
+    LocalTarget target = local_xfer_check_target (xfer, item);
+
+    if (target == LOCAL_TARGET_SKIP)
+    {
+        if (S_ISREG (item->st.st_mode))
+            local_xfer_add_bytes (xfer, item->st.st_size);
+
+        local_xfer_item_free (item);
+        return;
+    }
+
+    if (S_ISREG (item->st.st_mode))
+    {
+        // dirs are created in order by the walker, only the data is copied concurrently
+        localcopy_pool_push (xfer->pool, item);
+        return;
+    }
+
+    if (S_ISDIR (item->st.st_mode))
+    {
+        local_xfer_copy_dir (xfer, item, target == LOCAL_TARGET_MERGE);
+        return;
+    }
+
+    if (S_ISLNK (item->st.st_mode))
+    {
+        gchar *link_target;
+
+        while (!(link_target = g_file_read_link (src, NULL)))
+            if (!local_xfer_retry (xfer, item, gnome_vfs_result_from_errno ()))
+                break;
+
+        while (link_target && symlink (link_target, dest) != 0)
+            if (!local_xfer_retry (xfer, item, gnome_vfs_result_from_errno ()))
+                break;
+
+        g_free (link_target);
+    }
+    else
+        local_xfer_retry (xfer, item, GNOME_VFS_ERROR_NOT_SUPPORTED);       // devices, fifos and sockets, GnomeVFS doesn't copy them either
+
+    local_xfer_item_free (item);
+}
+
+
+static void local_xfer_count (LocalXfer *xfer, const gchar *path)
+{
+    struct stat st;
+
+    if (local_xfer_aborted (xfer) || (xfer->follow_links ? stat (path, &st) : lstat (path, &st)) != 0)
+        return;
+
+    xfer->info.files_total++;
+
+    if (S_ISREG (st.st_mode))
+        xfer->info.bytes_total += st.st_size;
+
+    if (!S_ISDIR (st.st_mode))
+        return;
+
+    GDir *dir = g_dir_open (path, 0, NULL);
+
+    for (const gchar *name; dir && (name = g_dir_read_name (dir)); )
+    {
+        gchar *child = g_build_filename (path, name, NULL);
+        local_xfer_count (xfer, child);
+        g_free (child);
+    }
+
+    if (dir)
+        g_dir_close (dir);
+}
+
+
+// Like rename (), but fails with EEXIST instead of replacing @a dest
+static int rename_noreplace (const gchar *src, const gchar *dest)
+{
+#ifdef HAVE_RENAMEAT2
+    if (renameat2 (AT_FDCWD, src, AT_FDCWD, dest, RENAME_NOREPLACE) == 0)
+        return 0;
+
+    // not supported by the kernel or the file system
+    if (errno != EINVAL && errno != ENOSYS)
+        return -1;
+#endif
+
+    struct stat st;
+
+    if (lstat (dest, &st) == 0)
+    {
+        errno = EEXIST;
+        return -1;
+    }
+
+    return rename (src, dest);
+}
+
+
+// Runs on the walker, @a index is the position of @a src in xfer->src_paths
+static void local_xfer_move_item (LocalXfer *xfer, const gchar *src, const gchar *dest, gint index)
+{
+    local_xfer_wait_while_paused (xfer);
+
+    LocalXferItem *item = g_new0 (LocalXferItem, 1);
+
+    item->xfer = xfer;
+    item->src = g_strdup (src);
+    item->dest = g_strdup (dest);
+
+    g_mutex_lock (&xfer->progress_lock);
+    xfer->file_index++;
+    g_mutex_unlock (&xfer->progress_lock);
+
+    while (lstat (src, &item->st) != 0)
+        if (!local_xfer_retry (xfer, item, gnome_vfs_result_from_errno ()))
+        {
+            local_xfer_item_free (item);
+            return;
+        }
+
+    gboolean renamed = FALSE;
+    gboolean fall_back = item->st.st_dev != xfer->dest_dev;
+
+    if (!fall_back)
+        local_xfer_report_progress (xfer, item);
+
+    // the target is only looked at once it's known to be in the way
+    while (!renamed && !fall_back)
+    {
+        if (rename_noreplace (src, dest) == 0)
+            renamed = TRUE;
+        else
+            if (errno == EXDEV)
+                fall_back = TRUE;
+            else
+                if (errno != EEXIST)
+                {
+                    if (!local_xfer_retry (xfer, item, gnome_vfs_result_from_errno ()))
+                        break;
+                }
+                else
+                    switch (local_xfer_check_target (xfer, item))
+                    {
+                        case LOCAL_TARGET_MERGE:
+                            fall_back = TRUE;
+                            break;
+
+                        case LOCAL_TARGET_SKIP:
+                            local_xfer_item_free (item);
+                            return;
+
+                        default:
+                            break;
+                    }
+    }
+
+    if (fall_back)
+        xfer->fallback = g_list_prepend (xfer->fallback, GINT_TO_POINTER (index));
+
+    local_xfer_item_free (item);
+}
+
+
+static void local_xfer_move_all (LocalXfer *xfer)
+{
+    xfer->info.files_total = g_list_length (xfer->src_paths);
+    xfer->info.phase = GNOME_VFS_XFER_PHASE_COPYING;
+
+    gint index = 0;
+
+    for (GList *i = xfer->src_paths, *j = xfer->dest_paths; i && j && !local_xfer_aborted (xfer); i = i->next, j = j->next, ++index)
+        local_xfer_move_item (xfer, (const gchar *) i->data, (const gchar *) j->data, index);
+
+    xfer->fallback = g_list_reverse (xfer->fallback);
+}
+
+
+// Hands the moves that couldn't be done by renaming over to GnomeVFS, which reports their completion
+static void local_xfer_fall_back (LocalXfer *xfer)
+{
+    XferData *data = xfer->data;
+    GList *src_uri_list = NULL;
+    GList *dest_uri_list = NULL;
+    GList *f = xfer->fallback;
+    gint index = 0;
+
+    for (GList *i = data->src_uri_list, *j = data->dest_uri_list; i && j && f; i = i->next, j = j->next, ++index)
+        if (GPOINTER_TO_INT (f->data) == index)
+        {
+            src_uri_list = g_list_prepend (src_uri_list, i->data);
+            dest_uri_list = g_list_prepend (dest_uri_list, gnome_vfs_uri_ref ((GnomeVFSURI *) j->data));
+            f = f->next;
+        }
+
+    DEBUG ('x', "Moving %u of %u files with GnomeVFS\n", g_list_length (src_uri_list), g_list_length (data->src_uri_list));
+
+    g_list_free (data->src_uri_list);
+    g_list_foreach (data->dest_uri_list, (GFunc) gnome_vfs_uri_unref, NULL);
+    g_list_free (data->dest_uri_list);
+
+    data->src_uri_list = g_list_reverse (src_uri_list);
+    data->dest_uri_list = g_list_reverse (dest_uri_list);
+
+    calc_move_totals (data);
+
+    // the answers given so far, Replace All and Skip All, still hold
+    gnome_vfs_async_xfer (&data->handle, data->src_uri_list, data->dest_uri_list,
+                          data->xferOptions, GNOME_VFS_XFER_ERROR_MODE_QUERY, xfer->overwrite_mode,
+                          XFER_PRIORITY,
+                          (GnomeVFSAsyncXferProgressCallback) async_xfer_callback, data,
+                          NULL, NULL);
+}
+
+
+static gboolean on_local_xfer_finished (LocalXfer *xfer)
+{
+    if (xfer->fallback && !local_xfer_aborted (xfer))
+        local_xfer_fall_back (xfer);
+    else
+        async_xfer_callback (NULL, &xfer->info, xfer->data);
+
+    g_list_free (xfer->fallback);
+    g_list_foreach (xfer->src_paths, (GFunc) g_free, NULL);
+    g_list_free (xfer->src_paths);
+    g_list_foreach (xfer->dest_paths, (GFunc) g_free, NULL);
+    g_list_free (xfer->dest_paths);
+    g_mutex_clear (&xfer->progress_lock);
+    g_mutex_clear (&xfer->report_lock);
+    g_mutex_clear (&xfer->reply_lock);
+    g_cond_clear (&xfer->replied_cond);
+    g_free (xfer);
+
+    return FALSE;
+}
+
+
+static void local_xfer_copy_all (LocalXfer *xfer)
+{
+    xfer->info.phase = GNOME_VFS_XFER_PHASE_COLLECTING;
+
+    for (GList *i = xfer->src_paths; i; i = i->next)
+        local_xfer_count (xfer, (const gchar *) i->data);
+
+    xfer->info.phase = GNOME_VFS_XFER_PHASE_COPYING;
+    xfer->pool = localcopy_pool_new ((GFunc) local_xfer_copy_file, xfer, xfer->workers);
+
+    for (GList *i = xfer->src_paths, *j = xfer->dest_paths; i && j && !local_xfer_aborted (xfer); i = i->next, j = j->next)
+        local_xfer_copy_item (xfer, g_strdup ((const gchar *) i->data), g_strdup ((const gchar *) j->data));
+
+    localcopy_pool_free (xfer->pool);
+
+    // the deepest dirs come first, a parent made unsearchable would hide them
+    for (GList *i = xfer->created_dirs; i; i = i->next)
+    {
+        LocalXferItem *item = (LocalXferItem *) i->data;
+        struct timespec times[2] = {item->st.st_atim, item->st.st_mtim};
+
+        chmod (item->dest, item->st.st_mode & 07777);
+        utimensat (AT_FDCWD, item->dest, times, 0);
+        local_xfer_item_free (item);
+    }
+
+    g_list_free (xfer->created_dirs);
+}
+
+
+// The walker
+static gpointer local_xfer_thread (LocalXfer *xfer)
+{
+    if (xfer->move)
+        local_xfer_move_all (xfer);
+    else
+        local_xfer_copy_all (xfer);
+
+    xfer->info.file_index = xfer->file_index;
+    xfer->info.total_bytes_copied = xfer->total_bytes_copied;
+    xfer->info.phase = GNOME_VFS_XFER_PHASE_COMPLETED;
+
+    // the last report isn't waited for, xfer->data is freed in the main loop once it has been seen
+    g_idle_add ((GSourceFunc) on_local_xfer_finished, xfer);
+
+    return NULL;
+}
+
+
+inline gboolean uri_is_file (GnomeVFSURI *uri)
+{
+    return g_strcmp0 (gnome_vfs_uri_get_scheme (uri), "file") == 0;
+}
+
+
+inline gchar *uri_to_local_path (GnomeVFSURI *uri)
+{
+    gchar *uri_str = gnome_vfs_uri_to_string (uri, GNOME_VFS_URI_HIDE_NONE);
+    gchar *path = gnome_vfs_get_local_path_from_uri (uri_str);
+
+    g_free (uri_str);
+
+    return path;
+}
+
+
+// The device of the dir @a uri is in, FALSE if it can't be determined
+static gboolean get_parent_dev (GnomeVFSURI *uri, dev_t *dev)
+{
+    gchar *path = uri_to_local_path (uri);
+    gchar *parent = path ? g_path_get_dirname (path) : NULL;
+    struct stat st;
+
+    gboolean ok = parent && stat (parent, &st) == 0;
+
+    if (ok)
+        *dev = st.st_dev;
+
+    g_free (parent);
+    g_free (path);
+
+    return ok;
+}
+
+
+// TRUE if the first file of a move is on the file system it's moved to
+static gboolean is_move_within_fs (XferData *data)
+{
+    gchar *path = uri_to_local_path ((GnomeVFSURI *) data->src_uri_list->data);
+    struct stat st;
+    dev_t dest_dev;
+
+    gboolean ret = path && lstat (path, &st) == 0 &&
+                   get_parent_dev ((GnomeVFSURI *) data->dest_uri_list->data, &dest_dev) && st.st_dev == dest_dev;
+
+    g_free (path);
+
+    return ret;
+}
+
+
+// Plain recursive copies between local dirs and moves within a local file system, everything else is left to GnomeVFS
+static gboolean can_xfer_locally (XferData *data)
+{
+    if (!gnome_cmd_data.native_local_copy)
+        return FALSE;
+
+    gboolean move = data->xferOptions == GNOME_VFS_XFER_REMOVESOURCE;
+
+    if (!move && (!(data->xferOptions & GNOME_VFS_XFER_RECURSIVE) || (data->xferOptions & ~(GNOME_VFS_XFER_RECURSIVE | GNOME_VFS_XFER_FOLLOW_LINKS))))
+        return FALSE;
+
+    for (GList *i = data->src_uri_list; i; i = i->next)
+        if (!uri_is_file ((GnomeVFSURI *) i->data))
+            return FALSE;
+
+    for (GList *i = data->dest_uri_list; i; i = i->next)
+        if (!uri_is_file ((GnomeVFSURI *) i->data))
+            return FALSE;
+
+    // moves across file systems are copies followed by deletes, GnomeVFS does them
+    return !move || is_move_within_fs (data);
+}
+
+
+static void start_local_xfer (XferData *data, GnomeVFSXferOverwriteMode xferOverwriteMode)
+{
+    LocalXfer *xfer = g_new0 (LocalXfer, 1);
+
+    xfer->data = data;
+    xfer->follow_links = (data->xferOptions & GNOME_VFS_XFER_FOLLOW_LINKS) != 0;
+    xfer->move = (data->xferOptions & GNOME_VFS_XFER_REMOVESOURCE) != 0;
+    xfer->checkpoints = !xfer->move && gnome_cmd_data.checkpointed_xfers;
+    xfer->verify = gnome_cmd_data.verify_resumed_xfers;
+    xfer->overwrite_mode = xferOverwriteMode;
+    xfer->workers = gnome_cmd_data.copy_workers;
+    xfer->info.status = GNOME_VFS_XFER_PROGRESS_STATUS_OK;
+    xfer->info.vfs_status = GNOME_VFS_OK;
+    g_mutex_init (&xfer->progress_lock);
+    g_mutex_init (&xfer->report_lock);
+    g_mutex_init (&xfer->reply_lock);
+    g_cond_init (&xfer->replied_cond);
+
+    for (GList *i = data->src_uri_list; i; i = i->next)
+        xfer->src_paths = g_list_append (xfer->src_paths, uri_to_local_path ((GnomeVFSURI *) i->data));
+
+    for (GList *i = data->dest_uri_list; i; i = i->next)
+        xfer->dest_paths = g_list_append (xfer->dest_paths, uri_to_local_path ((GnomeVFSURI *) i->data));
+
+    // everything falls back to GnomeVFS if the target dir has gone
+    if (xfer->move && !get_parent_dev ((GnomeVFSURI *) data->dest_uri_list->data, &xfer->dest_dev))
+        xfer->dest_dev = (dev_t) -1;
+
+    g_thread_unref (g_thread_new ("gcmd-local-xfer", (GThreadFunc) local_xfer_thread, xfer));
+}
+
+
 inline gboolean uri_is_parent_to_dir_or_equal (GnomeVFSURI *uri, GnomeCmdDir *dir)
 {
     GnomeVFSURI *dir_uri = GNOME_CMD_FILE (dir)->get_uri ();
@@ -400,6 +1328,89 @@ inline gboolean file_is_already_in_dir (GnomeVFSURI *uri, GnomeCmdDir *dir)
 }
 
 
+/***********************************
+ * Queued transfers
+ ***********************************/
+
+static gchar *create_job_title (XferData *data)
+{
+    gboolean move = (data->xferOptions & GNOME_VFS_XFER_REMOVESOURCE) != 0;
+    guint n = g_list_length (data->src_uri_list);
+    gchar *dest = gnome_cmd_dir_get_display_path (data->to_dir);
+    gchar *title;
+
+    if (n == 1)
+    {
+        gchar *name = gnome_vfs_uri_extract_short_name ((GnomeVFSURI *) data->src_uri_list->data);
+        gchar *fn = gnome_vfs_unescape_string (name, NULL);
+        gchar *utf8_fn = get_utf8 (fn);
+
+        title = g_strdup_printf (move ? _("Moving “%s” to %s") : _("Copying “%s” to %s"), utf8_fn, dest);
+
+        g_free (utf8_fn);
+        g_free (fn);
+        g_free (name);
+    }
+    else
+        title = g_strdup_printf (move ? ngettext ("Moving %u file to %s", "Moving %u files to %s", n) :
+                                        ngettext ("Copying %u file to %s", "Copying %u files to %s", n), n, dest);
+
+    g_free (dest);
+
+    return title;
+}
+
+
+static void start_xfer (XferData *data)
+{
+    data->win = GNOME_CMD_XFER_PROGRESS_WIN (gnome_cmd_xfer_progress_win_new (g_list_length (data->src_uri_list)));
+    gtk_widget_ref (GTK_WIDGET (data->win));
+    gtk_window_set_title (GTK_WINDOW (data->win), _("preparing…"));
+    gtk_widget_show (GTK_WIDGET (data->win));
+
+    //  start the transfer
+    if (can_xfer_locally (data))
+        start_local_xfer (data, data->xferOverwriteMode);
+    else
+    {
+        calc_move_totals (data);
+        gnome_vfs_async_xfer (&data->handle, data->src_uri_list, data->dest_uri_list,
+                              data->xferOptions, GNOME_VFS_XFER_ERROR_MODE_QUERY, data->xferOverwriteMode,
+                              XFER_PRIORITY,
+                              (GnomeVFSAsyncXferProgressCallback) async_xfer_callback, data,
+                              NULL, NULL);
+    }
+
+    g_timeout_add (gnome_cmd_data.gui_update_rate, (GSourceFunc) update_xfer_gui_func, data);
+}
+
+
+static void pause_xfer (gboolean paused, XferData *data)
+{
+    g_atomic_int_set (&data->paused, paused);
+
+    if (paused)
+        gnome_cmd_xfer_progress_win_set_action (data->win, _("paused"));
+    else
+        data->prev_phase = (GnomeVFSXferPhase) -1;      // for update_xfer_gui_func () to restore the title
+}
+
+
+// A running transfer is stopped as if its own cancel button was pressed, a queued one is just dropped
+static void cancel_xfer (XferData *data)
+{
+    if (data->win)
+    {
+        data->win->cancel_pressed = TRUE;
+        return;
+    }
+
+    gnome_cmd_dir_unref (data->to_dir);
+    data->to_dir = NULL;
+    free_xfer_data (data);
+}
+
+
 void
 gnome_cmd_xfer_uris_start (GList *src_uri_list,
                            GnomeCmdDir *to_dir,
@@ -461,19 +1472,26 @@ gnome_cmd_xfer_uris_start (GList *src_uri_list,
 
     g_free (dest_fn);
 
-    data->win = GNOME_CMD_XFER_PROGRESS_WIN (gnome_cmd_xfer_progress_win_new (num_files));
-    gtk_widget_ref (GTK_WIDGET (data->win));
-    gtk_window_set_title (GTK_WINDOW (data->win), _("preparing…"));
-    gtk_widget_show (GTK_WIDGET (data->win));
+    data->xferOverwriteMode = xferOverwriteMode;
 
-    //  start the transfer
-    gnome_vfs_async_xfer (&data->handle, data->src_uri_list, data->dest_uri_list,
-                          xferOptions, GNOME_VFS_XFER_ERROR_MODE_QUERY, xferOverwriteMode,
-                          XFER_PRIORITY,
-                          (GnomeVFSAsyncXferProgressCallback) async_xfer_callback, data,
-                          NULL, NULL);
+    // renames are done in an instant, they don't wait for the device
+    if (xferOptions == GNOME_VFS_XFER_REMOVESOURCE && can_xfer_locally (data))
+    {
+        start_xfer (data);
+        return;
+    }
 
-    g_timeout_add (gnome_cmd_data.gui_update_rate, (GSourceFunc) update_xfer_gui_func, data);
+    gchar *title = create_job_title (data);
+    GnomeVFSURI *to_uri = GNOME_CMD_FILE (to_dir)->get_uri();
+
+    // started once its devices are known, unless other transfers keep them busy
+    data->job = gnome_cmd_xfer_manager_add (title, data->src_uri_list, to_uri,
+                                            (GnomeCmdXferJobFunc) start_xfer,
+                                            can_xfer_locally (data) ? (GnomeCmdXferJobPauseFunc) pause_xfer : NULL,
+                                            (GnomeCmdXferJobFunc) cancel_xfer,
+                                            data);
+    gnome_vfs_uri_unref (to_uri);
+    g_free (title);
 }
 
 
@@ -540,6 +1558,7 @@ gnome_cmd_xfer_tmp_download_multiple (GList *src_uri_list,
     data = create_xfer_data (xferOptions, src_uri_list, dest_uri_list,
                              NULL, NULL, NULL,
                              (GFunc) on_completed_func, on_completed_data);
+    calc_move_totals (data);
 
     data->win = GNOME_CMD_XFER_PROGRESS_WIN (gnome_cmd_xfer_progress_win_new (g_list_length (src_uri_list)));
     gtk_window_set_title (GTK_WINDOW (data->win), _("downloading to /tmp"));
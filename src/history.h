@@ -53,6 +53,10 @@ class History
     const gchar *forward();
     const gchar *last();
 
+    // the entries back() and forward() would go to, without moving there
+    const gchar *peek_back()        {  return can_back() ? (const gchar *) pos->next->data : NULL;     }
+    const gchar *peek_forward()     {  return can_forward() ? (const gchar *) pos->prev->data : NULL;  }
+
     void lock()                                             {  is_locked = TRUE;         }
     void unlock()                                           {  is_locked = FALSE;        }
 
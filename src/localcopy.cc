@@ -0,0 +1,354 @@
+/**
+ * @file localcopy.cc
+ * @copyright (C) 2013-2017 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/sendfile.h>
+#endif
+
+// no GTK and no other gnome-commander code in here, the copy tests and benchmarks link this file alone
+#include "localcopy.h"
+
+using namespace std;
+
+
+#define KERNEL_CHUNK_SIZE (64*1024*1024)    // per copy_file_range or sendfile call, so that cancelling isn't held up
+#define BUFFER_SIZE (1024*1024)
+#define BUFFER_ALIGNMENT 4096
+#define POOL_MAX_QUEUED 256                 // files per worker waiting to be copied
+
+
+// Errors which mean that a method can't be used for this pair of files at all
+inline gboolean is_unsupported (int err)
+{
+    return err == ENOSYS || err == EXDEV || err == EINVAL || err == EOPNOTSUPP || err == ENOTTY || err == EBADF || err == ENOTSUP;
+}
+
+
+// Whether the reflink has worked, in which case there's nothing left to do
+static gboolean reflink (int src_fd, int dest_fd)
+{
+#ifdef FICLONE
+    return ioctl (dest_fd, FICLONE, src_fd) == 0;
+#else
+    return FALSE;
+#endif
+}
+
+
+typedef ssize_t (* KernelCopyFunc) (int src_fd, int dest_fd, size_t len);
+
+
+#ifdef HAVE_COPY_FILE_RANGE
+static ssize_t kernel_copy_file_range (int src_fd, int dest_fd, size_t len)
+{
+    return copy_file_range (src_fd, NULL, dest_fd, NULL, len, 0);
+}
+#endif
+
+
+#ifdef __linux__
+static ssize_t kernel_sendfile (int src_fd, int dest_fd, size_t len)
+{
+    return sendfile (dest_fd, src_fd, NULL, len);
+}
+#endif
+
+
+/**
+ * Copies in the kernel, returns FALSE without copying anything if
+ * @a copy can't be used for the files, so that the next method is tried.
+ */
+static gboolean kernel_copy (KernelCopyFunc copy, int src_fd, int dest_fd,
+                             LocalCopyProgressFunc func, gpointer user_data, GnomeVFSResult *result)
+{
+    GnomeVFSFileSize copied = 0;
+
+    for (;;)
+    {
+        ssize_t n = copy (src_fd, dest_fd, KERNEL_CHUNK_SIZE);
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            if (copied == 0 && is_unsupported (errno))
+                return FALSE;
+
+            *result = gnome_vfs_result_from_errno ();
+            return TRUE;
+        }
+
+        // some pseudo files have a size but can't be copied in the kernel, they are read the ordinary way
+        if (n == 0 && copied == 0)
+            return FALSE;
+
+        if (n == 0)
+            break;
+
+        copied += n;
+
+        if (func && !func (copied, user_data))
+        {
+            *result = GNOME_VFS_ERROR_INTERRUPTED;
+            return TRUE;
+        }
+    }
+
+    *result = GNOME_VFS_OK;
+
+    return TRUE;
+}
+
+
+static GnomeVFSResult buffer_copy (int src_fd, int dest_fd, LocalCopyProgressFunc func, gpointer user_data)
+{
+    gpointer buf;
+
+    if (posix_memalign (&buf, BUFFER_ALIGNMENT, BUFFER_SIZE) != 0)
+        return GNOME_VFS_ERROR_NO_MEMORY;
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise (src_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    GnomeVFSResult result = GNOME_VFS_OK;
+    GnomeVFSFileSize copied = 0;
+
+    for (;;)
+    {
+        ssize_t n = read (src_fd, buf, BUFFER_SIZE);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+
+        if (n <= 0)
+        {
+            if (n < 0)
+                result = gnome_vfs_result_from_errno ();
+            break;
+        }
+
+        for (ssize_t written = 0; written < n; )
+        {
+            ssize_t w = write (dest_fd, (gchar *) buf + written, n - written);
+
+            if (w < 0 && errno == EINTR)
+                continue;
+
+            if (w < 0)
+            {
+                result = gnome_vfs_result_from_errno ();
+                break;
+            }
+
+            written += w;
+        }
+
+        if (result != GNOME_VFS_OK)
+            break;
+
+        copied += n;
+
+        if (func && !func (copied, user_data))
+        {
+            result = GNOME_VFS_ERROR_INTERRUPTED;
+            break;
+        }
+    }
+
+    free (buf);
+
+    return result;
+}
+
+
+GnomeVFSResult localcopy_data (int src_fd, int dest_fd, GnomeVFSFileSize size,
+                               LocalCopyProgressFunc func, gpointer user_data,
+                               LocalCopyMethod *method)
+{
+    GnomeVFSResult result;
+    LocalCopyMethod unused;
+
+    if (!method)
+        method = &unused;
+
+    // pseudo files claim to be empty, and there's nothing to gain for real empty files
+    if (size == 0)
+    {
+        *method = LOCALCOPY_BUFFER;
+        return buffer_copy (src_fd, dest_fd, func, user_data);
+    }
+
+    *method = LOCALCOPY_REFLINK;
+
+    // a reflink always replaces the whole file, it can't continue a resumed one
+    if (lseek (dest_fd, 0, SEEK_CUR) == 0 && reflink (src_fd, dest_fd))
+    {
+        if (func && !func (size, user_data))
+            return GNOME_VFS_ERROR_INTERRUPTED;
+
+        return GNOME_VFS_OK;
+    }
+
+#ifdef HAVE_COPY_FILE_RANGE
+    *method = LOCALCOPY_COPY_FILE_RANGE;
+
+    if (kernel_copy (kernel_copy_file_range, src_fd, dest_fd, func, user_data, &result))
+        return result;
+#endif
+
+#ifdef __linux__
+    *method = LOCALCOPY_SENDFILE;
+
+    if (kernel_copy (kernel_sendfile, src_fd, dest_fd, func, user_data, &result))
+        return result;
+#endif
+
+    *method = LOCALCOPY_BUFFER;
+
+    return buffer_copy (src_fd, dest_fd, func, user_data);
+}
+
+
+GnomeVFSResult localcopy_verify (int src_fd, int dest_fd, GnomeVFSFileSize size,
+                                 LocalCopyProgressFunc func, gpointer user_data)
+{
+    gpointer src_buf;
+    gpointer dest_buf;
+
+    if (posix_memalign (&src_buf, BUFFER_ALIGNMENT, BUFFER_SIZE) != 0)
+        return GNOME_VFS_ERROR_NO_MEMORY;
+
+    if (posix_memalign (&dest_buf, BUFFER_ALIGNMENT, BUFFER_SIZE) != 0)
+    {
+        free (src_buf);
+        return GNOME_VFS_ERROR_NO_MEMORY;
+    }
+
+    GnomeVFSResult result = GNOME_VFS_OK;
+
+    for (GnomeVFSFileSize offset = 0; offset < size && result == GNOME_VFS_OK; )
+    {
+        size_t len = MIN (size - offset, BUFFER_SIZE);
+        ssize_t n_src = pread (src_fd, src_buf, len, offset);
+        ssize_t n_dest = n_src > 0 ? pread (dest_fd, dest_buf, n_src, offset) : 0;
+
+        if ((n_src < 0 || n_dest < 0) && errno == EINTR)
+            continue;
+
+        if (n_src < 0 || n_dest < 0)
+            result = gnome_vfs_result_from_errno ();
+        else
+            // either file being shorter than @a size is a difference too
+            if (n_src == 0 || n_dest != n_src || memcmp (src_buf, dest_buf, n_src) != 0)
+                result = GNOME_VFS_ERROR_CORRUPTED_DATA;
+            else
+            {
+                offset += n_src;
+
+                if (func && !func (offset, user_data))
+                    result = GNOME_VFS_ERROR_INTERRUPTED;
+            }
+    }
+
+    free (src_buf);
+    free (dest_buf);
+
+    return result;
+}
+
+
+void localcopy_set_attributes (int dest_fd, const struct stat *st)
+{
+    struct timespec times[2] = {st->st_atim, st->st_mtim};
+
+    fchmod (dest_fd, st->st_mode & 07777);
+    futimens (dest_fd, times);
+}
+
+
+struct LocalCopyPool
+{
+    GThreadPool *pool;
+    GFunc func;
+    gpointer user_data;
+    guint max_pending;
+
+    GMutex lock;
+    GCond done_cond;
+    guint pending;                          // queued or being copied
+};
+
+
+static void localcopy_pool_run (gpointer file, LocalCopyPool *pool)
+{
+    pool->func (file, pool->user_data);
+
+    g_mutex_lock (&pool->lock);
+    pool->pending--;
+    g_cond_signal (&pool->done_cond);
+    g_mutex_unlock (&pool->lock);
+}
+
+
+LocalCopyPool *localcopy_pool_new (GFunc func, gpointer user_data, guint workers)
+{
+    LocalCopyPool *pool = g_new0 (LocalCopyPool, 1);
+
+    pool->func = func;
+    pool->user_data = user_data;
+    pool->max_pending = MAX (workers, 1) * POOL_MAX_QUEUED;
+    g_mutex_init (&pool->lock);
+    g_cond_init (&pool->done_cond);
+    pool->pool = g_thread_pool_new ((GFunc) localcopy_pool_run, pool, MAX (workers, 1), FALSE, NULL);
+
+    return pool;
+}
+
+
+void localcopy_pool_push (LocalCopyPool *pool, gpointer file)
+{
+    g_mutex_lock (&pool->lock);
+    while (pool->pending >= pool->max_pending)
+        g_cond_wait (&pool->done_cond, &pool->lock);
+    pool->pending++;
+    g_mutex_unlock (&pool->lock);
+
+    g_thread_pool_push (pool->pool, file, NULL);
+}
+
+
+void localcopy_pool_free (LocalCopyPool *pool)
+{
+    g_thread_pool_free (pool->pool, FALSE, TRUE);
+    g_mutex_clear (&pool->lock);
+    g_cond_clear (&pool->done_cond);
+    g_free (pool);
+}
@@ -0,0 +1,83 @@
+/**
+ * @file localcopy.h
+ * @copyright (C) 2013-2017 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <sys/stat.h>
+#include <libgnomevfs/gnome-vfs.h>
+
+/**
+ * How the data of a file has been copied by localcopy_data (), the
+ * first method which works for the pair of files is used.
+ */
+enum LocalCopyMethod
+{
+    LOCALCOPY_REFLINK,              // FICLONE, the data is shared until it's changed
+    LOCALCOPY_COPY_FILE_RANGE,      // in the kernel, or on the server for NFS and CIFS
+    LOCALCOPY_SENDFILE,             // in the kernel
+    LOCALCOPY_BUFFER                // read () and write () through a big aligned buffer
+};
+
+/**
+ * Called after each piece with the bytes copied so far, returning FALSE
+ * stops the copy with GNOME_VFS_ERROR_INTERRUPTED.
+ */
+typedef gboolean (* LocalCopyProgressFunc) (GnomeVFSFileSize bytes_copied, gpointer user_data);
+
+/**
+ * Copies the data of the regular file @a src_fd, @a size bytes, into
+ * @a dest_fd. Both are read and written from their current offsets, which
+ * are 0 unless a partial copy is resumed, a reflink is only tried at 0.
+ * @a method, if not NULL, is set to the method used.
+ */
+GnomeVFSResult localcopy_data (int src_fd, int dest_fd, GnomeVFSFileSize size,
+                               LocalCopyProgressFunc func, gpointer user_data,
+                               LocalCopyMethod *method=NULL);
+
+/**
+ * Compares the first @a size bytes of @a src_fd and @a dest_fd, without
+ * moving their offsets. Returns GNOME_VFS_ERROR_CORRUPTED_DATA if they
+ * differ or either file is shorter. @a func is called with the bytes
+ * compared so far.
+ */
+GnomeVFSResult localcopy_verify (int src_fd, int dest_fd, GnomeVFSFileSize size,
+                                 LocalCopyProgressFunc func, gpointer user_data);
+
+/**
+ * Sets the permissions and times of @a st on the copy @a dest_fd, once
+ * its data has been copied.
+ */
+void localcopy_set_attributes (int dest_fd, const struct stat *st);
+
+/**
+ * The workers copying the files a walker hands over to them, calling
+ * @a func with each file and @a user_data. Only a bounded number of
+ * files per worker is queued, localcopy_pool_push () waits until a worker
+ * is done with one, so that the walker of a huge tree doesn't hold all of
+ * it in memory.
+ */
+struct LocalCopyPool;
+
+LocalCopyPool *localcopy_pool_new (GFunc func, gpointer user_data, guint workers);
+void localcopy_pool_push (LocalCopyPool *pool, gpointer file);
+
+/**
+ * Waits for all files pushed to be done with, and frees @a pool.
+ */
+void localcopy_pool_free (LocalCopyPool *pool);
@@ -0,0 +1,311 @@
+/**
+ * @file localdir.cc
+ * @copyright (C) 2013-2017 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#endif
+
+// no GTK and no other gnome-commander code in here, tests/local_listing_benchmark links this file alone
+#include "localdir.h"
+#include "mimeresolver.h"
+
+using namespace std;
+
+
+#if defined(__linux__) && defined(SYS_getdents64)
+#define USE_GETDENTS64
+#define READ_BUFFER_SIZE (256*1024)     // a single getdents64 call reads a few thousand entries into it
+#endif
+
+#ifdef HAVE_STATX
+// everything GnomeCmdFile uses, but not the birth time and the mount id
+#define STATX_NEEDED (STATX_TYPE | STATX_MODE | STATX_NLINK | STATX_UID | STATX_GID | \
+                      STATX_ATIME | STATX_MTIME | STATX_CTIME | STATX_INO | STATX_SIZE | STATX_BLOCKS)
+#endif
+
+
+struct LocalDir
+{
+    gint ref_count;
+    int fd;
+#ifdef USE_GETDENTS64
+    gchar *buf;
+    glong buf_len;
+    glong buf_pos;
+#else
+    DIR *dirp;
+#endif
+};
+
+
+LocalDir *localdir_open (const gchar *path, GnomeVFSResult *result)
+{
+    g_return_val_if_fail (path != NULL, NULL);
+
+    int fd = open (path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+    if (fd < 0)
+    {
+        *result = gnome_vfs_result_from_errno ();
+        return NULL;
+    }
+
+    LocalDir *dir = g_new0 (LocalDir, 1);
+
+    dir->ref_count = 1;
+    dir->fd = fd;
+
+#ifdef USE_GETDENTS64
+    dir->buf = (gchar *) g_malloc (READ_BUFFER_SIZE);
+#else
+    // readdir gets its own descriptor, fd is kept for the *at () calls which may run concurrently
+    dir->dirp = opendir (path);
+
+    if (!dir->dirp)
+    {
+        *result = gnome_vfs_result_from_errno ();
+        close (fd);
+        g_free (dir);
+        return NULL;
+    }
+#endif
+
+    *result = GNOME_VFS_OK;
+
+    return dir;
+}
+
+
+LocalDir *localdir_ref (LocalDir *dir)
+{
+    g_atomic_int_inc (&dir->ref_count);
+
+    return dir;
+}
+
+
+void localdir_unref (LocalDir *dir)
+{
+    if (!g_atomic_int_dec_and_test (&dir->ref_count))
+        return;
+
+#ifdef USE_GETDENTS64
+    g_free (dir->buf);
+#else
+    closedir (dir->dirp);
+#endif
+    close (dir->fd);
+    g_free (dir);
+}
+
+
+static const gchar *read_name (LocalDir *dir, GnomeVFSResult *result)
+{
+#ifdef USE_GETDENTS64
+    if (dir->buf_pos >= dir->buf_len)
+    {
+        dir->buf_len = syscall (SYS_getdents64, dir->fd, dir->buf, READ_BUFFER_SIZE);
+        dir->buf_pos = 0;
+
+        if (dir->buf_len <= 0)
+        {
+            *result = dir->buf_len < 0 ? gnome_vfs_result_from_errno () : GNOME_VFS_ERROR_EOF;
+            dir->buf_len = 0;
+            return NULL;
+        }
+    }
+
+    // the kernel's linux_dirent64 has the same layout as glibc's dirent64
+    struct dirent64 *entry = (struct dirent64 *) (dir->buf + dir->buf_pos);
+    dir->buf_pos += entry->d_reclen;
+#else
+    errno = 0;
+    struct dirent *entry = readdir (dir->dirp);
+
+    if (!entry)
+    {
+        *result = errno ? gnome_vfs_result_from_errno () : GNOME_VFS_ERROR_EOF;
+        return NULL;
+    }
+#endif
+
+    return entry->d_name;
+}
+
+
+GList *localdir_read (LocalDir *dir, guint n, GnomeVFSResult *result)
+{
+    g_return_val_if_fail (dir != NULL, NULL);
+
+    GList *infolist = NULL;
+
+    *result = GNOME_VFS_OK;
+
+    while (n > 0)
+    {
+        const gchar *name = read_name (dir, result);
+
+        if (!name)
+            break;
+
+        if (strcmp (name, ".") == 0 || strcmp (name, "..") == 0)
+            continue;
+
+        GnomeVFSFileInfo *info = gnome_vfs_file_info_new ();
+        info->name = g_strdup (name);
+        infolist = g_list_prepend (infolist, info);
+        --n;
+    }
+
+    return g_list_reverse (infolist);
+}
+
+
+static int stat_at (int dirfd, const gchar *name, gboolean follow, struct stat *st)
+{
+#ifdef HAVE_STATX
+    struct statx stx;
+    int flags = AT_NO_AUTOMOUNT | (follow ? 0 : AT_SYMLINK_NOFOLLOW);
+
+    if (statx (dirfd, name, flags, STATX_NEEDED, &stx) != 0)
+        return -1;
+
+    memset (st, 0, sizeof(struct stat));
+
+    st->st_mode = stx.stx_mode;
+    st->st_nlink = stx.stx_nlink;
+    st->st_uid = stx.stx_uid;
+    st->st_gid = stx.stx_gid;
+    st->st_ino = stx.stx_ino;
+    st->st_size = stx.stx_size;
+    st->st_blocks = stx.stx_blocks;
+    st->st_blksize = stx.stx_blksize;
+    st->st_dev = makedev (stx.stx_dev_major, stx.stx_dev_minor);
+    st->st_atime = stx.stx_atime.tv_sec;
+    st->st_mtime = stx.stx_mtime.tv_sec;
+    st->st_ctime = stx.stx_ctime.tv_sec;
+
+    return 0;
+#else
+    return fstatat (dirfd, name, st, follow ? 0 : AT_SYMLINK_NOFOLLOW);
+#endif
+}
+
+
+static gchar *read_link (int dirfd, const gchar *name)
+{
+    gchar *target = (gchar *) g_malloc (PATH_MAX+1);
+    gssize len = readlinkat (dirfd, name, target, PATH_MAX);
+
+    if (len < 0)
+    {
+        g_free (target);
+        return NULL;
+    }
+
+    target[len] = '\0';
+
+    return target;
+}
+
+
+inline GnomeVFSFileType type_from_mode (mode_t mode)
+{
+    if (S_ISREG (mode))   return GNOME_VFS_FILE_TYPE_REGULAR;
+    if (S_ISDIR (mode))   return GNOME_VFS_FILE_TYPE_DIRECTORY;
+    if (S_ISLNK (mode))   return GNOME_VFS_FILE_TYPE_SYMBOLIC_LINK;
+    if (S_ISCHR (mode))   return GNOME_VFS_FILE_TYPE_CHARACTER_DEVICE;
+    if (S_ISBLK (mode))   return GNOME_VFS_FILE_TYPE_BLOCK_DEVICE;
+    if (S_ISFIFO (mode))  return GNOME_VFS_FILE_TYPE_FIFO;
+    if (S_ISSOCK (mode))  return GNOME_VFS_FILE_TYPE_SOCKET;
+
+    return GNOME_VFS_FILE_TYPE_UNKNOWN;
+}
+
+
+GnomeVFSResult localdir_stat (LocalDir *dir, GnomeVFSFileInfo *info)
+{
+    g_return_val_if_fail (dir != NULL, GNOME_VFS_ERROR_BAD_PARAMETERS);
+    g_return_val_if_fail (info != NULL && info->name != NULL, GNOME_VFS_ERROR_BAD_PARAMETERS);
+
+    struct stat st;
+
+    // a single call for everything but symlinks, which are followed unless they are broken
+    if (stat_at (dir->fd, info->name, FALSE, &st) != 0)
+        return gnome_vfs_result_from_errno ();
+
+    if (S_ISLNK (st.st_mode))
+    {
+        info->flags = (GnomeVFSFileFlags) (info->flags | GNOME_VFS_FILE_FLAGS_SYMLINK);
+        info->symlink_name = read_link (dir->fd, info->name);
+
+        if (info->symlink_name)
+            info->valid_fields = (GnomeVFSFileInfoFields) (info->valid_fields | GNOME_VFS_FILE_INFO_FIELDS_SYMLINK_NAME);
+
+        struct stat target_st;
+
+        if (stat_at (dir->fd, info->name, TRUE, &target_st) == 0)
+            st = target_st;
+    }
+
+    info->type = type_from_mode (st.st_mode);
+    info->permissions = (GnomeVFSFilePermissions) (st.st_mode & 07777);
+    info->flags = (GnomeVFSFileFlags) (info->flags | GNOME_VFS_FILE_FLAGS_LOCAL);
+    info->device = st.st_dev;
+    info->inode = st.st_ino;
+    info->link_count = st.st_nlink;
+    info->uid = st.st_uid;
+    info->gid = st.st_gid;
+    info->size = st.st_size;
+    info->block_count = st.st_blocks;
+    info->io_block_size = st.st_blksize;
+    info->atime = st.st_atime;
+    info->mtime = st.st_mtime;
+    info->ctime = st.st_ctime;
+    info->mime_type = g_strdup (mime_guess_type (info));
+
+    info->valid_fields = (GnomeVFSFileInfoFields) (info->valid_fields |
+                                                   GNOME_VFS_FILE_INFO_FIELDS_TYPE |
+                                                   GNOME_VFS_FILE_INFO_FIELDS_PERMISSIONS |
+                                                   GNOME_VFS_FILE_INFO_FIELDS_FLAGS |
+                                                   GNOME_VFS_FILE_INFO_FIELDS_DEVICE |
+                                                   GNOME_VFS_FILE_INFO_FIELDS_INODE |
+                                                   GNOME_VFS_FILE_INFO_FIELDS_LINK_COUNT |
+                                                   GNOME_VFS_FILE_INFO_FIELDS_SIZE |
+                                                   GNOME_VFS_FILE_INFO_FIELDS_BLOCK_COUNT |
+                                                   GNOME_VFS_FILE_INFO_FIELDS_IO_BLOCK_SIZE |
+                                                   GNOME_VFS_FILE_INFO_FIELDS_ATIME |
+                                                   GNOME_VFS_FILE_INFO_FIELDS_MTIME |
+                                                   GNOME_VFS_FILE_INFO_FIELDS_CTIME |
+                                                   GNOME_VFS_FILE_INFO_FIELDS_MIME_TYPE);
+
+    return GNOME_VFS_OK;
+}
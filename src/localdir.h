@@ -0,0 +1,48 @@
+/**
+ * @file localdir.h
+ * @copyright (C) 2013-2017 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <libgnomevfs/gnome-vfs.h>
+
+/**
+ * A local directory listed without GnomeVFS. The names are read in big
+ * batches with getdents64 (readdir elsewhere) by one thread, the entries
+ * can then be stat'ed relative to the open directory by any number of
+ * threads. The MIME types are guessed from the names only.
+ */
+struct LocalDir;
+
+LocalDir *localdir_open (const gchar *path, GnomeVFSResult *result);
+LocalDir *localdir_ref (LocalDir *dir);
+void localdir_unref (LocalDir *dir);
+
+/**
+ * Reads up to @a n more names of the directory, "." and ".." are skipped.
+ * Returns a list of GnomeVFSFileInfos with only the name set, @a result
+ * is set to GNOME_VFS_ERROR_EOF after the last name.
+ */
+GList *localdir_read (LocalDir *dir, guint n, GnomeVFSResult *result);
+
+/**
+ * Fills in @a info for the entry named info->name the way
+ * GNOME_VFS_FILE_INFO_FOLLOW_LINKS does, it's safe to call from
+ * several threads at once.
+ */
+GnomeVFSResult localdir_stat (LocalDir *dir, GnomeVFSFileInfo *info);
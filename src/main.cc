@@ -42,6 +42,7 @@ extern "C"
 #include "gnome-cmd-con.h"
 #include "utils.h"
 #include "ls_colors.h"
+#include "treesize.h"
 #include "imageloader.h"
 #include "plugin_manager.h"
 #include "gnome-cmd-python-plugin.h"
@@ -197,6 +198,7 @@ int main (int argc, char *argv[])
         gcmd_tags_shutdown ();
         gcmd_user_actions.shutdown();
         gnome_cmd_data.save();
+        treesize_save_cache ();
         IMAGE_free ();
 
         remove_temp_download_dir ();
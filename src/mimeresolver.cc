@@ -0,0 +1,148 @@
+/**
+ * @file mimeresolver.cc
+ * @copyright (C) 2013-2017 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include "gnome-cmd-includes.h"
+#include "gnome-cmd-file.h"
+#include "mimeresolver.h"
+#include "utils.h"
+
+using namespace std;
+
+
+#define RESOLVE_THREADS 2       // sniffing is mostly waiting for the disk, more threads would only compete with the listings
+
+
+struct MimeRequest
+{
+    GnomeCmdFile *f;            // reffed, never touched by the workers
+    gchar *uri_str;
+    gchar *mime_type;           // found by the worker
+    gint cancelled;
+    MimeResolvedFunc func;
+    gpointer user_data;
+};
+
+
+static GThreadPool *resolve_pool = NULL;
+static GQueue visible_requests = G_QUEUE_INIT;
+static GQueue other_requests = G_QUEUE_INIT;
+static GList *resolved_requests = NULL;         // waiting for the main loop
+static guint deliver_source_id = 0;
+G_LOCK_DEFINE_STATIC (requests);
+
+
+static gboolean deliver_resolved_requests (gpointer unused)
+{
+    G_LOCK (requests);
+    GList *reqs = g_list_reverse (resolved_requests);
+    resolved_requests = NULL;
+    deliver_source_id = 0;
+    G_UNLOCK (requests);
+
+    for (GList *i = reqs; i; i = i->next)
+    {
+        MimeRequest *req = (MimeRequest *) i->data;
+
+        if (!req->cancelled)
+        {
+            if (req->f->mime_type_guessed)
+            {
+                if (req->mime_type)
+                    req->f->set_mime_type(req->mime_type);
+                else
+                    req->f->mime_type_guessed = FALSE;      // keep the guess, it can't be done better
+
+                req->mime_type = NULL;
+            }
+
+            req->func (req->f, req->user_data);
+        }
+
+        req->f->unref();
+        g_free (req->uri_str);
+        g_free (req->mime_type);
+        g_free (req);
+    }
+
+    g_list_free (reqs);
+
+    return FALSE;
+}
+
+
+// Each push to resolve_pool stands for one queued request, the worker picks the most urgent one
+static void resolve_next (gpointer unused1, gpointer unused2)
+{
+    G_LOCK (requests);
+    MimeRequest *req = (MimeRequest *) g_queue_pop_head (&visible_requests);
+    if (!req)
+        req = (MimeRequest *) g_queue_pop_head (&other_requests);
+    G_UNLOCK (requests);
+
+    if (!req)
+        return;
+
+    if (!g_atomic_int_get (&req->cancelled))
+    {
+        DEBUG ('m', "Resolving MIME type of %s\n", req->uri_str);
+        req->mime_type = gnome_vfs_get_mime_type (req->uri_str);
+    }
+
+    G_LOCK (requests);
+    resolved_requests = g_list_prepend (resolved_requests, req);
+    if (!deliver_source_id)
+        deliver_source_id = g_idle_add (deliver_resolved_requests, NULL);
+    G_UNLOCK (requests);
+}
+
+
+MimeRequest *mime_resolver_request (GnomeCmdFile *f, gboolean visible, MimeResolvedFunc func, gpointer user_data)
+{
+    g_return_val_if_fail (GNOME_CMD_IS_FILE (f), NULL);
+    g_return_val_if_fail (func != NULL, NULL);
+
+    MimeRequest *req = g_new0 (MimeRequest, 1);
+
+    req->f = f->ref();
+    req->uri_str = f->get_uri_str();
+    req->func = func;
+    req->user_data = user_data;
+
+    if (!resolve_pool)
+        resolve_pool = g_thread_pool_new (resolve_next, NULL, RESOLVE_THREADS, FALSE, NULL);
+
+    G_LOCK (requests);
+    g_queue_push_tail (visible ? &visible_requests : &other_requests, req);
+    G_UNLOCK (requests);
+
+    g_thread_pool_push (resolve_pool, GINT_TO_POINTER (TRUE), NULL);
+
+    return req;
+}
+
+
+// The request is freed in the main loop once a worker has taken it off the queue
+void mime_resolver_cancel (MimeRequest *req)
+{
+    g_return_if_fail (req != NULL);
+
+    g_atomic_int_set (&req->cancelled, TRUE);
+}
@@ -0,0 +1,57 @@
+/**
+ * @file mimeresolver.h
+ * @copyright (C) 2013-2017 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <libgnomevfs/gnome-vfs.h>
+#include <libgnomevfs/gnome-vfs-mime-utils.h>
+
+/**
+ * The MIME type of @a info guessed from its file type and name, without
+ * reading the file. It's the real one for everything but regular files.
+ */
+inline const gchar *mime_guess_type (GnomeVFSFileInfo *info)
+{
+    switch (info->type)
+    {
+        case GNOME_VFS_FILE_TYPE_DIRECTORY:         return "x-directory/normal";
+        case GNOME_VFS_FILE_TYPE_SYMBOLIC_LINK:     return "x-special/symlink";
+        case GNOME_VFS_FILE_TYPE_CHARACTER_DEVICE:  return "x-special/device-char";
+        case GNOME_VFS_FILE_TYPE_BLOCK_DEVICE:      return "x-special/device-block";
+        case GNOME_VFS_FILE_TYPE_FIFO:              return "x-special/fifo";
+        case GNOME_VFS_FILE_TYPE_SOCKET:            return "x-special/socket";
+        default:                                    return gnome_vfs_get_mime_type_for_name (info->name);
+    }
+}
+
+
+struct GnomeCmdFile;
+struct MimeRequest;
+
+typedef void (* MimeResolvedFunc) (GnomeCmdFile *f, gpointer user_data);
+
+/**
+ * Looks up the real MIME type of @a f, whose type has been guessed by
+ * the listing, on a worker thread. Requests for @a visible files are
+ * served before all others. @a func is called in the main loop after
+ * f->info->mime_type has been replaced, it isn't called for cancelled
+ * requests.
+ */
+MimeRequest *mime_resolver_request (GnomeCmdFile *f, gboolean visible, MimeResolvedFunc func, gpointer user_data);
+void mime_resolver_cancel (MimeRequest *req);
@@ -0,0 +1,74 @@
+/**
+ * @file namearena.h
+ * @copyright (C) 2013-2017 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#define NAME_ARENA_BLOCK_SIZE 2048
+
+/**
+ * The strings of a single listing, file names and collation keys, packed
+ * into a few big blocks instead of a malloc'ed block each. Strings are
+ * never freed one by one, all of them go away with the last reference.
+ * The ref count isn't atomic: a listing worker may fill a new arena, but
+ * once it's handed to the main loop it's for the main thread only.
+ */
+struct NameArena
+{
+    gint ref_count;
+    GStringChunk *chunk;
+};
+
+
+inline NameArena *name_arena_new ()
+{
+    NameArena *arena = g_new (NameArena, 1);
+
+    arena->ref_count = 1;
+    arena->chunk = g_string_chunk_new (NAME_ARENA_BLOCK_SIZE);
+
+    return arena;
+}
+
+inline NameArena *name_arena_ref (NameArena *arena)
+{
+    g_return_val_if_fail (arena != NULL, NULL);
+
+    arena->ref_count++;
+
+    return arena;
+}
+
+inline void name_arena_unref (NameArena *arena)
+{
+    g_return_if_fail (arena != NULL);
+    g_return_if_fail (arena->ref_count > 0);
+
+    if (--arena->ref_count)
+        return;
+
+    g_string_chunk_free (arena->chunk);
+    g_free (arena);
+}
+
+inline const gchar *name_arena_add (NameArena *arena, const gchar *s)
+{
+    g_return_val_if_fail (arena != NULL, NULL);
+
+    return g_string_chunk_insert (arena->chunk, s);
+}
@@ -0,0 +1,255 @@
+/**
+ * @file prefetch.cc
+ * @copyright (C) 2013-2017 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include "gnome-cmd-includes.h"
+#include "gnome-cmd-con.h"
+#include "gnome-cmd-data.h"
+#include "prefetch.h"
+#include "utils.h"
+
+using namespace std;
+
+
+#define RUNNING_PER_CON 2           // prefetched listings of one connection at a time
+#define BUDGET_WINDOW 60            // seconds, gnome_cmd_data.prefetch_budget is per window
+#define BYTES_PER_ENTRY 128         // what a listed entry roughly costs on the wire, SFTP and FTP alike
+#define KEPT_DIRS 32                // prefetched dirs kept alive until they're entered
+
+
+struct PrefetchJob
+{
+    GnomeCmdDir *dir;               // reffed
+    gpointer owner;                 // NULL once the owner doesn't want the dir anymore
+    gboolean running;
+};
+
+
+struct PrefetchCon
+{
+    guint running;
+    gint64 window_start;
+    guint64 spent;                  // bytes in the current window
+};
+
+
+static GList *jobs = NULL;          // in the order of the requests, both the waiting and the running ones
+static GHashTable *cons = NULL;     // GnomeCmdCon -> PrefetchCon
+static GQueue kept_dirs = G_QUEUE_INIT;
+
+static void run_jobs ();
+
+
+static PrefetchCon *get_con (GnomeCmdDir *dir)
+{
+    if (!cons)
+        cons = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+
+    GnomeCmdCon *con = gnome_cmd_dir_get_connection (dir);
+    PrefetchCon *pc = (PrefetchCon *) g_hash_table_lookup (cons, con);
+
+    if (!pc)
+    {
+        pc = g_new0 (PrefetchCon, 1);
+        g_hash_table_insert (cons, con, pc);
+    }
+
+    gint64 now = g_get_monotonic_time ();
+
+    if (now - pc->window_start > BUDGET_WINDOW * G_USEC_PER_SEC)
+    {
+        pc->window_start = now;
+        pc->spent = 0;
+    }
+
+    return pc;
+}
+
+
+// The listing of a dir only survives as long as the dir, which nothing else may hold yet
+static void keep_dir (GnomeCmdDir *dir)
+{
+    GList *link = g_queue_find (&kept_dirs, dir);
+
+    if (link)
+    {
+        g_queue_unlink (&kept_dirs, link);
+        g_queue_push_head_link (&kept_dirs, link);
+        return;
+    }
+
+    g_queue_push_head (&kept_dirs, gnome_cmd_dir_ref (dir));
+
+    while (g_queue_get_length (&kept_dirs) > KEPT_DIRS)
+        gnome_cmd_dir_unref ((GnomeCmdDir *) g_queue_pop_tail (&kept_dirs));
+}
+
+
+static void free_job (PrefetchJob *job)
+{
+    jobs = g_list_remove (jobs, job);
+    gnome_cmd_dir_unref (job->dir);
+    g_free (job);
+}
+
+
+static void on_list_ok (GnomeCmdDir *dir, GList *files, PrefetchJob *job);
+static void on_list_failed (GnomeCmdDir *dir, GnomeVFSResult result, PrefetchJob *job);
+
+
+static void finish_job (PrefetchJob *job, guint n_files)
+{
+    PrefetchCon *pc = get_con (job->dir);
+
+    g_signal_handlers_disconnect_by_func (job->dir, (gpointer) on_list_ok, job);
+    g_signal_handlers_disconnect_by_func (job->dir, (gpointer) on_list_failed, job);
+
+    pc->running--;
+    pc->spent += (guint64) n_files * BYTES_PER_ENTRY;
+
+    free_job (job);
+    run_jobs ();
+}
+
+
+static void on_list_ok (GnomeCmdDir *dir, GList *files, PrefetchJob *job)
+{
+    DEBUG ('l', "Prefetched %s, %u files\n", gnome_cmd_dir_get_path (dir)->get_path(), g_list_length (files));
+
+    keep_dir (dir);
+    finish_job (job, g_list_length (files));
+}
+
+
+static void on_list_failed (GnomeCmdDir *dir, GnomeVFSResult result, PrefetchJob *job)
+{
+    DEBUG ('l', "Prefetching %s failed or was cancelled: %s\n", gnome_cmd_dir_get_path (dir)->get_path(), gnome_vfs_result_to_string (result));
+
+    finish_job (job, 0);
+}
+
+
+static void run_jobs ()
+{
+    guint64 budget = (guint64) gnome_cmd_data.prefetch_budget << 10;
+
+    for (GList *i = jobs, *next; i; i = next)
+    {
+        PrefetchJob *job = (PrefetchJob *) i->data;
+
+        next = i->next;
+
+        if (job->running)
+            continue;
+
+        PrefetchCon *pc = get_con (job->dir);
+
+        if (pc->spent >= budget)
+        {
+            DEBUG ('l', "Prefetch budget used up, skipping %s\n", gnome_cmd_dir_get_path (job->dir)->get_path());
+            free_job (job);
+            continue;
+        }
+
+        if (pc->running >= RUNNING_PER_CON)
+            continue;
+
+        // listed or being listed meanwhile
+        if (!gnome_cmd_dir_prefetch (job->dir))
+        {
+            free_job (job);
+            continue;
+        }
+
+        job->running = TRUE;
+        pc->running++;
+
+        g_signal_connect (job->dir, "list-ok", G_CALLBACK (on_list_ok), job);
+        g_signal_connect (job->dir, "list-failed", G_CALLBACK (on_list_failed), job);
+    }
+}
+
+
+static PrefetchJob *find_job (GnomeCmdDir *dir)
+{
+    for (GList *i = jobs; i; i = i->next)
+        if (((PrefetchJob *) i->data)->dir == dir)
+            return (PrefetchJob *) i->data;
+
+    return NULL;
+}
+
+
+void prefetch_cancel (gpointer owner)
+{
+    prefetch_dirs (owner, NULL);
+}
+
+
+void prefetch_dirs (gpointer owner, GList *dirs)
+{
+    g_return_if_fail (owner != NULL);
+
+    for (GList *i = jobs, *next; i; i = next)
+    {
+        PrefetchJob *job = (PrefetchJob *) i->data;
+
+        next = i->next;
+
+        if (job->owner != owner || g_list_find (dirs, job->dir))
+            continue;
+
+        job->owner = NULL;
+
+        if (!job->running)
+            free_job (job);
+        else
+            // a panel which has entered the dir meanwhile waits for this very listing
+            if (!gnome_cmd_dir_is_monitored (job->dir))
+                gnome_cmd_dir_cancel_listing (job->dir);
+    }
+
+    if (gnome_cmd_data.prefetch_budget == 0)
+        return;
+
+    for (GList *i = dirs; i; i = i->next)
+    {
+        GnomeCmdDir *dir = (GnomeCmdDir *) i->data;
+
+        // local dirs are read again whenever they are entered, see gnome_cmd_dir_list_files ()
+        if (gnome_cmd_dir_is_local (dir) || dir->state != GnomeCmdDir::STATE_EMPTY)
+            continue;
+
+        PrefetchJob *job = find_job (dir);
+
+        if (job)
+        {
+            job->owner = owner;
+            continue;
+        }
+
+        job = g_new0 (PrefetchJob, 1);
+        job->dir = gnome_cmd_dir_ref (dir);
+        job->owner = owner;
+        jobs = g_list_append (jobs, job);
+    }
+
+    run_jobs ();
+}
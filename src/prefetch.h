@@ -0,0 +1,34 @@
+/**
+ * @file prefetch.h
+ * @copyright (C) 2013-2017 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include "gnome-cmd-dir.h"
+
+/**
+ * Lists the remote @a dirs which @a owner, usually a file list, is
+ * likely to enter next, so that their listings are in the dir cache
+ * when it does. The request replaces the previous one of @a owner:
+ * the dirs which aren't wanted anymore are dropped from the queue or
+ * their listings are cancelled. Dirs already listed, local dirs and
+ * connections which have used up gnome_cmd_data.prefetch_budget are
+ * skipped.
+ */
+void prefetch_dirs (gpointer owner, GList *dirs);
+void prefetch_cancel (gpointer owner);
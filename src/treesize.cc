@@ -0,0 +1,588 @@
+/**
+ * @file treesize.cc
+ * @copyright (C) 2013-2017 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <glib/gstdio.h>
+
+#include "gnome-cmd-includes.h"
+#include "gnome-cmd-data.h"
+#include "treesize.h"
+
+using namespace std;
+
+
+#define CACHE_FILENAME "treesize.cache"
+#define CACHE_MAGIC "GCMDTSZ1"
+#define CACHE_MAX_RECORDS 100000        // dirs kept in the cache file, the ones not walked for the longest time are dropped first
+
+
+/***********************************
+ * Persistent cache
+ *
+ * For every walked local dir the cache keeps the size and the number of
+ * the files directly in it and the names of its subdirs, keyed by
+ * (device, inode) and valid as long as the dir's mtime is the same. A
+ * cached dir costs a stat instead of a listing, so walking a mostly
+ * unchanged tree again only lists the dirs which have changed.
+ *
+ * Note that rewriting a file doesn't change the mtime of its dir, the new
+ * size is counted once something is added to or removed from the dir.
+ *
+ * On disk, the records follow a header of CACHE_MAGIC and the number of
+ * records. The file is mapped at the first lookup, dirs walked in this
+ * session, whether found in the cache or listed, are kept on the heap
+ * until treesize_save_cache () writes a new file. They are written
+ * first, followed by the mapped ones up to CACHE_MAX_RECORDS, so the
+ * dirs which haven't been walked for the longest time drop out of the
+ * cache, deleted ones among them.
+ ***********************************/
+
+struct CacheRecord
+{
+    guint64 dev;                // dev and ino must come first, they are the key of the record
+    guint64 ino;
+    gint64 mtime;
+    guint64 size;               // of the files directly in the dir
+    guint64 count;              // the files directly in the dir and the dir itself
+    guint32 n_subdirs;
+    guint32 names_len;          // the NUL terminated names of the subdirs follow, padded to 8 bytes
+};
+
+
+#define RECORD_LEN(names_len) (sizeof(CacheRecord) + (((names_len) + 7) & ~7))
+
+
+static GMappedFile *cache_file = NULL;
+static GHashTable *cache = NULL;    // CacheRecord -> itself, records on the heap or in cache_file
+static gboolean cache_changed = FALSE;
+G_LOCK_DEFINE_STATIC (cache);
+
+
+static guint record_hash (const CacheRecord *rec)
+{
+    return (guint) (rec->ino ^ (rec->ino >> 32) ^ (rec->dev * 31));
+}
+
+
+static gboolean record_equal (const CacheRecord *rec1, const CacheRecord *rec2)
+{
+    return rec1->dev == rec2->dev && rec1->ino == rec2->ino;
+}
+
+
+inline gboolean record_is_mapped (const CacheRecord *rec)
+{
+    if (!cache_file)
+        return FALSE;
+
+    const gchar *start = g_mapped_file_get_contents (cache_file);
+
+    return (const gchar *) rec >= start && (const gchar *) rec < start + g_mapped_file_get_length (cache_file);
+}
+
+
+static void free_record (CacheRecord *rec)
+{
+    if (!record_is_mapped (rec))
+        g_free (rec);
+}
+
+
+inline gchar *get_cache_path ()
+{
+    return config_dir ? g_build_filename (config_dir, CACHE_FILENAME, NULL) : g_build_filename (g_get_home_dir (), "." PACKAGE, CACHE_FILENAME, NULL);
+}
+
+
+// The names of the subdirs must be within the record, walk_dir () relies on it
+static gboolean record_is_valid (const CacheRecord *rec)
+{
+    const gchar *name = (const gchar *) (rec + 1);
+    const gchar *end = name + rec->names_len;
+    guint32 n = 0;
+
+    for (; name < end; ++n)
+    {
+        const gchar *name_end = (const gchar *) memchr (name, '\0', end - name);
+
+        // an empty name, . or .. would walk the same dirs over and over
+        if (!name_end || name_end == name || strcmp (name, ".") == 0 || strcmp (name, "..") == 0 || memchr (name, '/', name_end - name))
+            return FALSE;
+
+        name = name_end + 1;
+    }
+
+    return n == rec->n_subdirs;
+}
+
+
+// Must be called with the cache locked
+static void load_cache ()
+{
+    cache = g_hash_table_new_full ((GHashFunc) record_hash, (GEqualFunc) record_equal, NULL, (GDestroyNotify) free_record);
+
+    gchar *path = get_cache_path ();
+    cache_file = g_mapped_file_new (path, FALSE, NULL);
+    g_free (path);
+
+    if (!cache_file)
+        return;
+
+    const gchar *p = g_mapped_file_get_contents (cache_file);
+    const gchar *end = p + g_mapped_file_get_length (cache_file);
+    guint64 n;
+
+    if (end - p < (gssize) (sizeof(CACHE_MAGIC)-1 + sizeof(n)) || memcmp (p, CACHE_MAGIC, sizeof(CACHE_MAGIC)-1) != 0)
+    {
+        DEBUG ('t', "Ignoring invalid tree size cache\n");
+        g_mapped_file_unref (cache_file);
+        cache_file = NULL;
+        return;
+    }
+
+    memcpy (&n, p + sizeof(CACHE_MAGIC)-1, sizeof(n));
+    p += sizeof(CACHE_MAGIC)-1 + sizeof(n);
+
+    for (; n>0 && end - p >= (gssize) sizeof(CacheRecord); --n)
+    {
+        const CacheRecord *rec = (const CacheRecord *) p;
+
+        if (end - p < (gssize) RECORD_LEN(rec->names_len) || !record_is_valid (rec))
+        {
+            DEBUG ('t', "Ignoring the rest of a damaged tree size cache\n");
+            break;
+        }
+
+        g_hash_table_replace (cache, (gpointer) rec, (gpointer) rec);
+        p += RECORD_LEN(rec->names_len);
+    }
+
+    DEBUG ('t', "Loaded %u dirs from the tree size cache\n", g_hash_table_size (cache));
+}
+
+
+// Returns the subdirs of a cached dir as a NUL separated string, or NULL if the dir isn't cached or has changed
+static gchar *lookup_dir (GnomeVFSFileInfo *info, GnomeVFSFileSize &size, gulong &count, guint &n_subdirs)
+{
+    CacheRecord key;
+    gchar *names = NULL;
+
+    key.dev = info->device;
+    key.ino = info->inode;
+
+    G_LOCK (cache);
+
+    if (!cache)
+        load_cache ();
+
+    CacheRecord *rec = (CacheRecord *) g_hash_table_lookup (cache, &key);
+
+    if (rec && rec->mtime == info->mtime)
+    {
+        size = rec->size;
+        count = rec->count;
+        n_subdirs = rec->n_subdirs;
+        names = (gchar *) g_malloc (rec->names_len + 1);
+        memcpy (names, rec + 1, rec->names_len);
+        names[rec->names_len] = '\0';
+
+        // moved to the heap, so that it's kept when the cache is saved
+        if (record_is_mapped (rec))
+        {
+            rec = (CacheRecord *) g_memdup (rec, RECORD_LEN(rec->names_len));
+            g_hash_table_replace (cache, rec, rec);
+        }
+    }
+
+    G_UNLOCK (cache);
+
+    return names;
+}
+
+
+static void store_dir (GnomeVFSFileInfo *info, GnomeVFSFileSize size, gulong count, guint n_subdirs, GString *names)
+{
+    CacheRecord *rec = (CacheRecord *) g_malloc0 (RECORD_LEN(names->len));
+
+    rec->dev = info->device;
+    rec->ino = info->inode;
+    rec->mtime = info->mtime;
+    rec->size = size;
+    rec->count = count;
+    rec->n_subdirs = n_subdirs;
+    rec->names_len = names->len;
+    memcpy (rec + 1, names->str, names->len);
+
+    G_LOCK (cache);
+
+    if (!cache)
+        load_cache ();
+
+    g_hash_table_replace (cache, rec, rec);
+    cache_changed = TRUE;
+
+    G_UNLOCK (cache);
+}
+
+
+inline gboolean is_cacheable (GnomeVFSFileInfo *info)
+{
+    const GnomeVFSFileInfoFields fields = (GnomeVFSFileInfoFields) (GNOME_VFS_FILE_INFO_FIELDS_DEVICE |
+                                                                    GNOME_VFS_FILE_INFO_FIELDS_INODE |
+                                                                    GNOME_VFS_FILE_INFO_FIELDS_MTIME);
+
+    return (info->valid_fields & fields) == fields && info->inode != 0;
+}
+
+
+inline gboolean write_record (FILE *fd, const CacheRecord *rec)
+{
+    static const gchar padding[8] = {0};
+    gsize padding_len = RECORD_LEN(rec->names_len) - sizeof(CacheRecord) - rec->names_len;
+
+    return fwrite (rec, sizeof(CacheRecord) + rec->names_len, 1, fd) == 1 &&
+           (padding_len == 0 || fwrite (padding, padding_len, 1, fd) == 1);
+}
+
+
+void treesize_save_cache ()
+{
+    G_LOCK (cache);
+
+    if (!cache_changed)
+    {
+        G_UNLOCK (cache);
+        return;
+    }
+
+    gchar *path = get_cache_path ();
+    gchar *tmp_path = g_strconcat (path, ".tmp", NULL);
+    FILE *fd = fopen (tmp_path, "wb");
+
+    if (fd)
+    {
+        guint64 n = MIN (g_hash_table_size (cache), CACHE_MAX_RECORDS);
+        guint64 written = 0;
+        gboolean ok = fwrite (CACHE_MAGIC, sizeof(CACHE_MAGIC)-1, 1, fd) == 1 && fwrite (&n, sizeof(n), 1, fd) == 1;
+
+        GHashTableIter iter;
+        gpointer rec;
+
+        // the dirs walked in this session first, then the ones left over from before
+        for (gint mapped=0; mapped<2; ++mapped)
+        {
+            g_hash_table_iter_init (&iter, cache);
+
+            while (ok && written < n && g_hash_table_iter_next (&iter, &rec, NULL))
+                if (record_is_mapped ((CacheRecord *) rec) == mapped)
+                {
+                    ok = write_record (fd, (CacheRecord *) rec);
+                    written++;
+                }
+        }
+
+        if (fclose (fd) == 0 && ok)
+        {
+            // the mapping of the old file stays valid after the rename
+            if (g_rename (tmp_path, path) == 0)
+                cache_changed = FALSE;
+        }
+        else
+            g_unlink (tmp_path);
+    }
+
+    if (cache_changed)
+        g_warning ("Failed to save the tree size cache to %s", path);
+
+    g_free (tmp_path);
+    g_free (path);
+
+    G_UNLOCK (cache);
+}
+
+
+/***********************************
+ * Every dir of a tree is a task of its own for a shared pool of worker
+ * threads. A worker lists its dir, adds up the sizes of the files and
+ * queues the subdirs as new tasks, so that idle workers pick up the
+ * subtrees of busy ones. A job is done when its last task is.
+ ***********************************/
+
+struct TreeSizeJob
+{
+    gint ref_count;             // the owner and every queued task hold a reference
+    gint cancelled;
+
+    GMutex lock;
+    GCond done_cond;
+    GnomeVFSFileSize size;
+    gulong count;
+    gint pending;               // tasks queued or running
+    gboolean done;
+
+    TreeSizeFunc func;
+    gpointer user_data;
+    guint update_id;
+};
+
+
+struct TreeSizeTask
+{
+    TreeSizeJob *job;
+    GnomeVFSURI *uri;
+    GnomeVFSFileInfo *info;     // of the dir, if known from the listing of its parent
+};
+
+
+static GThreadPool *walk_pool = NULL;
+
+
+inline void job_unref (TreeSizeJob *job)
+{
+    if (!g_atomic_int_dec_and_test (&job->ref_count))
+        return;
+
+    g_mutex_clear (&job->lock);
+    g_cond_clear (&job->done_cond);
+    g_free (job);
+}
+
+
+static void walk_dir (TreeSizeTask *task, gpointer unused);
+
+
+// Queues the tree at uri, takes over the references to uri and info
+static void push_dir (TreeSizeJob *job, GnomeVFSURI *uri, GnomeVFSFileInfo *info=NULL)
+{
+    static gsize pool_created = 0;
+
+    if (g_once_init_enter (&pool_created))
+    {
+        walk_pool = g_thread_pool_new ((GFunc) walk_dir, NULL, MAX (4, 2 * g_get_num_processors ()), FALSE, NULL);
+        g_once_init_leave (&pool_created, 1);
+    }
+
+    TreeSizeTask *task = g_new (TreeSizeTask, 1);
+
+    task->job = job;
+    task->uri = uri;
+    task->info = info;
+
+    g_atomic_int_inc (&job->ref_count);
+
+    g_mutex_lock (&job->lock);
+    job->pending++;
+    g_mutex_unlock (&job->lock);
+
+    g_thread_pool_push (walk_pool, task, NULL);
+}
+
+
+// Lists a dir which isn't cached or has changed
+static void list_dir (TreeSizeTask *task, const gchar *uri_str, GnomeVFSFileSize &size, gulong &count)
+{
+    GList *list = NULL;
+
+    if (gnome_vfs_directory_list_load (&list, uri_str, GNOME_VFS_FILE_INFO_DEFAULT) != GNOME_VFS_OK || !list)
+        return;
+
+    GString *names = g_string_new (NULL);
+    guint n_subdirs = 0;
+
+    count++;        // count the directory too
+
+    for (GList *i = list; i; i = i->next)
+    {
+        GnomeVFSFileInfo *info = (GnomeVFSFileInfo *) i->data;
+
+        if (strcmp (info->name, ".") != 0 && strcmp (info->name, "..") != 0)
+        {
+            if (info->type == GNOME_VFS_FILE_TYPE_DIRECTORY)
+            {
+                g_string_append_len (names, info->name, strlen (info->name) + 1);
+                n_subdirs++;
+
+                push_dir (task->job, gnome_vfs_uri_append_file_name (task->uri, info->name), info);
+                continue;
+            }
+
+            size += info->size;
+            count++;
+        }
+
+        gnome_vfs_file_info_unref (info);
+    }
+
+    g_list_free (list);
+
+    if (task->info && is_cacheable (task->info))
+        store_dir (task->info, size, count, n_subdirs, names);
+
+    g_string_free (names, TRUE);
+}
+
+
+static void walk_dir (TreeSizeTask *task, gpointer unused)
+{
+    TreeSizeJob *job = task->job;
+    GnomeVFSFileSize size = 0;
+    gulong count = 0;
+
+    if (!g_atomic_int_get (&job->cancelled))
+    {
+        gchar *uri_str = gnome_vfs_uri_to_string (task->uri, GNOME_VFS_URI_HIDE_PASSWORD);
+
+        if (!task->info)
+        {
+            // the root of the tree, or a subdir of a cached dir
+            task->info = gnome_vfs_file_info_new ();
+
+            if (gnome_vfs_get_file_info (uri_str, task->info, GNOME_VFS_FILE_INFO_FOLLOW_LINKS) != GNOME_VFS_OK)
+            {
+                gnome_vfs_file_info_unref (task->info);
+                task->info = NULL;
+            }
+        }
+
+        guint n_subdirs;
+        gchar *names = task->info && task->info->type == GNOME_VFS_FILE_TYPE_DIRECTORY && is_cacheable (task->info) ?
+                       lookup_dir (task->info, size, count, n_subdirs) : NULL;
+
+        if (names)
+        {
+            for (gchar *name = names; n_subdirs>0; name += strlen (name) + 1, --n_subdirs)
+                push_dir (job, gnome_vfs_uri_append_file_name (task->uri, name));
+
+            g_free (names);
+        }
+        else
+            if (task->info && task->info->type != GNOME_VFS_FILE_TYPE_DIRECTORY)       // the job has been started for a file
+            {
+                size += task->info->size;
+                count++;
+            }
+            else
+                list_dir (task, uri_str, size, count);
+
+        g_free (uri_str);
+    }
+
+    g_mutex_lock (&job->lock);
+    job->size += size;
+    job->count += count;
+    if (--job->pending == 0)
+    {
+        job->done = TRUE;
+        g_cond_broadcast (&job->done_cond);
+    }
+    g_mutex_unlock (&job->lock);
+
+    if (task->info)
+        gnome_vfs_file_info_unref (task->info);
+    gnome_vfs_uri_unref (task->uri);
+    g_free (task);
+
+    job_unref (job);
+}
+
+
+static TreeSizeJob *create_job (const GnomeVFSURI *uri)
+{
+    TreeSizeJob *job = g_new0 (TreeSizeJob, 1);
+
+    job->ref_count = 1;
+    g_mutex_init (&job->lock);
+    g_cond_init (&job->done_cond);
+
+    push_dir (job, gnome_vfs_uri_dup (uri));
+
+    return job;
+}
+
+
+static gboolean update_job (TreeSizeJob *job)
+{
+    g_mutex_lock (&job->lock);
+    GnomeVFSFileSize size = job->size;
+    gulong count = job->count;
+    gboolean done = job->done;
+    g_mutex_unlock (&job->lock);
+
+    job->func (job, size, count, done, job->user_data);
+
+    if (!done)
+        return TRUE;
+
+    job->update_id = 0;
+    job_unref (job);
+
+    return FALSE;
+}
+
+
+TreeSizeJob *treesize_start (const GnomeVFSURI *uri, TreeSizeFunc func, gpointer user_data)
+{
+    g_return_val_if_fail (uri != NULL, NULL);
+    g_return_val_if_fail (func != NULL, NULL);
+
+    TreeSizeJob *job = create_job (uri);
+
+    job->func = func;
+    job->user_data = user_data;
+    job->update_id = g_timeout_add (gnome_cmd_data.gui_update_rate, (GSourceFunc) update_job, job);
+
+    return job;
+}
+
+
+// Stops a job before it is done, its func is not called any more
+void treesize_cancel (TreeSizeJob *job)
+{
+    g_return_if_fail (job != NULL);
+    g_return_if_fail (job->update_id != 0);
+
+    g_atomic_int_set (&job->cancelled, TRUE);
+
+    g_source_remove (job->update_id);
+    job->update_id = 0;
+
+    job_unref (job);
+}
+
+
+GnomeVFSFileSize treesize_calc (const GnomeVFSURI *uri, gulong *count)
+{
+    if (!uri)
+        return -1;
+
+    TreeSizeJob *job = create_job (uri);
+
+    g_mutex_lock (&job->lock);
+    while (!job->done)
+        g_cond_wait (&job->done_cond, &job->lock);
+    GnomeVFSFileSize size = job->size;
+    if (count)
+        *count += job->count;
+    g_mutex_unlock (&job->lock);
+
+    job_unref (job);
+
+    return size;
+}
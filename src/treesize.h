@@ -0,0 +1,40 @@
+/**
+ * @file treesize.h
+ * @copyright (C) 2013-2017 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+struct TreeSizeJob;
+
+/**
+ * Called in the main loop every gui_update_rate ms with the size and the
+ * number of files and dirs counted so far, and a last time with @a done
+ * set. The job is gone after that last call.
+ */
+typedef void (* TreeSizeFunc) (TreeSizeJob *job, GnomeVFSFileSize size, gulong count, gboolean done, gpointer user_data);
+
+TreeSizeJob *treesize_start (const GnomeVFSURI *uri, TreeSizeFunc func, gpointer user_data);
+void treesize_cancel (TreeSizeJob *job);
+
+/**
+ * Counts the size of the tree at @a uri on the worker threads and waits
+ * for the result. The number of files and dirs found is added to @a count.
+ */
+GnomeVFSFileSize treesize_calc (const GnomeVFSURI *uri, gulong *count);
+
+void treesize_save_cache ();
@@ -172,7 +172,6 @@ inline gboolean state_is_ctrl_alt_shift (gint state)
 
 GList *strings_to_uris (gchar *data);
 
-GnomeVFSFileSize calc_tree_size (const GnomeVFSURI *dir_uri, gulong *count);
 gchar *create_nice_size_str (GnomeVFSFileSize size);
 
 inline gchar *quote_if_needed (const gchar *in)
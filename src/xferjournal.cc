@@ -0,0 +1,140 @@
+/**
+ * @file xferjournal.cc
+ * @copyright (C) 2013-2017 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+#include <glib/gstdio.h>
+
+#include "gnome-cmd-includes.h"
+#include "gnome-cmd-data.h"
+#include "xferjournal.h"
+
+using namespace std;
+
+
+#define JOURNAL_DIRNAME "xfer-journal"
+#define JOURNAL_GROUP "checkpoint"
+
+
+// The entry of @a dest, named after a hash of the path, so that any path fits
+static gchar *get_entry_path (const gchar *dest)
+{
+    gchar *name = g_compute_checksum_for_string (G_CHECKSUM_SHA1, dest, -1);
+    gchar *path = config_dir ? g_build_filename (config_dir, JOURNAL_DIRNAME, name, NULL) :
+                               g_build_filename (g_get_home_dir (), "." PACKAGE, JOURNAL_DIRNAME, name, NULL);
+    g_free (name);
+
+    return path;
+}
+
+
+// Whether the target is still the file the checkpoint has been recorded for, and still holds the data up to it.
+// Whatever has been written after the checkpoint, before a crash or a dropped connection, is cut off when resuming.
+static gboolean target_unchanged (GKeyFile *key_file, const struct stat *dest_st, GnomeVFSFileSize offset)
+{
+    return g_key_file_get_uint64 (key_file, JOURNAL_GROUP, "target-dev", NULL) == (guint64) dest_st->st_dev &&
+           g_key_file_get_uint64 (key_file, JOURNAL_GROUP, "target-ino", NULL) == (guint64) dest_st->st_ino &&
+           (GnomeVFSFileSize) dest_st->st_size >= offset;
+}
+
+
+GnomeVFSFileSize xfer_journal_lookup (const gchar *src, const struct stat *src_st, const gchar *dest, const struct stat *dest_st)
+{
+    g_return_val_if_fail (src != NULL, 0);
+    g_return_val_if_fail (dest != NULL, 0);
+    g_return_val_if_fail (dest_st != NULL, 0);
+
+    gchar *path = get_entry_path (dest);
+    GKeyFile *key_file = g_key_file_new ();
+    GnomeVFSFileSize offset = 0;
+
+    if (g_key_file_load_from_file (key_file, path, G_KEY_FILE_NONE, NULL))
+    {
+        gchar *entry_src = g_key_file_get_string (key_file, JOURNAL_GROUP, "source", NULL);
+        gchar *entry_dest = g_key_file_get_string (key_file, JOURNAL_GROUP, "target", NULL);
+
+        if (g_strcmp0 (entry_src, src) == 0 && g_strcmp0 (entry_dest, dest) == 0 &&
+            g_key_file_get_uint64 (key_file, JOURNAL_GROUP, "size", NULL) == (guint64) src_st->st_size &&
+            g_key_file_get_int64 (key_file, JOURNAL_GROUP, "mtime", NULL) == (gint64) src_st->st_mtime &&
+            target_unchanged (key_file, dest_st, g_key_file_get_uint64 (key_file, JOURNAL_GROUP, "offset", NULL)))
+        {
+            offset = g_key_file_get_uint64 (key_file, JOURNAL_GROUP, "offset", NULL);
+        }
+        else
+        {
+            DEBUG ('x', "Dropping the outdated checkpoint of %s\n", dest);
+            g_unlink (path);
+        }
+
+        g_free (entry_src);
+        g_free (entry_dest);
+    }
+
+    g_key_file_free (key_file);
+    g_free (path);
+
+    return offset;
+}
+
+
+void xfer_journal_record (const gchar *src, const struct stat *src_st, const gchar *dest, const struct stat *dest_st, GnomeVFSFileSize offset)
+{
+    g_return_if_fail (src != NULL);
+    g_return_if_fail (dest != NULL);
+    g_return_if_fail (dest_st != NULL);
+
+    gchar *path = get_entry_path (dest);
+    gchar *dir = g_path_get_dirname (path);
+    GKeyFile *key_file = g_key_file_new ();
+
+    g_key_file_set_string (key_file, JOURNAL_GROUP, "source", src);
+    g_key_file_set_string (key_file, JOURNAL_GROUP, "target", dest);
+    g_key_file_set_uint64 (key_file, JOURNAL_GROUP, "size", src_st->st_size);
+    g_key_file_set_int64 (key_file, JOURNAL_GROUP, "mtime", src_st->st_mtime);
+    g_key_file_set_uint64 (key_file, JOURNAL_GROUP, "target-dev", dest_st->st_dev);
+    g_key_file_set_uint64 (key_file, JOURNAL_GROUP, "target-ino", dest_st->st_ino);
+    g_key_file_set_uint64 (key_file, JOURNAL_GROUP, "offset", offset);
+
+    gsize len;
+    gchar *contents = g_key_file_to_data (key_file, &len, NULL);
+    GError *error = NULL;
+
+    // written to a temporary file and renamed, a crash leaves the previous checkpoint
+    g_mkdir_with_parents (dir, 0700);
+    if (!g_file_set_contents (path, contents, len, &error))
+    {
+        g_warning ("Can't record the checkpoint of %s: %s", dest, error->message);
+        g_error_free (error);
+    }
+
+    g_free (contents);
+    g_key_file_free (key_file);
+    g_free (dir);
+    g_free (path);
+}
+
+
+void xfer_journal_remove (const gchar *dest)
+{
+    g_return_if_fail (dest != NULL);
+
+    gchar *path = get_entry_path (dest);
+
+    g_unlink (path);
+    g_free (path);
+}
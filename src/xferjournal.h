@@ -0,0 +1,51 @@
+/**
+ * @file xferjournal.h
+ * @copyright (C) 2013-2017 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <sys/stat.h>
+
+/**
+ * Checkpoints of large files being copied. Every so often the copy of a
+ * file is synced to disk and the offset reached is recorded for its
+ * target, together with the source's path, size and mtime and the
+ * target's device and inode. A target left behind by a cancelled or
+ * failed copy, or by a crash, can then be continued from that offset, as
+ * long as the source hasn't changed and the target is still the same
+ * file, at least that long.
+ *
+ * There is one small key file per target in the xfer-journal dir of the
+ * config dir, so the workers copying different files never wait for each
+ * other.
+ */
+
+/**
+ * The offset the copy of @a src to @a dest can be continued from, 0 if
+ * there is no checkpoint for it. A checkpoint recorded for another
+ * source, for an older version of it, or for a target that has been
+ * replaced or cut short since, is removed.
+ */
+GnomeVFSFileSize xfer_journal_lookup (const gchar *src, const struct stat *src_st, const gchar *dest, const struct stat *dest_st);
+
+/**
+ * Records that @a dest, whose state is @a dest_st, holds the first
+ * @a offset bytes of @a src on disk.
+ */
+void xfer_journal_record (const gchar *src, const struct stat *src_st, const gchar *dest, const struct stat *dest_st, GnomeVFSFileSize offset);
+void xfer_journal_remove (const gchar *dest);
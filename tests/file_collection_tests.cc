@@ -0,0 +1,192 @@
+/**
+ * @file file_collection_tests.cc
+ * @brief Part of GNOME Commander - A GNOME based file manager
+ *
+ * @details Tests for GnomeCmdFileCollection. The files of a panel or of
+ * a search come from many dirs and may share their names, neither of
+ * them may be dropped or unreffed for another one. GnomeCmdFile is
+ * replaced by a plain GObject with a name and a dir, which is all the
+ * collection looks at.
+ *
+ * @copyright (C) 2013-2017 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <gtest/gtest.h>
+#include "gnome-cmd-includes.h"
+#include "gnome-cmd-file-collection.h"
+
+using namespace std;
+
+
+/***********************************
+ * The parts of GnomeCmdFile used by the collection
+ ***********************************/
+
+GType gnome_cmd_file_get_type ()
+{
+    static GType type = 0;
+
+    if (!type)
+        type = g_type_register_static_simple (G_TYPE_OBJECT, "GnomeCmdFile", sizeof(GnomeCmdFileClass), NULL, sizeof(GnomeCmdFile), NULL, (GTypeFlags) 0);
+
+    return type;
+}
+
+
+GnomeCmdFile *GnomeCmdFile::ref()
+{
+    g_object_ref (this);
+    return this;
+}
+
+
+void GnomeCmdFile::unref()
+{
+    g_object_unref (this);
+}
+
+
+gchar *GnomeCmdFile::get_uri_str(GnomeVFSURIHideOptions hide_options)
+{
+    return g_strconcat ("file://", (const gchar *) g_object_get_data (G_OBJECT (this), "dir"), "/", info->name, NULL);
+}
+
+
+static void on_file_finalized (gboolean *finalized, GObject *f)
+{
+    *finalized = TRUE;
+}
+
+
+// Returned with one reference, *finalized is set once the last one is gone
+static GnomeCmdFile *create_file (const gchar *dir, const gchar *name, gboolean *finalized)
+{
+    GnomeCmdFile *f = GNOME_CMD_FILE (g_object_new (GNOME_CMD_TYPE_FILE, NULL));
+
+    f->info = gnome_vfs_file_info_new ();
+    f->info->name = g_strdup (name);
+    g_object_set_data_full (G_OBJECT (f), "dir", g_strdup (dir), g_free);
+    g_object_set_data_full (G_OBJECT (f), "info", f->info, (GDestroyNotify) gnome_vfs_file_info_unref);
+    g_object_weak_ref (G_OBJECT (f), (GWeakNotify) on_file_finalized, finalized);
+
+    *finalized = FALSE;
+
+    return f;
+}
+
+
+TEST(FileCollection, SameNamesFromDifferentDirs)
+{
+    GnomeCmdFileCollection files(GnomeCmdFileCollection::KEY_FILE);
+    gboolean a_finalized, b_finalized;
+
+    GnomeCmdFile *a = create_file ("/src/a", "Makefile", &a_finalized);
+    GnomeCmdFile *b = create_file ("/src/b", "Makefile", &b_finalized);
+
+    files.add(a);
+    files.add(b);
+    a->unref();
+    b->unref();
+
+    EXPECT_EQ (2u, files.size());
+    EXPECT_FALSE (a_finalized);
+    EXPECT_FALSE (b_finalized);
+    EXPECT_EQ (a, files.find("file:///src/a/Makefile"));
+    EXPECT_EQ (b, files.find("file:///src/b/Makefile"));
+
+    EXPECT_TRUE (files.remove(a));
+    EXPECT_TRUE (a_finalized);
+    EXPECT_FALSE (b_finalized);
+    EXPECT_EQ (1u, files.size());
+    EXPECT_EQ (b, files.get_list()->data);
+    EXPECT_EQ (NULL, files.find("file:///src/a/Makefile"));
+
+    files.clear();
+    EXPECT_TRUE (b_finalized);
+}
+
+
+TEST(FileCollection, ReplacedNameInOneDir)
+{
+    GnomeCmdFileCollection files;
+    gboolean old_finalized, new_finalized;
+
+    GnomeCmdFile *old_f = create_file ("/src", "Makefile", &old_finalized);
+    GnomeCmdFile *new_f = create_file ("/src", "Makefile", &new_finalized);
+
+    files.add(old_f);               // our reference stands for a panel still showing it
+    files.add(new_f);
+    new_f->unref();
+
+    // the replaced file is gone from the collection, but not unreffed twice
+    EXPECT_EQ (1u, files.size());
+    EXPECT_EQ (new_f, files.get_list()->data);
+    EXPECT_EQ (new_f, files.find_by_name("Makefile"));
+    EXPECT_FALSE (old_finalized);
+
+    // removing the stale file leaves the new one alone
+    EXPECT_FALSE (files.remove(old_f));
+    EXPECT_EQ (new_f, files.find("file:///src/Makefile"));
+
+    old_f->unref();
+    EXPECT_TRUE (old_finalized);
+
+    files.clear();
+    EXPECT_TRUE (new_finalized);
+}
+
+
+TEST(FileCollection, RemoveSet)
+{
+    GnomeCmdFileCollection files;
+    gboolean finalized[4];
+    GnomeCmdFile *f[4];
+    const gchar *names[] = {"a", "b", "c", "d"};
+
+    for (guint i=0; i<G_N_ELEMENTS(f); ++i)
+    {
+        f[i] = create_file ("/src", names[i], &finalized[i]);
+        files.add(f[i]);
+        f[i]->unref();
+    }
+
+    GHashTable *file_set = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+    g_hash_table_add (file_set, f[0]);
+    g_hash_table_add (file_set, f[2]);
+
+    EXPECT_EQ (2u, files.remove(file_set));
+    EXPECT_TRUE (finalized[0]);
+    EXPECT_TRUE (finalized[2]);
+    EXPECT_FALSE (finalized[1]);
+    EXPECT_FALSE (finalized[3]);
+
+    // the kept files stay in order and can still be found
+    GList *list = files.get_list();
+
+    ASSERT_EQ (2u, g_list_length (list));
+    EXPECT_EQ (f[1], list->data);
+    EXPECT_EQ (f[3], list->next->data);
+    EXPECT_EQ (NULL, files.find_by_name("a"));
+    EXPECT_EQ (f[3], files.find_by_name("d"));
+
+    g_hash_table_destroy (file_set);
+
+    files.clear();
+    EXPECT_TRUE (finalized[1]);
+    EXPECT_TRUE (finalized[3]);
+}
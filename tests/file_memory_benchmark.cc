@@ -0,0 +1,374 @@
+/**
+ * @file file_memory_benchmark.cc
+ * @brief Part of GNOME Commander - A GNOME based file manager
+ *
+ * @details Benchmark for the memory held per listed file: the old
+ * layout, with a separately allocated GnomeCmdFile::Private, a
+ * GnomeVFSURI per file, a malloc'ed collate key and the URI string as
+ * the key of GnomeCmdFileCollection, against the compact one, with the
+ * private data allocated together with the instance, no URI, and the
+ * collate keys and collection keys in a NameArena per directory. The
+ * GObjects are models which mirror the fields of GnomeCmdFileInfo and
+ * GnomeCmdFile, the GnomeVFSFileInfos, names and MIME types are the same
+ * in both layouts. The sizes of the real GnomeCmdFile,
+ * GnomeCmdFileCollection and NameArena are printed next to those of the
+ * compact model, which is out of date if they differ. The heap in use is
+ * read from mallinfo2() before and after creating synthetic directories
+ * of --per-dir entries, 1M entries in total by default.
+ *
+ * Build and run with: make -C tests file_memory_benchmark && tests/file_memory_benchmark [--files N] [--per-dir N]
+ *
+ * @copyright (C) 2013-2017 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <glib.h>
+#include <glib-object.h>
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include <libgnomevfs/gnome-vfs.h>
+#include <libgnomevfs/gnome-vfs-mime-utils.h>
+
+#include "gnome-cmd-includes.h"
+#include "gnome-cmd-file-collection.h"
+
+using namespace std;
+
+
+/***********************************
+ * The old layout
+ ***********************************/
+
+struct OldFile
+{
+    GObject parent;
+
+    GnomeVFSURI *uri;                   // GnomeCmdFileInfo
+    GnomeVFSFileInfo *file_info;
+
+    gpointer priv;
+    GnomeVFSFileInfo *info;
+    gboolean is_dotdot;
+    gboolean mime_type_guessed;
+    gchar *collate_key;
+    gpointer metadata;
+
+    struct
+    {
+        gboolean valid;
+        gint type;
+        guint permissions;
+        guint uid;
+        guint gid;
+        time_t mtime;
+        GnomeVFSFileSize size;
+        const gchar *extension;
+        const gchar *dirname;
+    } sort_key;
+};
+
+struct OldFilePrivate
+{
+    gpointer dir_handle;
+    GTimeVal last_update;
+    gint ref_cnt;
+    GnomeVFSFileSize tree_size;
+};
+
+struct OldFileClass
+{
+    GObjectClass parent_class;
+};
+
+G_DEFINE_TYPE (OldFile, old_file, G_TYPE_OBJECT)
+
+
+static void old_file_init (OldFile *f)
+{
+    f->priv = g_new0 (OldFilePrivate, 1);
+}
+
+
+static void old_file_finalize (GObject *object)
+{
+    OldFile *f = (OldFile *) object;
+
+    g_free (f->collate_key);
+    gnome_vfs_file_info_unref (f->info);
+    gnome_vfs_uri_unref (f->uri);
+    g_free (f->priv);
+
+    G_OBJECT_CLASS (old_file_parent_class)->finalize (object);
+}
+
+
+static void old_file_class_init (OldFileClass *klass)
+{
+    G_OBJECT_CLASS (klass)->finalize = old_file_finalize;
+}
+
+
+/***********************************
+ * The compact layout
+ ***********************************/
+
+struct NewFile
+{
+    GObject parent;
+
+    GnomeVFSURI *uri;                   // GnomeCmdFileInfo, built for plugins only
+    GnomeVFSFileInfo *file_info;
+
+    gpointer priv;
+    GnomeVFSFileInfo *info;
+    guint is_dotdot : 1;
+    guint mime_type_guessed : 1;
+    const gchar *collate_key;
+    gpointer metadata;
+
+    struct
+    {
+        time_t mtime;
+        GnomeVFSFileSize size;
+        const gchar *extension;
+        const gchar *dirname;
+        guint32 uid;
+        guint32 gid;
+        guint16 permissions;
+        guint8 type;
+        guint8 valid;
+    } sort_key;
+};
+
+struct NewFilePrivate
+{
+    gpointer dir_handle;
+    NameArena *names;
+    GTimeVal last_update;
+    gint ref_cnt;
+    GnomeVFSFileSize tree_size;
+};
+
+struct NewFileClass
+{
+    GObjectClass parent_class;
+};
+
+G_DEFINE_TYPE_WITH_PRIVATE (NewFile, new_file, G_TYPE_OBJECT)
+
+
+static void new_file_init (NewFile *f)
+{
+    f->priv = new_file_get_instance_private (f);
+}
+
+
+static void new_file_finalize (GObject *object)
+{
+    NewFile *f = (NewFile *) object;
+
+    name_arena_unref (((NewFilePrivate *) f->priv)->names);
+    gnome_vfs_file_info_unref (f->info);
+
+    G_OBJECT_CLASS (new_file_parent_class)->finalize (object);
+}
+
+
+static void new_file_class_init (NewFileClass *klass)
+{
+    G_OBJECT_CLASS (klass)->finalize = new_file_finalize;
+}
+
+
+/***********************************
+ * The listings
+ ***********************************/
+
+// What a listing provides for both layouts
+static GnomeVFSFileInfo *create_info (guint i)
+{
+    const gchar *extensions[] = {".txt", ".c", ".png", ".tar.gz", ".html", ""};
+
+    GnomeVFSFileInfo *info = gnome_vfs_file_info_new ();
+
+    info->name = g_strdup_printf ("file-%07u%s", i, extensions[i % G_N_ELEMENTS(extensions)]);
+    info->type = GNOME_VFS_FILE_TYPE_REGULAR;
+    info->permissions = (GnomeVFSFilePermissions) 0644;
+    info->size = i * 37;
+    info->mtime = 1500000000 + i;
+    info->mime_type = g_strdup (gnome_vfs_get_mime_type_for_name (info->name));
+
+    return info;
+}
+
+
+struct Dir
+{
+    GHashTable *map;
+    NameArena *names;
+    vector<GObject *> files;
+    GList *list;
+};
+
+
+static void free_dir (Dir &dir)
+{
+    g_list_free (dir.list);
+    g_hash_table_destroy (dir.map);
+    if (dir.names)
+        name_arena_unref (dir.names);
+}
+
+
+static Dir list_old (GnomeVFSURI *dir_uri, guint first, guint n)
+{
+    Dir dir = {g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref), NULL, vector<GObject *>(), NULL};
+
+    dir.files.reserve(n);
+
+    for (guint i=first; i<first+n; ++i)
+    {
+        OldFile *f = (OldFile *) g_object_new (old_file_get_type (), NULL);
+
+        f->info = f->file_info = create_info (i);
+        f->collate_key = g_utf8_collate_key_for_filename (f->info->name, -1);
+        f->uri = gnome_vfs_uri_append_file_name (dir_uri, f->info->name);
+
+        dir.files.push_back(G_OBJECT (f));
+        g_hash_table_insert (dir.map, gnome_vfs_uri_to_string (f->uri, GNOME_VFS_URI_HIDE_PASSWORD), f);
+        dir.list = g_list_prepend (dir.list, f);
+    }
+
+    return dir;
+}
+
+
+static Dir list_new (GnomeVFSURI *dir_uri, guint first, guint n)
+{
+    Dir dir = {g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_object_unref), name_arena_new (), vector<GObject *>(), NULL};
+
+    dir.files.reserve(n);
+
+    for (guint i=first; i<first+n; ++i)
+    {
+        NewFile *f = (NewFile *) g_object_new (new_file_get_type (), NULL);
+
+        f->info = f->file_info = create_info (i);
+
+        gchar *collate_key = g_utf8_collate_key_for_filename (f->info->name, -1);
+        f->collate_key = name_arena_add (dir.names, collate_key);
+        g_free (collate_key);
+        ((NewFilePrivate *) f->priv)->names = name_arena_ref (dir.names);
+
+        dir.files.push_back(G_OBJECT (f));
+        g_hash_table_insert (dir.map, (gpointer) name_arena_add (dir.names, f->info->name), f);
+        dir.list = g_list_prepend (dir.list, f);
+    }
+
+    return dir;
+}
+
+
+inline gsize get_heap_in_use ()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 mi = mallinfo2 ();
+#else
+    struct mallinfo mi = mallinfo ();
+#endif
+
+    return mi.uordblks + mi.hblkhd;
+}
+
+
+static double measure (Dir (* list_func) (GnomeVFSURI *, guint, guint), GnomeVFSURI *root_uri, guint n_files, guint per_dir)
+{
+    vector<Dir> dirs;
+
+    gsize before = get_heap_in_use ();
+
+    for (guint first=0; first<n_files; first+=per_dir)
+    {
+        gchar *name = g_strdup_printf ("dir-%07u", first);
+        GnomeVFSURI *dir_uri = gnome_vfs_uri_append_file_name (root_uri, name);
+
+        dirs.push_back(list_func (dir_uri, first, MIN (per_dir, n_files-first)));
+
+        gnome_vfs_uri_unref (dir_uri);
+        g_free (name);
+    }
+
+    gsize after = get_heap_in_use ();
+
+    for (gsize i=0; i<dirs.size(); ++i)
+        free_dir (dirs[i]);
+
+    return (double) (after - before) / n_files;
+}
+
+
+int main (int argc, char **argv)
+{
+    guint n_files = 1000000;
+    guint per_dir = 10000;
+
+    for (int i=1; i<argc; ++i)
+        if (strcmp (argv[i], "--files") == 0 && i+1 < argc)
+            n_files = atoi (argv[++i]);
+        else
+            if (strcmp (argv[i], "--per-dir") == 0 && i+1 < argc)
+                per_dir = atoi (argv[++i]);
+
+    if (!n_files || !per_dir)
+    {
+        fprintf (stderr, "Usage: %s [--files N] [--per-dir N]\n", argv[0]);
+        return 1;
+    }
+
+    gnome_vfs_init ();
+
+    GnomeVFSURI *root_uri = gnome_vfs_uri_new ("sftp://user@example.com/home/user/projects/gnome-commander");
+
+    // warm up the type system and the allocators, so that it doesn't count for the first layout
+    measure (list_old, root_uri, MIN (n_files, 1000), MIN (per_dir, 1000));
+    measure (list_new, root_uri, MIN (n_files, 1000), MIN (per_dir, 1000));
+
+    double old_bytes = measure (list_old, root_uri, n_files, per_dir);
+    double new_bytes = measure (list_new, root_uri, n_files, per_dir);
+
+    printf ("%u files in dirs of %u\n\n", n_files, per_dir);
+    printf ("%-24s %10s %10s %10s\n", "sizeof", "old", "compact", "real");
+    printf ("%-24s %10u %10u %10u\n", "GnomeCmdFile", (guint) sizeof(OldFile), (guint) sizeof(NewFile), (guint) sizeof(GnomeCmdFile));
+    printf ("%-24s %10u %10u %10u\n", "GnomeCmdFileCollection", (guint) sizeof(Dir), (guint) sizeof(Dir), (guint) sizeof(GnomeCmdFileCollection));
+    printf ("%-24s %10s %10u %10u\n\n", "NameArena", "-", (guint) sizeof(NameArena), (guint) sizeof(NameArena));
+
+    if (sizeof(NewFile) != sizeof(GnomeCmdFile))
+        printf ("The compact model doesn't match GnomeCmdFile any more, update NewFile\n\n");
+
+    printf ("%-10s %16s %16s\n", "", "bytes per file", "total [MiB]");
+    printf ("%-10s %16.1f %16.1f\n", "old", old_bytes, old_bytes * n_files / (1024*1024));
+    printf ("%-10s %16.1f %16.1f\n", "compact", new_bytes, new_bytes * n_files / (1024*1024));
+
+    gnome_vfs_uri_unref (root_uri);
+    gnome_vfs_shutdown ();
+
+    return 0;
+}
@@ -0,0 +1,293 @@
+/**
+ * @file listing_benchmark.cc
+ * @brief Part of GNOME Commander - A GNOME based file manager
+ *
+ * @details Benchmark for the container work done by the directory
+ * listing pipeline (dirlist -> GnomeCmdDir -> GnomeCmdFileCollection ->
+ * GnomeCmdFileList) for synthetic directories of 1k, 100k and 1M
+ * entries. The linear pipeline runs the real GnomeCmdFileCollection of
+ * src/gnome-cmd-file-collection.cc: reserve (), add () and get_list ()
+ * for the files of the dir, then a KEY_FILE collection of the shown
+ * files, sorted with sort (), as in the file list. The batches of dirlist
+ * and create_file_list () of GnomeCmdDir are modelled by prepended and
+ * reversed GLists, as they are done there. The old pipeline, with
+ * appended GLists throughout, is modelled for comparison; it is skipped
+ * for the biggest directory unless --all is given. The GnomeCmdFiles
+ * are plain GObjects with a GnomeVFSFileInfo, created before the clock
+ * starts.
+ *
+ * Build and run with: make -C tests listing_benchmark && tests/listing_benchmark
+ *
+ * @copyright (C) 2013-2017 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+
+#include "gnome-cmd-includes.h"
+#include "gnome-cmd-file-collection.h"
+
+using namespace std;
+
+
+#define FILES_PER_NOTIFICATION 50       // same batch size as in src/dirlist.cc
+#define QUADRATIC_LIMIT 100000
+
+
+/***********************************
+ * The parts of GnomeCmdFile used by the collection
+ ***********************************/
+
+GType gnome_cmd_file_get_type ()
+{
+    static GType type = 0;
+
+    if (!type)
+        type = g_type_register_static_simple (G_TYPE_OBJECT, "GnomeCmdFile", sizeof(GnomeCmdFileClass), NULL, sizeof(GnomeCmdFile), NULL, (GTypeFlags) 0);
+
+    return type;
+}
+
+
+GnomeCmdFile *GnomeCmdFile::ref()
+{
+    g_object_ref (this);
+    return this;
+}
+
+
+void GnomeCmdFile::unref()
+{
+    g_object_unref (this);
+}
+
+
+gchar *GnomeCmdFile::get_uri_str(GnomeVFSURIHideOptions hide_options)
+{
+    return g_strconcat ("file:///tmp/bench/", info->name, NULL);
+}
+
+
+static GnomeCmdFile *create_file (const gchar *name)
+{
+    GnomeCmdFile *f = GNOME_CMD_FILE (g_object_new (GNOME_CMD_TYPE_FILE, NULL));
+
+    f->info = gnome_vfs_file_info_new ();
+    f->info->name = g_strdup (name);
+    g_object_set_data_full (G_OBJECT (f), "info", f->info, (GDestroyNotify) gnome_vfs_file_info_unref);
+
+    return f;
+}
+
+
+/***********************************
+ * The pipeline
+ ***********************************/
+
+static GList *make_batch (vector<GnomeCmdFile *> &entries, guint start, guint n)
+{
+    GList *batch = NULL;
+
+    for (guint i=start+n; i>start; --i)
+        batch = g_list_prepend (batch, entries[i-1]);
+
+    return batch;
+}
+
+
+// dirlist: collecting the batches of GnomeVFSFileInfos until EOF
+
+static GList *collect_appending (vector<GnomeCmdFile *> &entries)
+{
+    GList *infolist = NULL;
+
+    for (guint i=0; i<entries.size(); i+=FILES_PER_NOTIFICATION)
+    {
+        GList *batch = make_batch (entries, i, MIN (FILES_PER_NOTIFICATION, entries.size()-i));
+        infolist = g_list_concat (infolist, g_list_copy (batch));
+        g_list_free (batch);
+    }
+
+    return infolist;
+}
+
+
+static GList *collect_prepending (vector<GnomeCmdFile *> &entries)
+{
+    GList *infolist = NULL;
+
+    for (guint i=0; i<entries.size(); i+=FILES_PER_NOTIFICATION)
+    {
+        GList *batch = make_batch (entries, i, MIN (FILES_PER_NOTIFICATION, entries.size()-i));
+        for (GList *j = batch; j; j = j->next)
+            infolist = g_list_prepend (infolist, j->data);
+        g_list_free (batch);
+    }
+
+    return g_list_reverse (infolist);
+}
+
+
+// GnomeCmdDir: create_file_list ()
+
+static GList *create_file_list_appending (GList *infolist)
+{
+    GList *files = NULL;
+
+    for (GList *i = infolist; i; i = i->next)
+        files = g_list_append (files, i->data);
+
+    return files;
+}
+
+
+static GList *create_file_list_prepending (GList *infolist)
+{
+    GList *files = NULL;
+
+    for (GList *i = infolist; i; i = i->next)
+        files = g_list_prepend (files, i->data);
+
+    return g_list_reverse (files);
+}
+
+
+static gint compare_names (GnomeCmdFile *f1, GnomeCmdFile *f2, gpointer)
+{
+    return strcmp (f1->info->name, f2->info->name);
+}
+
+
+inline gboolean is_shown (GnomeCmdFile *f)
+{
+    return f->info->name[0] != '.';
+}
+
+
+// The old GnomeCmdFileCollection::add () and GnomeCmdFileList::show_files (), with appended GLists
+
+static void show_dir_appending (GList *files)
+{
+    GHashTable *map = g_hash_table_new (g_str_hash, g_str_equal);
+    GList *list = NULL;
+
+    for (GList *i = files; i; i = i->next)
+    {
+        GnomeCmdFile *f = (GnomeCmdFile *) i->data;
+        list = g_list_append (list, f);
+        g_hash_table_insert (map, f->info->name, f);
+    }
+
+    GList *shown = NULL;
+
+    for (GList *i = list; i; i = i->next)
+        if (is_shown ((GnomeCmdFile *) i->data))
+            shown = g_list_append (shown, i->data);
+
+    shown = g_list_sort_with_data (shown, (GCompareDataFunc) compare_names, NULL);
+
+    g_list_free (shown);
+    g_list_free (list);
+    g_hash_table_destroy (map);
+}
+
+
+// The file collection of the dir and the visible files of the file list, as they are now
+
+static void show_dir_linear (GList *files)
+{
+    GnomeCmdFileCollection dir_files;
+    GnomeCmdFileCollection visible_files(GnomeCmdFileCollection::KEY_FILE);
+
+    dir_files.reserve(g_list_length (files));
+    dir_files.add(files);
+
+    GList *list = dir_files.get_list();
+
+    visible_files.reserve(dir_files.size());
+
+    for (GList *i = list; i; i = i->next)
+        if (is_shown ((GnomeCmdFile *) i->data))
+            visible_files.add((GnomeCmdFile *) i->data);
+
+    visible_files.sort((GCompareDataFunc) compare_names, NULL);
+}
+
+
+inline double elapsed_ms (gint64 start)
+{
+    return (g_get_monotonic_time () - start) / 1000.0;
+}
+
+
+static double run_pipeline (vector<GnomeCmdFile *> &entries, gboolean appending)
+{
+    gint64 start = g_get_monotonic_time ();
+
+    GList *infolist = appending ? collect_appending (entries) : collect_prepending (entries);
+    GList *files = appending ? create_file_list_appending (infolist) : create_file_list_prepending (infolist);
+
+    if (appending)
+        show_dir_appending (files);
+    else
+        show_dir_linear (files);
+
+    g_list_free (files);
+    g_list_free (infolist);
+
+    double ms = elapsed_ms (start);
+
+    // the collections of big dirs leave their files to be unreffed from the main loop
+    while (g_main_context_iteration (NULL, FALSE));
+
+    return ms;
+}
+
+
+int main (int argc, char **argv)
+{
+    gboolean all = argc > 1 && strcmp (argv[1], "--all") == 0;
+    guint sizes[] = {1000, 100000, 1000000};
+
+    printf ("%10s %16s %16s\n", "entries", "appending [ms]", "linear [ms]");
+
+    for (guint s=0; s<G_N_ELEMENTS(sizes); ++s)
+    {
+        vector<GnomeCmdFile *> entries(sizes[s]);
+
+        // names in reverse order, so that sorting has some work to do
+        for (guint i=0; i<sizes[s]; ++i)
+        {
+            gchar *name = g_strdup_printf ("%s%08u.txt", i % 10 ? "file" : ".file", sizes[s]-i);
+            entries[i] = create_file (name);
+            g_free (name);
+        }
+
+        double linear = run_pipeline (entries, FALSE);
+
+        if (all || sizes[s] <= QUADRATIC_LIMIT)
+            printf ("%10u %16.1f %16.1f\n", sizes[s], run_pipeline (entries, TRUE), linear);
+        else
+            printf ("%10u %16s %16.1f\n", sizes[s], "skipped", linear);
+
+        for (guint i=0; i<sizes[s]; ++i)
+            entries[i]->unref();
+    }
+
+    return 0;
+}
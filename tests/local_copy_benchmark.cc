@@ -0,0 +1,185 @@
+/**
+ * @file local_copy_benchmark.cc
+ * @brief Part of GNOME Commander - A GNOME based file manager
+ *
+ * @details Benchmark for copying a big local file: with GnomeVFS, the
+ * way it is done for remote connections, against the native copy of
+ * src/localcopy.cc, which uses a reflink, copy_file_range or sendfile,
+ * whichever works first for the file system. A file of --size MiB,
+ * 1 GiB by default, is created in --dir, which should be on the file
+ * system to test, e.g. Btrfs or XFS for reflinks. Times are the median
+ * of 3 runs, with the page cache warm.
+ *
+ * Build and run with: make -C tests local_copy_benchmark && tests/local_copy_benchmark [--size MiB] [--dir PATH]
+ *
+ * @copyright (C) 2013-2017 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "localcopy.h"
+
+using namespace std;
+
+
+#define RUNS 3
+
+
+static LocalCopyMethod last_method = LOCALCOPY_BUFFER;
+
+
+static gboolean copy_gnome_vfs (const gchar *src, const gchar *dest)
+{
+    gchar *src_str = gnome_vfs_get_uri_from_local_path (src);
+    gchar *dest_str = gnome_vfs_get_uri_from_local_path (dest);
+    GnomeVFSURI *src_uri = gnome_vfs_uri_new (src_str);
+    GnomeVFSURI *dest_uri = gnome_vfs_uri_new (dest_str);
+
+    GnomeVFSResult result = gnome_vfs_xfer_uri (src_uri, dest_uri,
+                                                GNOME_VFS_XFER_DEFAULT, GNOME_VFS_XFER_ERROR_MODE_ABORT, GNOME_VFS_XFER_OVERWRITE_MODE_REPLACE,
+                                                NULL, NULL);
+    gnome_vfs_uri_unref (src_uri);
+    gnome_vfs_uri_unref (dest_uri);
+    g_free (src_str);
+    g_free (dest_str);
+
+    return result == GNOME_VFS_OK;
+}
+
+
+static gboolean copy_native (const gchar *src, const gchar *dest)
+{
+    int src_fd = open (src, O_RDONLY);
+    int dest_fd = open (dest, O_WRONLY | O_CREAT | O_EXCL, 0644);
+    struct stat st;
+
+    GnomeVFSResult result = src_fd < 0 || dest_fd < 0 || fstat (src_fd, &st) != 0 ? GNOME_VFS_ERROR_GENERIC :
+                            localcopy_data (src_fd, dest_fd, st.st_size, NULL, NULL, &last_method);
+
+    if (src_fd >= 0)
+        close (src_fd);
+    if (dest_fd >= 0 && close (dest_fd) != 0)
+        result = GNOME_VFS_ERROR_IO;
+
+    return result == GNOME_VFS_OK;
+}
+
+
+static gboolean create_test_file (const gchar *path, guint size_mib)
+{
+    FILE *f = fopen (path, "w");
+
+    if (!f)
+        return FALSE;
+
+    // random data, so that neither compression nor deduplication of the file system can help
+    vector<guint32> block(256*1024);
+    GRand *rand = g_rand_new_with_seed (42);
+    gboolean ok = TRUE;
+
+    for (guint i=0; ok && i<size_mib; ++i)
+    {
+        for (gsize j=0; j<block.size(); ++j)
+            block[j] = g_rand_int (rand);
+        ok = fwrite (&block[0], sizeof(guint32), block.size(), f) == block.size();
+    }
+
+    g_rand_free (rand);
+
+    return fclose (f) == 0 && ok;
+}
+
+
+static double run (gboolean (* copy_func) (const gchar *, const gchar *), const gchar *src, const gchar *dest)
+{
+    vector<double> times;
+
+    for (guint i=0; i<RUNS; ++i)
+    {
+        g_remove (dest);
+        sync ();
+
+        gint64 start = g_get_monotonic_time ();
+
+        if (!copy_func (src, dest))
+            return -1;
+
+        // the data has to be on the disk, or only the page cache is measured
+        int fd = open (dest, O_RDONLY);
+        fsync (fd);
+        close (fd);
+
+        times.push_back((g_get_monotonic_time () - start) / 1000.0);
+    }
+
+    g_remove (dest);
+    sort (times.begin(), times.end());
+
+    return times[RUNS/2];
+}
+
+
+int main (int argc, char **argv)
+{
+    guint size_mib = 1024;
+    const gchar *dir_path = g_get_tmp_dir ();
+
+    for (int i=1; i<argc; ++i)
+        if (strcmp (argv[i], "--size") == 0 && i+1 < argc)
+            size_mib = atoi (argv[++i]);
+        else
+            if (strcmp (argv[i], "--dir") == 0 && i+1 < argc)
+                dir_path = argv[++i];
+
+    gnome_vfs_init ();
+
+    gchar *src = g_build_filename (dir_path, "gcmd-copy-src", NULL);
+    gchar *dest = g_build_filename (dir_path, "gcmd-copy-dest", NULL);
+
+    if (!create_test_file (src, size_mib))
+    {
+        fprintf (stderr, "Can't create %s\n", src);
+        return 1;
+    }
+
+    const gchar *method_names[] = {"reflink", "copy_file_range", "sendfile", "buffer"};
+
+    double vfs_ms = run (copy_gnome_vfs, src, dest);
+    double native_ms = run (copy_native, src, dest);
+
+    printf ("%s: %u MiB, native method: %s\n\n", src, size_mib, method_names[last_method]);
+    printf ("%-10s %12s %12s\n", "", "time [ms]", "MiB/s");
+    printf ("%-10s %12.1f %12.1f\n", "GnomeVFS", vfs_ms, size_mib * 1000.0 / vfs_ms);
+    printf ("%-10s %12.1f %12.1f\n", "native", native_ms, size_mib * 1000.0 / native_ms);
+
+    g_remove (src);
+    g_free (src);
+    g_free (dest);
+    gnome_vfs_shutdown ();
+
+    return 0;
+}
@@ -0,0 +1,244 @@
+/**
+ * @file local_copy_tests.cc
+ * @brief Part of GNOME Commander - A GNOME based file manager
+ *
+ * @details Tests for src/localcopy.cc: localcopy_data () has to copy
+ * whole files of any size, report its progress up to the end and stop
+ * when asked to. For resuming a partial copy, localcopy_verify () has to
+ * find any difference in the part copied before, and localcopy_data ()
+ * has to continue at the current offsets.
+ *
+ * @copyright (C) 2013-2017 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include "../src/localcopy.h"
+
+using namespace std;
+
+
+#define DATA_SIZE (3*1024*1024 + 123)       // more than the buffer of localcopy.cc, not a multiple of it
+
+
+class LocalCopyTest : public ::testing::Test
+{
+  protected:
+
+    gchar *dir;
+    gchar *src_path;
+    gchar *dest_path;
+    gchar *data;
+
+    void SetUp()
+    {
+        dir = g_dir_make_tmp ("gcmd-localcopy-XXXXXX", NULL);
+        ASSERT_TRUE (dir != NULL);
+
+        src_path = g_build_filename (dir, "src", NULL);
+        dest_path = g_build_filename (dir, "dest", NULL);
+        data = (gchar *) g_malloc (DATA_SIZE);
+
+        for (gsize i=0; i<DATA_SIZE; ++i)
+            data[i] = g_random_int_range (0, 256);
+
+        ASSERT_TRUE (g_file_set_contents (src_path, data, DATA_SIZE, NULL));
+    }
+
+    void TearDown()
+    {
+        g_unlink (src_path);
+        g_unlink (dest_path);
+        g_rmdir (dir);
+        g_free (data);
+        g_free (src_path);
+        g_free (dest_path);
+        g_free (dir);
+    }
+
+    // A target copied up to @a len, as left behind by a cancelled copy
+    void write_partial_dest (gsize len)
+    {
+        ASSERT_TRUE (g_file_set_contents (dest_path, data, len, NULL));
+    }
+
+    // Copies the source into a new target, the way a copy starts from scratch
+    GnomeVFSResult copy_to_new_dest (GnomeVFSFileSize size, LocalCopyProgressFunc func, gpointer user_data)
+    {
+        int src_fd = open (src_path, O_RDONLY);
+        int dest_fd = open (dest_path, O_WRONLY | O_CREAT | O_EXCL, 0600);
+
+        EXPECT_LE (0, src_fd);
+        EXPECT_LE (0, dest_fd);
+
+        GnomeVFSResult result = localcopy_data (src_fd, dest_fd, size, func, user_data);
+
+        close (src_fd);
+        close (dest_fd);
+
+        return result;
+    }
+
+    void expect_dest_contents (const gchar *expected, gsize expected_len)
+    {
+        gchar *contents = NULL;
+        gsize len = 0;
+
+        ASSERT_TRUE (g_file_get_contents (dest_path, &contents, &len, NULL));
+        EXPECT_EQ (expected_len, len);
+        EXPECT_TRUE (memcmp (contents, expected, expected_len) == 0);
+
+        g_free (contents);
+    }
+};
+
+
+struct CopyProgress
+{
+    GnomeVFSFileSize bytes_copied;
+    guint calls;
+    gboolean increasing;
+    guint stop_at;                      // the call returning FALSE, 0 for none
+};
+
+
+static gboolean on_copy_progress (GnomeVFSFileSize bytes_copied, CopyProgress *progress)
+{
+    if (bytes_copied <= progress->bytes_copied)
+        progress->increasing = FALSE;
+
+    progress->bytes_copied = bytes_copied;
+
+    return ++progress->calls != progress->stop_at;
+}
+
+
+TEST_F(LocalCopyTest, FullCopy)
+{
+    EXPECT_EQ (GNOME_VFS_OK, copy_to_new_dest (DATA_SIZE, NULL, NULL));
+
+    expect_dest_contents (data, DATA_SIZE);
+}
+
+
+TEST_F(LocalCopyTest, EmptyFile)
+{
+    ASSERT_TRUE (g_file_set_contents (src_path, "", 0, NULL));
+
+    CopyProgress progress = {0, 0, TRUE, 0};
+
+    EXPECT_EQ (GNOME_VFS_OK, copy_to_new_dest (0, (LocalCopyProgressFunc) on_copy_progress, &progress));
+    EXPECT_EQ ((GnomeVFSFileSize) 0, progress.bytes_copied);
+
+    expect_dest_contents ("", 0);
+}
+
+
+TEST_F(LocalCopyTest, ProgressReachesSize)
+{
+    CopyProgress progress = {0, 0, TRUE, 0};
+
+    EXPECT_EQ (GNOME_VFS_OK, copy_to_new_dest (DATA_SIZE, (LocalCopyProgressFunc) on_copy_progress, &progress));
+    EXPECT_LT (0u, progress.calls);
+    EXPECT_TRUE (progress.increasing);
+    EXPECT_EQ ((GnomeVFSFileSize) DATA_SIZE, progress.bytes_copied);
+
+    expect_dest_contents (data, DATA_SIZE);
+}
+
+
+TEST_F(LocalCopyTest, InterruptedByProgress)
+{
+    CopyProgress progress = {0, 0, TRUE, 1};
+
+    EXPECT_EQ (GNOME_VFS_ERROR_INTERRUPTED, copy_to_new_dest (DATA_SIZE, (LocalCopyProgressFunc) on_copy_progress, &progress));
+
+    // no more pieces are copied once the copy has been stopped
+    EXPECT_EQ (1u, progress.calls);
+}
+
+
+TEST_F(LocalCopyTest, VerifySamePrefix)
+{
+    write_partial_dest (DATA_SIZE / 2);
+
+    int src_fd = open (src_path, O_RDONLY);
+    int dest_fd = open (dest_path, O_RDONLY);
+
+    EXPECT_EQ (GNOME_VFS_OK, localcopy_verify (src_fd, dest_fd, DATA_SIZE / 2, NULL, NULL));
+    EXPECT_EQ (GNOME_VFS_OK, localcopy_verify (src_fd, dest_fd, 0, NULL, NULL));
+
+    // the offsets are left alone
+    EXPECT_EQ (0, lseek (src_fd, 0, SEEK_CUR));
+    EXPECT_EQ (0, lseek (dest_fd, 0, SEEK_CUR));
+
+    close (src_fd);
+    close (dest_fd);
+}
+
+
+TEST_F(LocalCopyTest, VerifyFindsDifferences)
+{
+    write_partial_dest (DATA_SIZE / 2);
+
+    int src_fd = open (src_path, O_RDONLY);
+    int dest_fd = open (dest_path, O_RDWR);
+
+    // the target is shorter than the part to be compared
+    EXPECT_EQ (GNOME_VFS_ERROR_CORRUPTED_DATA, localcopy_verify (src_fd, dest_fd, DATA_SIZE, NULL, NULL));
+
+    gchar c = ~data[DATA_SIZE / 2 - 1];
+    ASSERT_EQ (1, pwrite (dest_fd, &c, 1, DATA_SIZE / 2 - 1));
+
+    EXPECT_EQ (GNOME_VFS_ERROR_CORRUPTED_DATA, localcopy_verify (src_fd, dest_fd, DATA_SIZE / 2, NULL, NULL));
+    EXPECT_EQ (GNOME_VFS_OK, localcopy_verify (src_fd, dest_fd, DATA_SIZE / 2 - 1, NULL, NULL));
+
+    close (src_fd);
+    close (dest_fd);
+}
+
+
+TEST_F(LocalCopyTest, ResumeAtOffset)
+{
+    const gsize offset = 1024*1024 + 7;
+
+    write_partial_dest (offset);
+
+    int src_fd = open (src_path, O_RDONLY);
+    int dest_fd = open (dest_path, O_RDWR);
+
+    ASSERT_EQ ((off_t) offset, lseek (src_fd, offset, SEEK_SET));
+    ASSERT_EQ ((off_t) offset, lseek (dest_fd, offset, SEEK_SET));
+
+    EXPECT_EQ (GNOME_VFS_OK, localcopy_data (src_fd, dest_fd, DATA_SIZE - offset, NULL, NULL));
+
+    close (src_fd);
+    close (dest_fd);
+
+    gchar *contents = NULL;
+    gsize len = 0;
+
+    ASSERT_TRUE (g_file_get_contents (dest_path, &contents, &len, NULL));
+    EXPECT_EQ ((gsize) DATA_SIZE, len);
+    EXPECT_TRUE (memcmp (contents, data, DATA_SIZE) == 0);
+
+    g_free (contents);
+}
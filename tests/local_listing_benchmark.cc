@@ -0,0 +1,299 @@
+/**
+ * @file local_listing_benchmark.cc
+ * @brief Part of GNOME Commander - A GNOME based file manager
+ *
+ * @details Benchmark for listing a local directory: with GnomeVFS, the
+ * way it is done for remote connections, against the native listing of
+ * src/localdir.cc, once stat'ing on the reading thread and once on a
+ * pool of threads like src/dirlist.cc does. A synthetic directory of
+ * 10k files with some subdirs and symlinks is created unless one is
+ * given with --dir. Warm cache times are the median of 5 runs. With
+ * --cold the page, dentry and inode caches are dropped before each run,
+ * which needs root.
+ *
+ * Build and run with: make -C tests local_listing_benchmark && tests/local_listing_benchmark [--cold] [--files N] [--dir PATH]
+ *
+ * @copyright (C) 2013-2017 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "localdir.h"
+
+using namespace std;
+
+
+#define WARM_RUNS 5
+#define STAT_CHUNK 1000         // ENTRIES_PER_CHUNK in src/dirlist.cc
+
+
+static gboolean drop_caches ()
+{
+    sync ();
+
+    FILE *f = fopen ("/proc/sys/vm/drop_caches", "w");
+
+    if (!f)
+        return FALSE;
+
+    gboolean ok = fputs ("3\n", f) >= 0;
+
+    return fclose (f) == 0 && ok;
+}
+
+
+static guint list_gnome_vfs (const gchar *path)
+{
+    GnomeVFSFileInfoOptions infoOpts = (GnomeVFSFileInfoOptions) (GNOME_VFS_FILE_INFO_FOLLOW_LINKS | GNOME_VFS_FILE_INFO_GET_MIME_TYPE);
+
+    gchar *uri_str = gnome_vfs_get_uri_from_local_path (path);
+    GList *infolist = NULL;
+
+    gnome_vfs_directory_list_load (&infolist, uri_str, infoOpts);
+
+    guint n = g_list_length (infolist);
+
+    gnome_vfs_file_info_list_free (infolist);
+    g_free (uri_str);
+
+    return n;
+}
+
+
+static guint list_native (const gchar *path)
+{
+    GnomeVFSResult result;
+    LocalDir *dir = localdir_open (path, &result);
+
+    if (!dir)
+        return 0;
+
+    GList *infolist = localdir_read (dir, G_MAXUINT, &result);
+
+    for (GList *i = infolist; i; i = i->next)
+        localdir_stat (dir, (GnomeVFSFileInfo *) i->data);
+
+    guint n = g_list_length (infolist);
+
+    gnome_vfs_file_info_list_free (infolist);
+    localdir_unref (dir);
+
+    return n;
+}
+
+
+struct StatChunk
+{
+    LocalDir *dir;
+    GList *infolist;
+};
+
+
+static void stat_chunk (StatChunk *chunk, gpointer unused)
+{
+    for (GList *i = chunk->infolist; i; i = i->next)
+        localdir_stat (chunk->dir, (GnomeVFSFileInfo *) i->data);
+}
+
+
+static guint list_native_parallel (const gchar *path)
+{
+    GnomeVFSResult result;
+    LocalDir *dir = localdir_open (path, &result);
+
+    if (!dir)
+        return 0;
+
+    GThreadPool *pool = g_thread_pool_new ((GFunc) stat_chunk, NULL, g_get_num_processors (), FALSE, NULL);
+    vector<StatChunk> chunks;
+    guint n = 0;
+
+    do
+    {
+        StatChunk chunk = {dir, localdir_read (dir, STAT_CHUNK, &result)};
+
+        if (!chunk.infolist)
+            break;
+
+        n += g_list_length (chunk.infolist);
+        chunks.push_back(chunk);
+    }
+    while (result == GNOME_VFS_OK);
+
+    for (gsize i=0; i<chunks.size(); ++i)
+        g_thread_pool_push (pool, &chunks[i], NULL);
+
+    g_thread_pool_free (pool, FALSE, TRUE);
+
+    for (gsize i=0; i<chunks.size(); ++i)
+        gnome_vfs_file_info_list_free (chunks[i].infolist);
+
+    localdir_unref (dir);
+
+    return n;
+}
+
+
+static gchar *create_test_dir (guint n_files)
+{
+    gchar *path = g_dir_make_tmp ("gcmd-listing-XXXXXX", NULL);
+
+    if (!path)
+        return NULL;
+
+    const gchar *extensions[] = {".txt", ".c", ".png", ".tar.gz", ""};
+
+    for (guint i=0; i<n_files; ++i)
+    {
+        gchar *name = g_strdup_printf ("%s/file%06u%s", path, i, extensions[i % G_N_ELEMENTS(extensions)]);
+
+        if (i % 100 == 0)
+            g_mkdir (name, 0755);
+        else
+            if (i % 50 == 0)
+                symlink ("file000001.c", name);
+            else
+                g_file_set_contents (name, "#include <stdio.h>\nint main () { return 0; }\n", -1, NULL);
+
+        g_free (name);
+    }
+
+    return path;
+}
+
+
+static void remove_test_dir (const gchar *path)
+{
+    GDir *dir = g_dir_open (path, 0, NULL);
+
+    for (const gchar *name; dir && (name = g_dir_read_name (dir)); )
+    {
+        gchar *file = g_build_filename (path, name, NULL);
+
+        if (g_remove (file) != 0)
+            g_rmdir (file);
+        g_free (file);
+    }
+
+    if (dir)
+        g_dir_close (dir);
+    g_rmdir (path);
+}
+
+
+inline double elapsed_ms (gint64 start)
+{
+    return (g_get_monotonic_time () - start) / 1000.0;
+}
+
+
+static double run_warm (guint (* list_func) (const gchar *), const gchar *path)
+{
+    vector<double> times;
+
+    list_func (path);
+
+    for (guint i=0; i<WARM_RUNS; ++i)
+    {
+        gint64 start = g_get_monotonic_time ();
+        list_func (path);
+        times.push_back(elapsed_ms (start));
+    }
+
+    sort (times.begin(), times.end());
+
+    return times[WARM_RUNS/2];
+}
+
+
+static double run_cold (guint (* list_func) (const gchar *), const gchar *path)
+{
+    if (!drop_caches ())
+        return -1;
+
+    gint64 start = g_get_monotonic_time ();
+    list_func (path);
+
+    return elapsed_ms (start);
+}
+
+
+int main (int argc, char **argv)
+{
+    gboolean cold = FALSE;
+    guint n_files = 10000;
+    gchar *path = NULL;
+
+    for (int i=1; i<argc; ++i)
+        if (strcmp (argv[i], "--cold") == 0)
+            cold = TRUE;
+        else
+            if (strcmp (argv[i], "--files") == 0 && i+1 < argc)
+                n_files = atoi (argv[++i]);
+            else
+                if (strcmp (argv[i], "--dir") == 0 && i+1 < argc)
+                    path = g_strdup (argv[++i]);
+
+    gnome_vfs_init ();
+
+    gboolean created = path == NULL;
+
+    if (created && !(path = create_test_dir (n_files)))
+    {
+        fprintf (stderr, "Can't create the test directory\n");
+        return 1;
+    }
+
+    struct
+    {
+        const gchar *name;
+        guint (* func) (const gchar *);
+    }
+    methods[] = {{"GnomeVFS", list_gnome_vfs},
+                 {"native", list_native},
+                 {"native, parallel stat", list_native_parallel}};
+
+    printf ("%s: %u entries\n\n", path, list_native (path));
+    printf ("%-24s %12s %12s\n", "", "warm [ms]", "cold [ms]");
+
+    for (guint i=0; i<G_N_ELEMENTS(methods); ++i)
+    {
+        double warm = run_warm (methods[i].func, path);
+        double cold_ms = cold ? run_cold (methods[i].func, path) : -1;
+
+        if (cold_ms >= 0)
+            printf ("%-24s %12.1f %12.1f\n", methods[i].name, warm, cold_ms);
+        else
+            printf ("%-24s %12.1f %12s\n", methods[i].name, warm, cold ? "needs root" : "-");
+    }
+
+    if (created)
+        remove_test_dir (path);
+
+    g_free (path);
+    gnome_vfs_shutdown ();
+
+    return 0;
+}
@@ -0,0 +1,229 @@
+/**
+ * @file parallel_copy_benchmark.cc
+ * @brief Part of GNOME Commander - A GNOME based file manager
+ *
+ * @details Benchmark for copying a tree of many small files with the
+ * scheduling of the native local transfers of src/gnome-cmd-xfer.cc: a
+ * walker creates the dirs in order and hands the files to the bounded
+ * pool of localcopy_pool_new (), whose workers copy them with
+ * localcopy_data () and localcopy_set_attributes (). The walker is a
+ * model of the one in gnome-cmd-xfer.cc, without its progress reports,
+ * queries and checkpoints, so the times are those of the pool and the
+ * copies alone. A synthetic tree of --files files of 4 KiB, 500 per dir,
+ * is created in --dir, which may be a network share, and copied with 1,
+ * 4 and 16 workers.
+ *
+ * Build and run with: make -C tests parallel_copy_benchmark && tests/parallel_copy_benchmark [--files N] [--dir PATH]
+ *
+ * @copyright (C) 2013-2017 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "localcopy.h"
+
+using namespace std;
+
+
+#define FILES_PER_DIR 500
+#define FILE_SIZE 4096
+
+
+struct CopyJob
+{
+    gchar *src;
+    gchar *dest;
+    struct stat st;
+};
+
+
+static gint failed = 0;
+
+
+static void copy_file (CopyJob *job, gpointer unused)
+{
+    int src_fd = open (job->src, O_RDONLY | O_CLOEXEC);
+    int dest_fd = open (job->dest, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+
+    if (src_fd < 0 || dest_fd < 0 || localcopy_data (src_fd, dest_fd, job->st.st_size, NULL, NULL) != GNOME_VFS_OK)
+        g_atomic_int_inc (&failed);
+    else
+        localcopy_set_attributes (dest_fd, &job->st);
+
+    if (src_fd >= 0)
+        close (src_fd);
+    if (dest_fd >= 0)
+        close (dest_fd);
+
+    g_free (job->src);
+    g_free (job->dest);
+    g_free (job);
+}
+
+
+static guint copy_tree (LocalCopyPool *pool, const gchar *src, const gchar *dest)
+{
+    guint n = 0;
+
+    if (g_mkdir (dest, 0700) != 0)
+        return 0;
+
+    GDir *dir = g_dir_open (src, 0, NULL);
+
+    for (const gchar *name; dir && (name = g_dir_read_name (dir)); )
+    {
+        CopyJob *job = g_new0 (CopyJob, 1);
+
+        job->src = g_build_filename (src, name, NULL);
+        job->dest = g_build_filename (dest, name, NULL);
+
+        if (lstat (job->src, &job->st) == 0 && S_ISDIR (job->st.st_mode))
+            n += copy_tree (pool, job->src, job->dest);
+        else
+        {
+            localcopy_pool_push (pool, job);
+            ++n;
+            continue;
+        }
+
+        g_free (job->src);
+        g_free (job->dest);
+        g_free (job);
+    }
+
+    if (dir)
+        g_dir_close (dir);
+
+    return n;
+}
+
+
+static gchar *create_test_tree (const gchar *parent, guint n_files)
+{
+    gchar *tmpl = g_build_filename (parent, "gcmd-copy-XXXXXX", NULL);
+    gchar *path = g_mkdtemp (tmpl);
+
+    if (!path)
+    {
+        g_free (tmpl);
+        return NULL;
+    }
+
+    gchar *src = g_build_filename (path, "src", NULL);
+    gchar data[FILE_SIZE];
+
+    memset (data, 'x', sizeof(data));
+    g_mkdir (src, 0755);
+
+    for (guint i=0; i<n_files; ++i)
+    {
+        gchar *dir = g_strdup_printf ("%s/dir%04u", src, i / FILES_PER_DIR);
+        gchar *name = g_strdup_printf ("%s/file%06u.txt", dir, i);
+
+        if (i % FILES_PER_DIR == 0)
+            g_mkdir (dir, 0755);
+        g_file_set_contents (name, data, sizeof(data), NULL);
+
+        g_free (name);
+        g_free (dir);
+    }
+
+    g_free (src);
+
+    return path;
+}
+
+
+static void remove_tree (const gchar *path)
+{
+    GDir *dir = g_dir_open (path, 0, NULL);
+
+    for (const gchar *name; dir && (name = g_dir_read_name (dir)); )
+    {
+        gchar *file = g_build_filename (path, name, NULL);
+
+        if (g_remove (file) != 0)
+            remove_tree (file);
+        g_free (file);
+    }
+
+    if (dir)
+        g_dir_close (dir);
+    g_rmdir (path);
+}
+
+
+int main (int argc, char **argv)
+{
+    guint n_files = 100000;
+    const gchar *parent = g_get_tmp_dir ();
+
+    for (int i=1; i<argc; ++i)
+        if (strcmp (argv[i], "--files") == 0 && i+1 < argc)
+            n_files = atoi (argv[++i]);
+        else
+            if (strcmp (argv[i], "--dir") == 0 && i+1 < argc)
+                parent = argv[++i];
+
+    gchar *path = create_test_tree (parent, n_files);
+
+    if (!path)
+    {
+        fprintf (stderr, "Can't create the test tree in %s\n", parent);
+        return 1;
+    }
+
+    gchar *src = g_build_filename (path, "src", NULL);
+    gchar *dest = g_build_filename (path, "dest", NULL);
+    guint workers[] = {1, 4, 16};
+
+    printf ("%s: %u files of %u bytes\n\n", src, n_files, FILE_SIZE);
+    printf ("%-10s %12s %12s\n", "workers", "time [ms]", "files/s");
+
+    for (guint i=0; i<G_N_ELEMENTS(workers); ++i)
+    {
+        sync ();
+
+        gint64 start = g_get_monotonic_time ();
+        LocalCopyPool *pool = localcopy_pool_new ((GFunc) copy_file, NULL, workers[i]);
+        guint n = copy_tree (pool, src, dest);
+        localcopy_pool_free (pool);
+        double ms = (g_get_monotonic_time () - start) / 1000.0;
+
+        printf ("%-10u %12.1f %12.0f\n", workers[i], ms, n * 1000.0 / ms);
+
+        remove_tree (dest);
+    }
+
+    if (failed)
+        fprintf (stderr, "\n%d files couldn't be copied\n", failed);
+
+    remove_tree (path);
+
+    g_free (src);
+    g_free (dest);
+    g_free (path);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,94 @@
+/**
+ * @file parallel_sort_tests.cc
+ * @brief Part of GNOME Commander - A GNOME based file manager
+ *
+ * @details Tests for GnomeCmd::parallel_stable_sort(), which sorts the
+ * files of big directories on several threads. The result has to be the
+ * same as that of std::stable_sort, including the order of equal elements.
+ *
+ * @copyright (C) 2013-2017 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <glib.h>
+#include <gtest/gtest.h>
+#include "../src/gnome-cmd-parallel-sort.h"
+
+using namespace std;
+
+
+struct Record
+{
+    gint key;
+    guint pos;
+};
+
+
+static gint compare_records (gconstpointer p1, gconstpointer p2, gpointer unused)
+{
+    const Record *r1 = (const Record *) p1;
+    const Record *r2 = (const Record *) p2;
+
+    return r1->key < r2->key ? -1 : r1->key > r2->key;
+}
+
+
+static void check_sort (guint n, gsize min_chunk)
+{
+    vector<Record> records(n);
+    vector<Record *> sorted, expected;
+
+    for (guint i=0; i<n; ++i)
+    {
+        records[i].key = g_random_int_range (0, 100);       // plenty of equal keys to check the stability
+        records[i].pos = i;
+        sorted.push_back(&records[i]);
+    }
+
+    expected = sorted;
+
+    stable_sort (expected.begin(), expected.end(), GnomeCmd::CompareDataLess(compare_records, NULL));
+    GnomeCmd::parallel_stable_sort (sorted.data(), sorted.data() + sorted.size(), GnomeCmd::CompareDataLess(compare_records, NULL), min_chunk);
+
+    EXPECT_TRUE (sorted == expected);
+}
+
+
+TEST(ParallelStableSort, EmptyAndTiny)
+{
+    check_sort (0, 1);
+    check_sort (1, 1);
+    check_sort (2, 1);
+}
+
+
+TEST(ParallelStableSort, OddNumberOfChunks)
+{
+    check_sort (1001, 7);
+    check_sort (99999, 331);
+}
+
+
+TEST(ParallelStableSort, SerialBelowThreshold)
+{
+    check_sort (1000, GnomeCmd::PARALLEL_SORT_MIN_CHUNK);
+}
+
+
+TEST(ParallelStableSort, BigArray)
+{
+    check_sort (4 * GnomeCmd::PARALLEL_SORT_MIN_CHUNK + 17, GnomeCmd::PARALLEL_SORT_MIN_CHUNK);
+}
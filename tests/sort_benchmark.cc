@@ -0,0 +1,183 @@
+/**
+ * @file sort_benchmark.cc
+ * @brief Part of GNOME Commander - A GNOME based file manager
+ *
+ * @details Benchmark for sorting the file list: the old way, with
+ * g_list_sort_with_data() over a GList, against the new one, with
+ * GnomeCmd::parallel_stable_sort() over an array of the same records,
+ * for synthetic directories of 10k, 100k and 1M entries and for the
+ * name, extension, size and date columns. The records mirror the
+ * precomputed GnomeCmdFile::SortKey, so the comparators do the same work
+ * as the sort_by_* functions of GnomeCmdFileList.
+ *
+ * Build and run with: make -C tests sort_benchmark && tests/sort_benchmark
+ *
+ * @copyright (C) 2013-2017 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "../src/gnome-cmd-parallel-sort.h"
+
+using namespace std;
+
+
+struct Record
+{
+    gint type;
+    time_t mtime;
+    guint64 size;
+    const gchar *extension;
+    gchar *collate_key;
+};
+
+
+inline gint cmp (gint64 i1, gint64 i2)
+{
+    return i1 < i2 ? -1 : i1 > i2;
+}
+
+
+static gint sort_by_name (const Record *r1, const Record *r2, gpointer)
+{
+    gint ret = cmp (r2->type, r1->type);
+    return ret ? ret : strcmp (r1->collate_key, r2->collate_key);
+}
+
+
+static gint sort_by_ext (const Record *r1, const Record *r2, gpointer)
+{
+    gint ret = cmp (r2->type, r1->type);
+
+    if (!ret && r1->extension != r2->extension)
+        ret = !r1->extension ? -1 : !r2->extension ? 1 : strcmp (r1->extension, r2->extension);
+
+    return ret ? ret : strcmp (r1->collate_key, r2->collate_key);
+}
+
+
+static gint sort_by_size (const Record *r1, const Record *r2, gpointer)
+{
+    gint ret = cmp (r2->type, r1->type);
+
+    if (!ret)
+        ret = cmp (r1->size, r2->size);
+
+    return ret ? ret : strcmp (r1->collate_key, r2->collate_key);
+}
+
+
+static gint sort_by_date (const Record *r1, const Record *r2, gpointer)
+{
+    gint ret = cmp (r2->type, r1->type);
+
+    if (!ret)
+        ret = cmp (r1->mtime, r2->mtime);
+
+    return ret ? ret : strcmp (r1->collate_key, r2->collate_key);
+}
+
+
+static struct
+{
+    const gchar *title;
+    GCompareDataFunc func;
+} columns[] = {{"name", (GCompareDataFunc) sort_by_name},
+               {"ext", (GCompareDataFunc) sort_by_ext},
+               {"size", (GCompareDataFunc) sort_by_size},
+               {"date", (GCompareDataFunc) sort_by_date}};
+
+
+inline double elapsed_ms (gint64 start)
+{
+    return (g_get_monotonic_time () - start) / 1000.0;
+}
+
+
+static double sort_list (vector<Record> &records, GCompareDataFunc func)
+{
+    GList *list = NULL;
+
+    for (guint i=records.size(); i>0; --i)
+        list = g_list_prepend (list, &records[i-1]);
+
+    gint64 start = g_get_monotonic_time ();
+    list = g_list_sort_with_data (list, func, NULL);
+    double ms = elapsed_ms (start);
+
+    g_list_free (list);
+
+    return ms;
+}
+
+
+static double sort_array (vector<Record> &records, GCompareDataFunc func)
+{
+    vector<Record *> v;
+
+    for (guint i=0; i<records.size(); ++i)
+        v.push_back(&records[i]);
+
+    gint64 start = g_get_monotonic_time ();
+    GnomeCmd::parallel_stable_sort (v.data(), v.data() + v.size(), GnomeCmd::CompareDataLess(func, NULL));
+
+    return elapsed_ms (start);
+}
+
+
+int main (int argc, char **argv)
+{
+    static const gchar *extensions[] = {"txt", "cc", "h", "png", "tar.gz", NULL};
+    guint sizes[] = {10000, 100000, 1000000};
+
+    printf ("%u processors, parallel sort from %u entries on\n\n", g_get_num_processors (), (guint) (2 * GnomeCmd::PARALLEL_SORT_MIN_CHUNK));
+    printf ("%10s %8s %16s %16s\n", "entries", "column", "GList [ms]", "parallel [ms]");
+
+    for (guint s=0; s<G_N_ELEMENTS(sizes); ++s)
+    {
+        vector<Record> records(sizes[s]);
+        GRand *rand = g_rand_new_with_seed (sizes[s]);
+
+        for (guint i=0; i<sizes[s]; ++i)
+        {
+            const gchar *ext = extensions[g_rand_int_range (rand, 0, G_N_ELEMENTS(extensions))];
+            gchar *name = ext ? g_strdup_printf ("file%08x.%s", g_rand_int (rand), ext) : g_strdup_printf ("file%08x", g_rand_int (rand));
+
+            records[i].type = g_rand_int_range (rand, 0, 10) ? 1 : 2;
+            records[i].mtime = g_rand_int (rand);
+            records[i].size = g_rand_int (rand);
+            records[i].collate_key = g_utf8_collate_key_for_filename (name, -1);
+            records[i].extension = ext;
+
+            g_free (name);
+        }
+
+        for (guint c=0; c<G_N_ELEMENTS(columns); ++c)
+            printf ("%10u %8s %16.1f %16.1f\n", sizes[s], columns[c].title, sort_list (records, columns[c].func), sort_array (records, columns[c].func));
+
+        for (guint i=0; i<sizes[s]; ++i)
+            g_free (records[i].collate_key);
+
+        g_rand_free (rand);
+    }
+
+    return 0;
+}